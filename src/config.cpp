@@ -50,13 +50,7 @@ void Config::LoadFromYaml(const YAML::Node& root) {
         ConfigVarBase::ptr var = LookupBase(key);
 
         if (var) {
-            if (node.second.IsScalar()) {
-                var->fromString(node.second.Scalar());
-            } else {
-                std::stringstream ss;
-                ss << node.second;
-                var->fromString(ss.str());
-            }
+            var->fromYaml(node.second);
         }
     }
 }
@@ -12,8 +12,10 @@
 
 #pragma once
 
+#include <strings.h>
 #include <yaml-cpp/yaml.h>
 
+#include <atomic>
 #include <boost/lexical_cast.hpp>
 #include <functional>
 #include <list>
@@ -21,12 +23,15 @@
 #include <memory>
 #include <set>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "log.h"
+#include "rcu.h"
 #include "thread.h"
 
 namespace sylar {
@@ -46,6 +51,10 @@ public:
 
     virtual std::string toString() = 0;
     virtual bool fromString(const std::string& val) = 0;
+    /**
+     * @brief 从YAML节点设置参数值, 加载配置文件时使用
+     */
+    virtual bool fromYaml(const YAML::Node& node) = 0;
     virtual std::string getTypeName() const = 0;
 
 protected:
@@ -63,23 +72,77 @@ public:
     }
 };
 
+/**
+ * @brief bool与字符串互转
+ * @details 不经过boost::lexical_cast(其内联展开在-O3下触发-Werror=restrict),
+ *          输出"true"/"false", 接受YAML常用的true/false, yes/no, on/off与1/0(不区分大小写)
+ */
+template <>
+class LexicalCast<bool, std::string> {
+public:
+    std::string operator()(const bool& v) {
+        return v ? "true" : "false";
+    }
+};
+
+template <>
+class LexicalCast<std::string, bool> {
+public:
+    bool operator()(const std::string& v) {
+        for (const char* str : {"true", "yes", "on", "1"}) {
+            if (strcasecmp(v.c_str(), str) == 0) {
+                return true;
+            }
+        }
+        for (const char* str : {"false", "no", "off", "0"}) {
+            if (strcasecmp(v.c_str(), str) == 0) {
+                return false;
+            }
+        }
+        throw std::invalid_argument("invalid bool: " + v);
+    }
+};
+
+/**
+ * @brief 从YAML节点转换
+ * @details 默认实现: 标量转换其文本, 其余节点序列化为字符串后用LexicalCast<std::string, T>转换.
+ *          容器类型特化为直接遍历子节点; 自定义类型可特化LexicalCast<YAML::Node, T>,
+ *          避免加载配置时先序列化再解析
+ */
+template <class ToType>
+class LexicalCast<YAML::Node, ToType> {
+public:
+    ToType operator()(const YAML::Node& node) {
+        if (node.IsScalar()) {
+            return LexicalCast<std::string, ToType>()(node.Scalar());
+        }
+        std::stringstream ss;
+        ss << node;
+        return LexicalCast<std::string, ToType>()(ss.str());
+    }
+};
+
 // vector支持
 template <class ValueType>
-class LexicalCast<std::string, std::vector<ValueType>> {
+class LexicalCast<YAML::Node, std::vector<ValueType>> {
 public:
-    std::vector<ValueType> operator()(const std::string& v) {
-        YAML::Node node = YAML::Load(v);
+    std::vector<ValueType> operator()(const YAML::Node& node) {
         typename std::vector<ValueType> vec;
-        std::stringstream ss;
-        for (size_t i = 0; i < node.size(); ++i) {
-            ss.str("");
-            ss << node[i];
-            vec.emplace_back(LexicalCast<std::string, ValueType>()(ss.str()));
+        for (const auto& i : node) {
+            vec.emplace_back(LexicalCast<YAML::Node, ValueType>()(i));
         }
         return vec;
     }
 };
 
+template <class ValueType>
+class LexicalCast<std::string, std::vector<ValueType>> {
+public:
+    std::vector<ValueType> operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, std::vector<ValueType>>()(YAML::Load(v));
+    }
+};
+
 template <class ValueType>
 class LexicalCast<std::vector<ValueType>, std::string> {
 public:
@@ -96,21 +159,25 @@ public:
 
 // list支持
 template <class ValueType>
-class LexicalCast<std::string, std::list<ValueType>> {
+class LexicalCast<YAML::Node, std::list<ValueType>> {
 public:
-    std::list<ValueType> operator()(const std::string& v) {
-        YAML::Node node = YAML::Load(v);
+    std::list<ValueType> operator()(const YAML::Node& node) {
         typename std::list<ValueType> vec;
-        std::stringstream ss;
-        for (size_t i = 0; i < node.size(); ++i) {
-            ss.str("");
-            ss << node[i];
-            vec.emplace_back(LexicalCast<std::string, ValueType>()(ss.str()));
+        for (const auto& i : node) {
+            vec.emplace_back(LexicalCast<YAML::Node, ValueType>()(i));
         }
         return vec;
     }
 };
 
+template <class ValueType>
+class LexicalCast<std::string, std::list<ValueType>> {
+public:
+    std::list<ValueType> operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, std::list<ValueType>>()(YAML::Load(v));
+    }
+};
+
 template <class ValueType>
 class LexicalCast<std::list<ValueType>, std::string> {
 public:
@@ -127,21 +194,25 @@ public:
 
 // set支持
 template <class ValueType>
-class LexicalCast<std::string, std::set<ValueType>> {
+class LexicalCast<YAML::Node, std::set<ValueType>> {
 public:
-    std::set<ValueType> operator()(const std::string& v) {
-        YAML::Node node = YAML::Load(v);
+    std::set<ValueType> operator()(const YAML::Node& node) {
         typename std::set<ValueType> vec;
-        std::stringstream ss;
-        for (size_t i = 0; i < node.size(); ++i) {
-            ss.str("");
-            ss << node[i];
-            vec.insert(LexicalCast<std::string, ValueType>()(ss.str()));
+        for (const auto& i : node) {
+            vec.insert(LexicalCast<YAML::Node, ValueType>()(i));
         }
         return vec;
     }
 };
 
+template <class ValueType>
+class LexicalCast<std::string, std::set<ValueType>> {
+public:
+    std::set<ValueType> operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, std::set<ValueType>>()(YAML::Load(v));
+    }
+};
+
 template <class ValueType>
 class LexicalCast<std::set<ValueType>, std::string> {
 public:
@@ -158,21 +229,25 @@ public:
 
 // unordered_set支持
 template <class ValueType>
-class LexicalCast<std::string, std::unordered_set<ValueType>> {
+class LexicalCast<YAML::Node, std::unordered_set<ValueType>> {
 public:
-    std::unordered_set<ValueType> operator()(const std::string& v) {
-        YAML::Node node = YAML::Load(v);
+    std::unordered_set<ValueType> operator()(const YAML::Node& node) {
         typename std::unordered_set<ValueType> vec;
-        std::stringstream ss;
-        for (size_t i = 0; i < node.size(); ++i) {
-            ss.str("");
-            ss << node[i];
-            vec.insert(LexicalCast<std::string, ValueType>()(ss.str()));
+        for (const auto& i : node) {
+            vec.insert(LexicalCast<YAML::Node, ValueType>()(i));
         }
         return vec;
     }
 };
 
+template <class ValueType>
+class LexicalCast<std::string, std::unordered_set<ValueType>> {
+public:
+    std::unordered_set<ValueType> operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, std::unordered_set<ValueType>>()(YAML::Load(v));
+    }
+};
+
 template <class ValueType>
 class LexicalCast<std::unordered_set<ValueType>, std::string> {
 public:
@@ -189,21 +264,25 @@ public:
 
 // map支持
 template <class ValueType>
-class LexicalCast<std::string, std::map<std::string, ValueType>> {
+class LexicalCast<YAML::Node, std::map<std::string, ValueType>> {
 public:
-    std::map<std::string, ValueType> operator()(const std::string& v) {
-        YAML::Node node = YAML::Load(v);
+    std::map<std::string, ValueType> operator()(const YAML::Node& node) {
         typename std::map<std::string, ValueType> vec;
-        std::stringstream ss;
         for (auto iter = node.begin(); iter != node.end(); ++iter) {
-            ss.str("");
-            ss << iter->second;
-            vec.emplace(iter->first.Scalar(), LexicalCast<std::string, ValueType>()(ss.str()));
+            vec.emplace(iter->first.Scalar(), LexicalCast<YAML::Node, ValueType>()(iter->second));
         }
         return vec;
     }
 };
 
+template <class ValueType>
+class LexicalCast<std::string, std::map<std::string, ValueType>> {
+public:
+    std::map<std::string, ValueType> operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, std::map<std::string, ValueType>>()(YAML::Load(v));
+    }
+};
+
 template <class ValueType>
 class LexicalCast<std::map<std::string, ValueType>, std::string> {
 public:
@@ -220,21 +299,25 @@ public:
 
 // unordered_map支持
 template <class ValueType>
-class LexicalCast<std::string, std::unordered_map<std::string, ValueType>> {
+class LexicalCast<YAML::Node, std::unordered_map<std::string, ValueType>> {
 public:
-    std::unordered_map<std::string, ValueType> operator()(const std::string& v) {
-        YAML::Node node = YAML::Load(v);
+    std::unordered_map<std::string, ValueType> operator()(const YAML::Node& node) {
         typename std::unordered_map<std::string, ValueType> vec;
-        std::stringstream ss;
         for (auto iter = node.begin(); iter != node.end(); ++iter) {
-            ss.str("");
-            ss << iter->second;
-            vec.emplace(iter->first.Scalar(), LexicalCast<std::string, ValueType>()(ss.str()));
+            vec.emplace(iter->first.Scalar(), LexicalCast<YAML::Node, ValueType>()(iter->second));
         }
         return vec;
     }
 };
 
+template <class ValueType>
+class LexicalCast<std::string, std::unordered_map<std::string, ValueType>> {
+public:
+    std::unordered_map<std::string, ValueType> operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, std::unordered_map<std::string, ValueType>>()(YAML::Load(v));
+    }
+};
+
 template <class ValueType>
 class LexicalCast<std::unordered_map<std::string, ValueType>, std::string> {
 public:
@@ -255,27 +338,58 @@ public:
  *          FromStr 从std::string转换成T类型的仿函数
  *          ToStr 从T转换成std::string的仿函数
  *          std::string 为YAML格式的字符串
+ *          参数值以不可变快照发布, 读取不加锁: 在RcuReadLock内atomic load取得快照,
+ *          修改时复制新快照替换, 旧快照延迟回收
  */
 template <class T, class FromStr = LexicalCast<std::string, T>, class ToStr = LexicalCast<T, std::string>>
 class ConfigVar : public ConfigVarBase {
 public:
     typedef std::shared_ptr<ConfigVar> ptr;
     typedef RWMutex RWMutexType;
+    // 参数值快照, 持有期间不受修改影响
+    typedef std::shared_ptr<const T> ValuePtr;
     // 配置更改回调函数
     typedef std::function<void(const T& old_value, const T& new_value)> on_change_cb;
 
+    /**
+     * @brief 线程局部的参数值缓存
+     * @details static thread_local ConfigVar<T>::Cache t_cache(g_var);
+     *          get()只读一次版本号, 版本不变时直接返回缓存快照的引用,
+     *          引用在同一Cache下一次get()之前有效
+     */
+    class Cache {
+    public:
+        explicit Cache(ConfigVar::ptr var) : m_var(std::move(var)) {}
+
+        const T& get() {
+            uint64_t version = m_var->getVersion();
+            if (version != m_version) {
+                m_value = m_var->getSnapshot();
+                m_version = version;
+            }
+            return *m_value;
+        }
+
+    private:
+        ConfigVar::ptr m_var;
+        ValuePtr m_value;
+        uint64_t m_version = 0;
+    };
+
     ConfigVar(const std::string& name, const T& default_value, const std::string& description = "")
-        : ConfigVarBase(name, description), m_val(default_value) {}
+        : ConfigVarBase(name, description), m_val(new ValuePtr(std::make_shared<const T>(default_value))) {}
+
+    ~ConfigVar() { delete m_val.load(); }
 
     std::string toString() override {
         try {
-            RWMutexType::ReadLock lock(m_mutex);
+            RcuReadLock lock;
 
             // return boost::lexical_cast<std::string>(m_val);
-            return ToStr()(m_val);
+            return ToStr()(**m_val.load(std::memory_order_acquire));
         } catch (const std::exception& e) {
             SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::toString exception " << e.what()
-                                              << " convert: " << typeid(m_val).name() << "to string";
+                                              << " convert: " << typeid(T).name() << "to string";
         }
         return "";
     }
@@ -286,33 +400,83 @@ public:
             setValue(FromStr()(val));
         } catch (const std::exception& e) {
             SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::fromString exception " << e.what()
-                                              << " convert: string to " << typeid(m_val).name();
+                                              << " convert: string to " << typeid(T).name();
+        }
+        return false;
+    }
+
+    bool fromYaml(const YAML::Node& node) override {
+        try {
+            if constexpr (std::is_same_v<FromStr, LexicalCast<std::string, T>>) {
+                setValue(LexicalCast<YAML::Node, T>()(node));
+            } else if (node.IsScalar()) {
+                // 自定义了字符串转换, 仍按字符串转换
+                setValue(FromStr()(node.Scalar()));
+            } else {
+                std::stringstream ss;
+                ss << node;
+                setValue(FromStr()(ss.str()));
+            }
+            return true;
+        } catch (const std::exception& e) {
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::fromYaml exception " << e.what()
+                                              << " convert: yaml to " << typeid(T).name();
         }
         return false;
     }
 
     std::string getTypeName() const override { return typeid(T).name(); }
 
+    /**
+     * @brief 返回参数值的拷贝
+     * @details 不加锁; 容器类型每次拷贝都有分配, 频繁读取时用Cache
+     */
     const T getValue() const {
-        RWMutexType::ReadLock lock(m_mutex);
+        RcuReadLock lock;
+
+        return **m_val.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief 返回参数值的快照
+     * @details 在读临界区(RcuReadLock, 含一次全屏障)内取得快照并增加引用计数, 不拷贝值.
+     *          引用计数为所有读者共享, 多线程频繁读取时其缓存行在核间往返;
+     *          热路径用Cache, 版本号未变时只读一个原子变量
+     */
+    ValuePtr getSnapshot() const {
+        RcuReadLock lock;
 
-        return m_val;
+        return *m_val.load(std::memory_order_acquire);
     }
 
+    /**
+     * @brief 参数值的版本号, 每次修改加1
+     * @details 先发布快照再增加版本号, 读到版本号后取得的快照不会旧于该版本
+     */
+    uint64_t getVersion() const { return m_version.load(std::memory_order_acquire); }
+
     void setValue(const T& val) {
         {
             RWMutexType::ReadLock lock(m_mutex);
 
-            if (val == m_val) {
+            ValuePtr old_value = getSnapshot();
+            if (val == *old_value) {
                 return;
             }
             for (auto& i : m_cbs) {
-                i.second(m_val, val);
+                i.second(*old_value, val);
             }
         }
-        RWMutexType::WriteLock lock(m_mutex);
+        const ValuePtr* new_value = new ValuePtr(std::make_shared<const T>(val));
+        const ValuePtr* old_value;
+        {
+            RWMutexType::WriteLock lock(m_mutex);
 
-        m_val = val;
+            old_value = m_val.load(std::memory_order_relaxed);
+            m_val.store(new_value, std::memory_order_release);
+            m_version.fetch_add(1, std::memory_order_release);
+        }
+        RcuRetire(old_value);
     }
 
     uint64_t addListener(on_change_cb cb) {
@@ -344,10 +508,12 @@ public:
     }
 
 private:
-    T m_val;
+    std::atomic<const ValuePtr*> m_val;  // 当前快照, 读者在RcuReadLock内无锁读取
+    std::atomic<uint64_t> m_version{1};
     // 变更回调函数组, uint_64 key, 要求唯一, 可以用hash
     std::map<uint64_t, on_change_cb> m_cbs;
 
+    // 保护m_cbs, 写锁下替换快照
     mutable RWMutexType m_mutex;
 };
 
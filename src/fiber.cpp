@@ -12,7 +12,17 @@
 
 #include "fiber.h"
 
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <time.h>
+
 #include <atomic>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <typeinfo>
+#include <vector>
 
 #include "config.h"
 #include "log.h"
@@ -25,6 +35,7 @@ static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
 static std::atomic<uint64_t> s_fiber_id{0};
 static std::atomic<uint64_t> s_fiber_count{0};
+static std::atomic<size_t> s_local_slot{0};
 
 static thread_local Fiber* t_fiber = nullptr;            // 当前协程
 static thread_local Fiber::ptr t_threadFiber = nullptr;  // 线程协程 (主协程)
@@ -45,6 +56,130 @@ public:
 
 using StackAllocator = MallocStackAllocator;
 
+static ConfigVar<bool>::ptr g_fiber_registry =
+    Config::Lookup<bool>("fiber.registry", false, "record live fibers for DumpFibers");
+
+static std::atomic<bool> s_registry_enabled{false};
+
+static const size_t REGISTRY_SHARD_COUNT = 16;
+static const int REGISTRY_SITE_DEPTH = 16;
+
+static pid_t GetCachedThreadId() {
+    static thread_local pid_t t_thread_id = 0;
+    if (!t_thread_id) {
+        t_thread_id = GetThreadId();
+    }
+    return t_thread_id;
+}
+
+/**
+ * @brief 协程登记信息, 挂在所属分片的双向链表上
+ */
+struct FiberRegistryNode {
+    Fiber* fiber = nullptr;
+    FiberRegistryNode* prev = nullptr;
+    FiberRegistryNode* next = nullptr;
+    size_t shard = 0;
+
+    void* site[REGISTRY_SITE_DEPTH];                // 创建时的调用栈
+    int site_depth = 0;                             // 调用栈深度
+    const std::type_info* cb_type = nullptr;        // 协程函数类型
+    std::atomic<uint64_t> last_switch{0};           // 上次切换时间(ms, CLOCK_MONOTONIC)
+    std::atomic<Scheduler*> scheduler{nullptr};     // 上次运行的调度器
+    std::atomic<pid_t> thread_id{0};                // 上次运行的线程
+};
+
+/**
+ * @brief 按节点地址分片的协程登记表, 降低创建/销毁时的锁竞争
+ */
+class FiberRegistry {
+public:
+    typedef Mutex MutexType;
+
+    void add(FiberRegistryNode* node) {
+        node->shard = ((uintptr_t)node >> 6) % REGISTRY_SHARD_COUNT;
+        Shard& shard = m_shards[node->shard];
+        MutexType::Lock lock(shard.mutex);
+        node->next = shard.head;
+        if (shard.head) {
+            shard.head->prev = node;
+        }
+        shard.head = node;
+    }
+
+    void del(FiberRegistryNode* node) {
+        Shard& shard = m_shards[node->shard];
+        MutexType::Lock lock(shard.mutex);
+        if (node->prev) {
+            node->prev->next = node->next;
+        } else {
+            shard.head = node->next;
+        }
+        if (node->next) {
+            node->next->prev = node->prev;
+        }
+    }
+
+    template <class Visitor>
+    void visit(Visitor visitor) {
+        for (auto& shard : m_shards) {
+            MutexType::Lock lock(shard.mutex);
+            for (FiberRegistryNode* node = shard.head; node; node = node->next) {
+                visitor(node);
+            }
+        }
+    }
+
+private:
+    struct Shard {
+        MutexType mutex;
+        FiberRegistryNode* head = nullptr;
+    };
+    Shard m_shards[REGISTRY_SHARD_COUNT];
+};
+
+static FiberRegistry& GetFiberRegistry() {
+    static FiberRegistry s_registry;
+    return s_registry;
+}
+
+struct FiberRegistryIniter {
+    FiberRegistryIniter() {
+        s_registry_enabled = g_fiber_registry->getValue();
+        g_fiber_registry->addListener([](const bool& old_value, const bool& new_value) {
+            s_registry_enabled = new_value;
+        });
+    }
+};
+static FiberRegistryIniter __fiber_registry_init;
+
+static FiberRegistryNode* RegisterFiber(Fiber* fiber, const std::function<void()>& cb) {
+    if (!s_registry_enabled) {
+        return nullptr;
+    }
+    FiberRegistryNode* node = new FiberRegistryNode();
+    node->fiber = fiber;
+    node->site_depth = ::backtrace(node->site, REGISTRY_SITE_DEPTH);
+    node->cb_type = cb ? &cb.target_type() : nullptr;
+    node->last_switch = GetMonotonicMS();
+    node->thread_id = GetCachedThreadId();
+    GetFiberRegistry().add(node);
+    return node;
+}
+
+static void UnregisterFiber(FiberRegistryNode* node) {
+    if (node) {
+        GetFiberRegistry().del(node);
+        delete node;
+    }
+}
+
+// 调度协程: 有调度器时为调度器主协程, 否则为线程主协程
+static Fiber* GetScheduleFiber() {
+    Fiber* fiber = Scheduler::GetMainFiber();
+    return fiber ? fiber : t_threadFiber.get();
+}
+
 uint64_t Fiber::GetFiberId() {
     if (t_fiber) {
         return t_fiber->getId();
@@ -61,6 +196,7 @@ Fiber::Fiber() {
     }
 
     ++s_fiber_count;
+    m_registry = RegisterFiber(this, m_cb);
 
     SYLAR_LOG_DEBUG(g_logger) << "Fiber::Fiber";
 }
@@ -84,19 +220,22 @@ Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool use_caller)
     } else {
         makecontext(&m_ctx, &Fiber::CallerMainFunc, 0);
     }
+    m_registry = RegisterFiber(this, m_cb);
 
     SYLAR_LOG_DEBUG(g_logger) << "Fiber::Fiber id=" << m_id;
 }
 
 Fiber::~Fiber() {
     --s_fiber_count;
+    clearLocals();
+    UnregisterFiber(m_registry);
     if (m_stack) {
         SYLAR_ASSERT(m_state == TERM || m_state == EXCEPT || m_state == INIT);
 
         StackAllocator::Dealloc(m_stack, m_stacksize);
     } else {
         SYLAR_ASSERT(!m_cb);
-        SYLAR_ASSERT(m_state = EXEC);
+        SYLAR_ASSERT(m_state == EXEC);
 
         Fiber* curr = t_fiber;
         if (curr == this) {
@@ -109,7 +248,11 @@ Fiber::~Fiber() {
 void Fiber::reset(std::function<void()> cb) {
     SYLAR_ASSERT(m_stack);
     SYLAR_ASSERT(m_state == TERM || m_state == EXCEPT || m_state == INIT);
+    clearLocals();
     m_cb = cb;
+    if (m_registry && m_cb) {
+        m_registry->cb_type = &m_cb.target_type();
+    }
     if (getcontext(&m_ctx)) {
         SYLAR_ASSERT2(false, "getcontext");
     }
@@ -122,19 +265,41 @@ void Fiber::reset(std::function<void()> cb) {
     m_state = INIT;
 }
 
-void Fiber::swapIn() {
+#ifdef SYLAR_FIBER_ACCOUNTING
+#define SYLAR_FIBER_ACCOUNT_BEGIN() uint64_t account_begin = GetMonotonicNS()
+#define SYLAR_FIBER_ACCOUNT_END() account(account_begin)
+#else
+#define SYLAR_FIBER_ACCOUNT_BEGIN()
+#define SYLAR_FIBER_ACCOUNT_END()
+#endif
+
+Fiber::State Fiber::swapIn() {
     SetThis(this);
     SYLAR_ASSERT(m_state != EXEC);
     m_state = EXEC;
+    onSwitch();
 
-    if (swapcontext(&Scheduler::GetMainFiber()->m_ctx, &m_ctx)) {
+    SYLAR_FIBER_ACCOUNT_BEGIN();
+    if (swapcontext(&GetScheduleFiber()->m_ctx, &m_ctx)) {
         SYLAR_ASSERT2(false, "swapcontext");
     }
+    // 必须在置为HOLD之前统计, 之后协程可能已在其他线程运行
+    SYLAR_FIBER_ACCOUNT_END();
+    // 仍为EXEC说明协程通过YieldToHold让出, 此时上下文已保存完毕,
+    // 置为HOLD(release)后才允许其他线程再次调度该协程, 之后不能再读取其状态
+    State state = m_state.load(std::memory_order_relaxed);
+    if (state == EXEC) {
+        state = HOLD;
+        m_state.store(HOLD, std::memory_order_release);
+    }
+    return state;
 }
 
 void Fiber::swapOut() {
-    SetThis(Scheduler::GetMainFiber());
-    if (swapcontext(&m_ctx, &Scheduler::GetMainFiber()->m_ctx)) {
+    Fiber* main_fiber = GetScheduleFiber();
+    SetThis(main_fiber);
+    onSwitch();
+    if (swapcontext(&m_ctx, &main_fiber->m_ctx)) {
         SYLAR_ASSERT2(false, "swapcontext");
     }
 }
@@ -142,43 +307,179 @@ void Fiber::swapOut() {
 void Fiber::call() {
     SetThis(this);
     m_state = EXEC;
+    onSwitch();
+    SYLAR_FIBER_ACCOUNT_BEGIN();
     if (swapcontext(&t_threadFiber->m_ctx, &m_ctx)) {
         SYLAR_ASSERT2(false, "swapcontext");
     }
+    SYLAR_FIBER_ACCOUNT_END();
 }
 
 void Fiber::back() {
     SetThis(t_threadFiber.get());
+    onSwitch();
     if (swapcontext(&m_ctx, &t_threadFiber->m_ctx)) {
         SYLAR_ASSERT2(false, "swapcontext");
     }
 }
 
+void Fiber::onSwitch() {
+    if (m_registry) {
+        m_registry->last_switch = GetMonotonicMS();
+        m_registry->scheduler = Scheduler::GetThis();
+        m_registry->thread_id = GetCachedThreadId();
+    }
+}
+
+static const uint32_t FIBER_TAG_MAX = 64;
+
+/**
+ * @brief 协程统计标签表, 统计值按标签id直接索引
+ */
+struct FiberTagTable {
+    Mutex mutex;
+    std::vector<std::string> names{"default"};
+    std::atomic<uint64_t> cpu_time[FIBER_TAG_MAX];
+    std::atomic<uint64_t> switches[FIBER_TAG_MAX];
+
+    FiberTagTable() {
+        for (uint32_t i = 0; i < FIBER_TAG_MAX; ++i) {
+            cpu_time[i] = 0;
+            switches[i] = 0;
+        }
+    }
+};
+
+static FiberTagTable& GetFiberTagTable() {
+    static FiberTagTable s_table;
+    return s_table;
+}
+
+void Fiber::account(uint64_t begin) {
+#ifdef SYLAR_FIBER_ACCOUNTING
+    uint64_t elapse = GetMonotonicNS() - begin;
+    m_cpu_time += elapse;
+    ++m_switches;
+    FiberTagTable& table = GetFiberTagTable();
+    table.cpu_time[m_tag].fetch_add(elapse, std::memory_order_relaxed);
+    table.switches[m_tag].fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+uint64_t Fiber::getCpuTime() const {
+#ifdef SYLAR_FIBER_ACCOUNTING
+    return m_cpu_time;
+#else
+    return 0;
+#endif
+}
+
+uint64_t Fiber::getSwitches() const {
+#ifdef SYLAR_FIBER_ACCOUNTING
+    return m_switches;
+#else
+    return 0;
+#endif
+}
+
+void Fiber::setTag(uint32_t tag) {
+    SYLAR_ASSERT(tag < FIBER_TAG_MAX);
+#ifdef SYLAR_FIBER_ACCOUNTING
+    m_tag = tag;
+#endif
+}
+
+uint32_t Fiber::getTag() const {
+#ifdef SYLAR_FIBER_ACCOUNTING
+    return m_tag;
+#else
+    return 0;
+#endif
+}
+
+uint32_t Fiber::RegisterTag(const std::string& name) {
+    FiberTagTable& table = GetFiberTagTable();
+    Mutex::Lock lock(table.mutex);
+    for (uint32_t i = 0; i < table.names.size(); ++i) {
+        if (table.names[i] == name) {
+            return i;
+        }
+    }
+    SYLAR_ASSERT2(table.names.size() < FIBER_TAG_MAX, "fiber tag exhausted, max=" + std::to_string(FIBER_TAG_MAX));
+    table.names.emplace_back(name);
+    return table.names.size() - 1;
+}
+
+std::vector<Fiber::TagStats> Fiber::GetTagStats() {
+    FiberTagTable& table = GetFiberTagTable();
+    Mutex::Lock lock(table.mutex);
+    std::vector<TagStats> stats(table.names.size());
+    for (uint32_t i = 0; i < table.names.size(); ++i) {
+        stats[i].name = table.names[i];
+        stats[i].cpu_time = table.cpu_time[i];
+        stats[i].switches = table.switches[i];
+    }
+    return stats;
+}
+
+void Fiber::setLocal(size_t slot, void* data, void (*destroy)(void*)) {
+    SYLAR_ASSERT(slot < LOCAL_SLOT_MAX);
+    LocalSlot old = m_locals[slot];
+    m_locals[slot].data = data;
+    m_locals[slot].destroy = destroy;
+    if (old.data && old.destroy) {
+        old.destroy(old.data);
+    }
+}
+
+void Fiber::clearLocals() {
+    for (auto& local : m_locals) {
+        if (local.data) {
+            LocalSlot old = local;
+            local = LocalSlot();
+            if (old.destroy) {
+                old.destroy(old.data);
+            }
+        }
+    }
+}
+
+size_t Fiber::AllocLocalSlot() {
+    size_t slot = s_local_slot++;
+    SYLAR_ASSERT2(slot < LOCAL_SLOT_MAX, "fiber local slot exhausted, max=" + std::to_string(LOCAL_SLOT_MAX));
+    return slot;
+}
+
 void Fiber::SetThis(Fiber* f) {
     t_fiber = f;
 }
 
 Fiber::ptr Fiber::GetThis() {
+    return GetThisRaw()->shared_from_this();
+}
+
+Fiber* Fiber::GetThisRaw() {
     if (t_fiber) {
-        return t_fiber->shared_from_this();
+        return t_fiber;
     }
 
     // 创建主协程
     Fiber::ptr main_fiber(new Fiber());
     SYLAR_ASSERT(t_fiber == main_fiber.get());
     t_threadFiber = main_fiber;
-    return t_fiber->shared_from_this();
+    return t_fiber;
 }
 
+// 让出时协程仍被调度器或调用者持有, 无需增加引用计数
 void Fiber::YieldToReady() {
-    Fiber::ptr curr = GetThis();
+    Fiber* curr = GetThisRaw();
     curr->m_state = READY;
     curr->swapOut();
 }
 
 void Fiber::YieldToHold() {
-    Fiber::ptr curr = GetThis();
-    curr->m_state = HOLD;
+    Fiber* curr = GetThisRaw();
+    // 保持EXEC直到切换完成, 由swapIn置为HOLD, 避免上下文保存前被其他线程唤醒
     curr->swapOut();
 }
 
@@ -187,6 +488,8 @@ uint64_t Fiber::TotalFibers() {
 }
 
 void Fiber::MainFunc() {
+    // 执行期间持有一份引用, 防止m_cb中释放最后一个持有者后协程被析构
+    // 每次运行只增减一次引用计数, 让出时不再产生开销
     Fiber::ptr curr = GetThis();
     SYLAR_ASSERT(curr);
     try {
@@ -203,6 +506,7 @@ void Fiber::MainFunc() {
         curr->m_state = EXCEPT;
         SYLAR_LOG_ERROR(g_logger) << "Fiber Except";
     }
+    curr->clearLocals();
 
     // 获取当前协程裸指针
     auto raw_ptr = curr.get();
@@ -213,6 +517,7 @@ void Fiber::MainFunc() {
 }
 
 void Fiber::CallerMainFunc() {
+    // 同MainFunc, 执行期间持有一份引用
     Fiber::ptr curr = GetThis();
     SYLAR_ASSERT(curr);
     try {
@@ -229,6 +534,7 @@ void Fiber::CallerMainFunc() {
         curr->m_state = EXCEPT;
         SYLAR_LOG_ERROR(g_logger) << "Fiber Except";
     }
+    curr->clearLocals();
 
     // 获取当前协程裸指针
     auto raw_ptr = curr.get();
@@ -238,4 +544,120 @@ void Fiber::CallerMainFunc() {
     SYLAR_ASSERT2(false, "never reach fiber_id=" + std::to_string(raw_ptr->getId()));
 }
 
+static const char* FiberStateToString(Fiber::State state) {
+    switch (state) {
+#define XX(name)        \
+    case Fiber::name:   \
+        return #name;
+        XX(INIT);
+        XX(HOLD);
+        XX(EXEC);
+        XX(TERM);
+        XX(READY);
+        XX(EXCEPT);
+#undef XX
+        default:
+            return "UNKNOW";
+    }
+}
+
+static std::string Demangle(const char* name) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status != 0 || !demangled) {
+        return name;
+    }
+    std::string rt(demangled);
+    free(demangled);
+    return rt;
+}
+
+void Fiber::DumpFibers(std::ostream& os, bool verbose) {
+    // 创建位置 -> 各状态协程数
+    struct SiteSummary {
+        std::vector<void*> site;
+        const std::type_info* cb_type = nullptr;
+        std::map<State, uint64_t> states;
+        uint64_t max_idle = 0;
+    };
+    std::map<std::pair<std::vector<void*>, const std::type_info*>, SiteSummary> sites;
+    uint64_t now = GetMonotonicMS();
+    uint64_t total = 0;
+    std::stringstream details;
+
+    GetFiberRegistry().visit([&](FiberRegistryNode* node) {
+        ++total;
+        State state = node->fiber->getState();
+        uint64_t idle = now - node->last_switch;
+        std::vector<void*> site(node->site, node->site + node->site_depth);
+        auto& summary = sites[std::make_pair(site, node->cb_type)];
+        summary.site.swap(site);
+        summary.cb_type = node->cb_type;
+        ++summary.states[state];
+        summary.max_idle = std::max(summary.max_idle, idle);
+        if (verbose) {
+            details << "    fiber_id=" << node->fiber->m_id
+                    << " state=" << FiberStateToString(state)
+                    << " idle=" << idle << "ms"
+                    << " thread=" << node->thread_id
+                    << " scheduler=" << node->scheduler.load()
+                    << std::endl;
+        }
+    });
+
+    os << "live fibers: registered=" << total << " total=" << TotalFibers() << std::endl;
+    for (auto& [key, summary] : sites) {
+        os << "  site:";
+        for (auto& [state, count] : summary.states) {
+            os << " " << FiberStateToString(state) << "=" << count;
+        }
+        os << " max_idle=" << summary.max_idle << "ms";
+        if (summary.cb_type) {
+            os << " cb=" << Demangle(summary.cb_type->name());
+        }
+        os << std::endl;
+        // 跳过RegisterFiber和Fiber构造函数本身
+        int skip = std::min<int>(2, summary.site.size());
+        char** strings = backtrace_symbols(summary.site.data() + skip, summary.site.size() - skip);
+        if (strings) {
+            for (size_t i = 0; i < summary.site.size() - skip; ++i) {
+                os << "      " << strings[i] << std::endl;
+            }
+            free(strings);
+        }
+    }
+    if (verbose) {
+        os << details.str();
+    }
+}
+
+// 信号处理函数只读取指针, 无锁的原子指针是异步信号安全的
+static std::atomic<Semaphore*> s_dump_sem{nullptr};
+
+static void DumpSignalHandler(int sig) {
+    // sem_post是异步信号安全的
+    Semaphore* sem = s_dump_sem.load(std::memory_order_acquire);
+    if (sem) {
+        sem->notify();
+    }
+}
+
+void Fiber::DumpFibersOnSignal(int sig) {
+    static std::once_flag s_once;
+    std::call_once(s_once, []() {
+        // 不析构, 进程退出时输出线程仍可能在等待
+        Semaphore* sem = new Semaphore(0);
+        static Thread::ptr s_dump_thread = std::make_shared<Thread>([sem]() {
+            while (true) {
+                sem->wait();
+                std::stringstream ss;
+                DumpFibers(ss, true);
+                SYLAR_LOG_INFO(g_logger) << "fiber dump\n" << ss.str();
+            }
+        }, "fiber_dump");
+        s_dump_sem.store(sem, std::memory_order_release);
+    });
+    signal(sig, &DumpSignalHandler);
+}
+
 }  // namespace sylar
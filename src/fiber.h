@@ -14,20 +14,28 @@
 
 #include <ucontext.h>
 
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
 
 #include "thread.h"
 
 namespace sylar {
 
 class Scheduler;
+struct FiberRegistryNode;
 class Fiber : public std::enable_shared_from_this<Fiber> {
     friend class Scheduler;
 
 public:
     typedef std::shared_ptr<Fiber> ptr;
 
+    // 每个协程可用的协程局部变量槽位数
+    static const size_t LOCAL_SLOT_MAX = 16;
+
     enum State {
         INIT,
         HOLD,
@@ -51,8 +59,10 @@ public:
 
     /**
      * @brief 切换到当前协程执行
+     * @return 切换回来时协程的状态. 通过YieldToHold让出时为HOLD, 置为HOLD后协程可能已被
+     *         其他线程唤醒, 调用者应使用返回值而不是再次getState()
      */
-    void swapIn();
+    State swapIn();
 
     /**
      * @brief 切换到后台协程执行
@@ -72,7 +82,44 @@ public:
     /**
      * @brief 返回协程状态
      */
-    State getState() const { return m_state; }
+    State getState() const { return m_state.load(std::memory_order_acquire); }
+
+    /**
+     * @brief 返回协程累计运行时间(ns), 需开启SYLAR_FIBER_ACCOUNTING
+     */
+    uint64_t getCpuTime() const;
+
+    /**
+     * @brief 返回协程被切换执行的次数, 需开启SYLAR_FIBER_ACCOUNTING
+     */
+    uint64_t getSwitches() const;
+
+    /**
+     * @brief 设置统计标签, 运行时间同时累加到该标签
+     */
+    void setTag(uint32_t tag);
+    uint32_t getTag() const;
+
+    /**
+     * @brief 返回槽位slot上的协程局部变量, 未设置时返回nullptr
+     */
+    void* getLocal(size_t slot) const { return m_locals[slot].data; }
+
+    /**
+     * @brief 设置槽位slot上的协程局部变量
+     * @param[in] destroy 协程结束或重置时用于释放data
+     */
+    void setLocal(size_t slot, void* data, void (*destroy)(void*));
+
+    /**
+     * @brief 释放所有协程局部变量
+     */
+    void clearLocals();
+
+    /**
+     * @brief 分配一个协程局部变量槽位, 槽位不回收
+     */
+    static size_t AllocLocalSlot();
 
     /**
      * @brief 设置当前协程
@@ -86,6 +133,12 @@ public:
      */
     static Fiber::ptr GetThis();
 
+    /**
+     * @brief 返回当前协程裸指针, 不改变引用计数
+     * @details 供切换等热路径使用, 当前线程没有协程时创建主协程
+     */
+    static Fiber* GetThisRaw();
+
     /**
      * @brief 协程切换到后台, 并且设置为Ready状态
      */
@@ -93,6 +146,7 @@ public:
 
     /**
      * @brief 协程切换到后台, 并且设置为Hold状态
+     * @details 切换完成后才置为HOLD, 因此可以在让出前把自己交给其他线程唤醒
      */
     static void YieldToHold();
 
@@ -108,15 +162,113 @@ public:
 
     static uint64_t GetFiberId();
 
+    /**
+     * @brief 按标签汇总的运行统计
+     */
+    struct TagStats {
+        std::string name;       // 标签名
+        uint64_t cpu_time = 0;  // 累计运行时间(ns)
+        uint64_t switches = 0;  // 累计切换次数
+    };
+
+    /**
+     * @brief 注册统计标签, 同名标签返回相同id, 0为默认标签
+     */
+    static uint32_t RegisterTag(const std::string& name);
+
+    /**
+     * @brief 返回所有标签的运行统计, 未开启SYLAR_FIBER_ACCOUNTING时均为0
+     */
+    static std::vector<TagStats> GetTagStats();
+
+    /**
+     * @brief 输出存活协程的汇总信息
+     * @details 需开启配置fiber.registry, 开启后创建的协程才会被登记.
+     *          按创建位置汇总各状态的协程数, verbose时逐个输出协程的状态,
+     *          距上次切换的时间, 所在线程和调度器
+     */
+    static void DumpFibers(std::ostream& os, bool verbose = false);
+
+    /**
+     * @brief 收到信号sig时将DumpFibers的结果写入system日志
+     * @details 信号处理函数只唤醒后台线程, 输出在后台线程中完成
+     */
+    static void DumpFibersOnSignal(int sig);
+
+private:
+    // 协程切换时更新登记信息
+    void onSwitch();
+
+    // 切换回调度协程后累加本次运行时间, begin为切入时刻
+    void account(uint64_t begin);
+
 private:
     uint64_t m_id = 0;         // 协程号
     uint32_t m_stacksize = 0;  // 栈大小
-    State m_state = INIT;      // 运行状态
+    std::atomic<State> m_state{INIT};  // 运行状态, 让出后由调度线程置为HOLD, 其他线程读取
 
     ucontext_t m_ctx;
     void* m_stack = nullptr;
 
     std::function<void()> m_cb;  // 协程执行函数
+
+    struct LocalSlot {
+        void* data = nullptr;
+        void (*destroy)(void*) = nullptr;
+    };
+    LocalSlot m_locals[LOCAL_SLOT_MAX];  // 协程局部变量
+
+    FiberRegistryNode* m_registry = nullptr;  // 登记信息, 未开启登记时为空
+
+#ifdef SYLAR_FIBER_ACCOUNTING
+    uint64_t m_cpu_time = 0;  // 累计运行时间(ns)
+    uint64_t m_switches = 0;  // 切换次数
+    uint32_t m_tag = 0;       // 统计标签
+#endif
+};
+
+/**
+ * @brief 协程局部变量
+ * @details 值保存在当前协程的槽位数组中, 随协程在调度器线程间迁移,
+ *          首次访问时构造, 协程结束(TERM/EXCEPT), reset()或析构时释放.
+ *          槽位不回收, 应定义为全局或静态变量
+ */
+template <class T>
+class FiberLocal {
+public:
+    FiberLocal() : m_slot(Fiber::AllocLocalSlot()) {}
+
+    /**
+     * @brief 返回当前协程上的值, 不存在时默认构造
+     */
+    T& get() {
+        Fiber* fiber = Fiber::GetThisRaw();
+        void* data = fiber->getLocal(m_slot);
+        if (!data) {
+            data = new T();
+            fiber->setLocal(m_slot, data, &FiberLocal::Destroy);
+        }
+        return *static_cast<T*>(data);
+    }
+
+    /**
+     * @brief 当前协程上是否已构造
+     */
+    bool has() const { return Fiber::GetThisRaw()->getLocal(m_slot) != nullptr; }
+
+    /**
+     * @brief 释放当前协程上的值
+     */
+    void reset() { Fiber::GetThisRaw()->setLocal(m_slot, nullptr, nullptr); }
+
+    T& operator*() { return get(); }
+    T* operator->() { return &get(); }
+
+private:
+    static void Destroy(void* data) { delete static_cast<T*>(data); }
+
+private:
+    size_t m_slot;
 };
 
 }  // namespace sylar
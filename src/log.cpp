@@ -12,18 +12,39 @@
 
 #include "log.h"
 
+#include <ctype.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <math.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdarg.h>
-
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <fstream>
 #include <functional>
 #include <iostream>
 #include <list>
 #include <map>
+#include <set>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "config.h"
+#include "log_binary.h"
+#include "log_pattern.h"
+#include "lz.h"
+#include "rcu.h"
 
 namespace sylar {
 
@@ -70,118 +91,166 @@ LogLevel::Level LogLevel::FromString(const std::string& str) {
 #undef XX
 }
 
-class MessageFormatItem : public LogFormatter::FormatItem {
-public:
-    MessageFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << event->getContent();
-    }
-};
-class LevelFormatItem : public LogFormatter::FormatItem {
-public:
-    LevelFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << LogLevel::ToString(level);
-    }
-};
-class ElapseFormatItem : public LogFormatter::FormatItem {
-public:
-    ElapseFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << event->getElapse();
+LogBuffer& LogBuffer::operator=(const LogBuffer& oth) {
+    if (this == &oth) {
+        return *this;
     }
-};
-class NameFormatItem : public LogFormatter::FormatItem {
-public:
-    NameFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << event->getLogger()->getName();
+    if (oth.m_spilled) {
+        m_spill.assign(oth.m_spill);
+        m_spilled = true;
+        m_size = 0;
+    } else {
+        memcpy(m_inline, oth.m_inline, oth.m_size);
+        m_size = oth.m_size;
+        m_spilled = false;
+        m_spill.clear();
     }
-};
-class ThreadIdFormatItem : public LogFormatter::FormatItem {
-public:
-    ThreadIdFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << event->getThreadId();
+    return *this;
+}
+
+void LogBuffer::append(const char* str, size_t len) {
+    if (!m_spilled) {
+        if (m_size + len <= INLINE_SIZE) {
+            memcpy(m_inline + m_size, str, len);
+            m_size += len;
+            return;
+        }
+        spill(m_size + len);
     }
-};
-class ThreadNameFormatItem : public LogFormatter::FormatItem {
-public:
-    ThreadNameFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << event->getThreadName();
+    m_spill.append(str, len);
+}
+
+void LogBuffer::appendf(const char* fmt, va_list al) {
+    va_list copy;
+    int len = 0;
+    if (!m_spilled) {
+        // 先尝试直接写入内置缓冲区, 放不下再转存
+        size_t avail = INLINE_SIZE - m_size;
+        va_copy(copy, al);
+        len = vsnprintf(m_inline + m_size, avail, fmt, copy);
+        va_end(copy);
+        if (len < 0) {
+            return;
+        }
+        if ((size_t)len < avail) {
+            m_size += len;
+            return;
+        }
+        spill(m_size + len + 1);
+    } else {
+        va_copy(copy, al);
+        len = vsnprintf(nullptr, 0, fmt, copy);
+        va_end(copy);
+        if (len < 0) {
+            return;
+        }
     }
-};
-class FiberIdFormatItem : public LogFormatter::FormatItem {
+    size_t old = m_spill.size();
+    m_spill.resize(old + len);
+    va_copy(copy, al);
+    vsnprintf(&m_spill[old], len + 1, fmt, copy);
+    va_end(copy);
+}
+
+void LogBuffer::clear() {
+    m_size = 0;
+    m_spilled = false;
+    m_spill.clear();
+}
+
+void LogBuffer::spill(size_t reserve) {
+    m_spill.reserve(reserve);
+    m_spill.assign(m_inline, m_size);
+    m_spilled = true;
+    m_size = 0;
+}
+
+/**
+ * @brief 将std::ostream的输出直接写入LogBuffer
+ */
+class LogStreamBuf : public std::streambuf {
 public:
-    FiberIdFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << event->getFiberId();
+    void bind(LogEvent* event) {
+        m_event = event;
+        m_buffer = event ? &event->getBuffer() : nullptr;
     }
-};
-class TimeFormatItem : public LogFormatter::FormatItem {
-public:
-    TimeFormatItem(const std::string& format)
-        : m_format(format) {
-        if (m_format.empty()) {
-            m_format = "%Y-%m-%d %H:%M:%S";
+
+    LogEvent* getEvent() const { return m_event; }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (ch != traits_type::eof()) {
+            m_buffer->append((char)ch);
         }
+        return traits_type::not_eof(ch);
     }
-    void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        struct tm tm;
-        time_t time = event->getTime();
-        localtime_r(&time, &tm);
-        char buf[64];
-        strftime(buf, sizeof(buf), m_format.c_str(), &tm);
-        os << buf;
+
+    std::streamsize xsputn(const char* str, std::streamsize len) override {
+        m_buffer->append(str, len);
+        return len;
     }
 
 private:
-    std::string m_format;
-};
-class FilenameFormatItem : public LogFormatter::FormatItem {
-public:
-    FilenameFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << event->getFilename();
-    }
+    LogEvent* m_event = nullptr;
+    LogBuffer* m_buffer = nullptr;
 };
-class LineFormatItem : public LogFormatter::FormatItem {
-public:
-    LineFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << event->getLine();
-    }
-};
-class NewLineFormatItem : public LogFormatter::FormatItem {
+
+/**
+ * @brief 可绑定到日志事件的输出流, 每个线程复用一个
+ */
+class LogStream {
 public:
-    NewLineFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << std::endl;
+    LogStream() : m_os(&m_buf) { m_flags = m_os.flags(); }
+
+    std::ostream& stream() { return m_os; }
+    bool isBusy() const { return m_busy; }
+
+    void bind(LogEvent* event) {
+        m_buf.bind(event);
+        m_busy = true;
     }
-};
-class StringFormatItem : public LogFormatter::FormatItem {
-public:
-    StringFormatItem(const std::string& str) : m_string(str) {}
-    void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << m_string;
+
+    void unbind() {
+        m_buf.bind(nullptr);
+        m_busy = false;
+        // 恢复格式状态, 不影响下一条日志
+        m_os.clear();
+        m_os.flags(m_flags);
+        m_os.width(0);
+        m_os.precision(6);
+        m_os.fill(' ');
     }
 
 private:
-    std::string m_string;
+    LogStreamBuf m_buf;
+    std::ostream m_os;
+    std::ios_base::fmtflags m_flags;
+    bool m_busy = false;
 };
-class TabFormatItem : public LogFormatter::FormatItem {
-public:
-    TabFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << "\t";
-    }
+
+/**
+ * @brief 线程复用的日志输出流, 线程退出析构后不再使用
+ */
+struct LogStreamHolder {
+    LogStream stream;
+    bool* destroyed;
+
+    LogStreamHolder(bool* flag) : destroyed(flag) {}
+    ~LogStreamHolder() { *destroyed = true; }
 };
 
+static thread_local bool t_log_stream_destroyed = false;
+static thread_local LogStreamHolder t_log_stream(&t_log_stream_destroyed);
+
+LogEvent* LogStreamEvent(std::ostream& os) {
+    LogStreamBuf* buf = dynamic_cast<LogStreamBuf*>(os.rdbuf());
+    return buf ? buf->getEvent() : nullptr;
+}
+
 LogEvent::LogEvent(const char* file, int32_t line, uint32_t elapse,
-                   uint32_t thread_id, const std::string& thread_name,
+                   uint32_t thread_id, const char* thread_name,
                    uint32_t fiber_id, uint64_t time,
-                   std::shared_ptr<Logger> logger, LogLevel::Level level)
+                   Logger* logger, LogLevel::Level level)
     : m_file(file),
       m_line(line),
       m_elapse(elapse),
@@ -192,10 +261,26 @@ LogEvent::LogEvent(const char* file, int32_t line, uint32_t elapse,
       m_logger(logger),
       m_level(level) {}
 
-LogEventWrap::LogEventWrap(LogEvent::ptr event) : m_event(event) {}
+void LogEvent::retainLogger() {
+    if (m_logger && !m_holder) {
+        m_holder = m_logger->weak_from_this().lock();
+    }
+}
 
-LogEventWrap::~LogEventWrap() {
-    m_event->getLogger()->log(m_event->getLevel(), m_event);
+void LogEvent::reset() {
+    m_holder.reset();
+    m_buffer.clear();
+    m_fields.clear();
+    m_site = nullptr;
+}
+
+std::string LogEvent::getContent() const {
+    if (!m_site) {
+        return std::string(m_buffer.view());
+    }
+    LogBuffer buffer;
+    LogBinRender(buffer, m_site->fmt, m_site->types, m_buffer.data(), m_buffer.size());
+    return std::string(buffer.view());
 }
 
 void LogEvent::format(const char* fmt, ...) {
@@ -206,16 +291,139 @@ void LogEvent::format(const char* fmt, ...) {
 }
 
 void LogEvent::format(const char* fmt, va_list al) {
-    char* buf = nullptr;
-    int len = vasprintf(&buf, fmt, al);
-    if (len != -1) {
-        m_ss << std::string(buf, len);
-        free(buf);
+    m_buffer.appendf(fmt, al);
+}
+
+static void LogFormatInt(LogBuffer& out, char conv, uint64_t v, bool negative) {
+    int base = conv == 'x' || conv == 'X' ? 16 : conv == 'o' ? 8 : conv == 'b' ? 2 : 10;
+    LogAppendInt(out, negative ? -v : v, negative, base, conv == 'X');
+}
+
+static void LogFormatDouble(LogBuffer& out, std::string_view spec, double v) {
+    char buf[512];
+    std::to_chars_result res;
+    if (spec.empty()) {
+        res = std::to_chars(buf, buf + sizeof(buf), v);
+    } else {
+        int precision = -1;
+        size_t i = 0;
+        if (spec[0] == '.') {
+            precision = 0;
+            while (++i < spec.size() && isdigit(spec[i])) {
+                precision = precision * 10 + spec[i] - '0';
+            }
+        }
+        std::chars_format fmt = std::chars_format::general;
+        if (i < spec.size()) {
+            fmt = spec[i] == 'f' ? std::chars_format::fixed
+                : spec[i] == 'e' ? std::chars_format::scientific
+                : std::chars_format::general;
+        }
+        res = precision < 0 ? std::to_chars(buf, buf + sizeof(buf), v, fmt)
+                            : std::to_chars(buf, buf + sizeof(buf), v, fmt, precision);
+    }
+    // 精度最多两位, 缓冲区足以容纳任何结果
+    if (res.ec == std::errc()) {
+        out.append(buf, res.ptr - buf);
+    }
+}
+
+void LogFormatTo(LogBuffer& out, std::string_view fmt, const LogFormatArg* args, size_t count) {
+    // 格式串已在编译期检查, 这里只做一遍扫描
+    const char* p = fmt.data();
+    const char* end = p + fmt.size();
+    const LogFormatArg* arg = args;
+    const LogFormatArg* arg_end = args + count;
+    while (p < end) {
+        const char* begin = p;
+        while (p < end && *p != '{' && *p != '}') {
+            ++p;
+        }
+        if (p != begin) {
+            out.append(begin, p - begin);
+        }
+        if (p == end) {
+            break;
+        }
+        if (p + 1 < end && p[1] == *p) {
+            out.append(*p);
+            p += 2;
+            continue;
+        }
+        const char* spec = ++p;
+        while (p < end && *p != '}') {
+            ++p;
+        }
+        if (p == end || arg == arg_end) {
+            break;
+        }
+        if (*spec == ':') {
+            ++spec;
+        }
+        std::string_view spec_view(spec, p - spec);
+        char conv = spec_view.empty() ? 'd' : spec[0];
+        ++p;
+
+        const LogFormatArg& v = *arg++;
+        switch (v.type) {
+            case LogFormatArg::INT:
+                LogFormatInt(out, conv, v.i, v.i < 0);
+                break;
+            case LogFormatArg::UINT:
+                LogFormatInt(out, conv, v.u, false);
+                break;
+            case LogFormatArg::DOUBLE:
+                LogFormatDouble(out, spec_view, v.d);
+                break;
+            case LogFormatArg::CHAR:
+                out.append(v.c);
+                break;
+            case LogFormatArg::BOOL:
+                v.b ? out.append("true", 4) : out.append("false", 5);
+                break;
+            case LogFormatArg::STRING:
+                out.append(v.s.data, v.s.len);
+                break;
+            case LogFormatArg::POINTER:
+                out.append("0x", 2);
+                LogFormatInt(out, 'x', (uintptr_t)v.p, false);
+                break;
+        }
+    }
+}
+
+LogEventWrap::LogEventWrap(const char* file, int32_t line, uint32_t elapse,
+                           uint32_t thread_id, const char* thread_name,
+                           uint32_t fiber_id, uint64_t time,
+                           Logger* logger, LogLevel::Level level)
+    : m_event(file, line, elapse, thread_id, thread_name, fiber_id, time, logger, level) {}
+
+LogEventWrap::~LogEventWrap() {
+    if (m_stream) {
+        m_stream->unbind();
+        if (m_own_stream) {
+            delete m_stream;
+        }
+    }
+    AsyncLogManager* async = AsyncLogMgr::GetInstance();
+    if (async->isEnabled() && async->push(m_event)) {
+        return;
     }
+    m_event.getLogger()->log(m_event.getLevel(), getEvent());
 }
 
-std::stringstream& LogEventWrap::getSS() {
-    return m_event->getSS();
+std::ostream& LogEventWrap::getSS() {
+    if (!m_stream) {
+        // 输出内容时又产生日志(嵌套)或线程正在退出时, 使用独立的流
+        if (!t_log_stream_destroyed && !t_log_stream.stream.isBusy()) {
+            m_stream = &t_log_stream.stream;
+        } else {
+            m_stream = new LogStream;
+            m_own_stream = true;
+        }
+        m_stream->bind(&m_event);
+    }
+    return m_stream->stream();
 }
 
 LogFormatter::ptr LogAppender::getFormatter() {
@@ -227,7 +435,7 @@ LogFormatter::ptr LogAppender::getFormatter() {
 void LogAppender::setFormatter(LogFormatter::ptr formatter) {
     MutexType::Lock lock(m_mutex);
 
-    m_formatter = formatter;
+    std::atomic_store(&m_formatter, formatter);
     if (m_formatter) {
         m_has_formatter = true;
     } else {
@@ -235,20 +443,151 @@ void LogAppender::setFormatter(LogFormatter::ptr formatter) {
     }
 }
 
+static Mutex& GetLogCallSiteMutex() {
+    // 不析构, 退出阶段析构的日志器仍会使用
+    static Mutex* s_mutex = new Mutex;
+    return *s_mutex;
+}
+
+static LogCallSite* s_log_call_sites = nullptr;
+// 失效次数, 失效值为其左移3位, 编码为0, 不会与缓存的判断结果相同
+static uintptr_t s_log_call_site_epoch = 0;
+
+void LogCallSite::InvalidateAll() {
+    Mutex::Lock lock(GetLogCallSiteMutex());
+    uintptr_t tag = ++s_log_call_site_epoch << 3;
+    for (LogCallSite* site = s_log_call_sites; site; site = site->m_next) {
+        site->m_tag.store(tag, std::memory_order_release);
+    }
+}
+
+void LogCallSite::registerSite() {
+    Mutex::Lock lock(GetLogCallSiteMutex());
+    if (!m_registered.load(std::memory_order_relaxed)) {
+        m_next = s_log_call_sites;
+        s_log_call_sites = this;
+        m_registered.store(true, std::memory_order_release);
+    }
+}
+
+bool LogCallSite::check(Logger* logger, LogLevel::Level level, uintptr_t code) {
+    if (code != TAG_LIMITED) {
+        code = refresh(logger);
+        if (code != TAG_LIMITED) {
+            return (uintptr_t)level + 1 >= code;
+        }
+    }
+    return level >= logger->getLevel() && admit(logger, level);
+}
+
+uintptr_t LogCallSite::refresh(Logger* logger) {
+    static_assert(alignof(Logger) > TAG_MASK, "LogCallSite stores its tag in the low bits of Logger*");
+    if (!m_registered.load(std::memory_order_acquire)) {
+        registerSite();
+    }
+    // 先读旧值再读日志器配置: 读到旧配置时, 之后的失效一定会使CAS失败或覆盖写回的结果
+    uintptr_t old = m_tag.load(std::memory_order_acquire);
+    uintptr_t code = logger->isLimited() ? (uintptr_t)TAG_LIMITED : (uintptr_t)logger->getLevel() + 1;
+    m_tag.compare_exchange_strong(old, (uintptr_t)logger | code, std::memory_order_relaxed);
+    return code;
+}
+
+// xorshift64*, 每个线程独立的状态
+static uint32_t LogSampleRandom() {
+    static thread_local uint64_t t_state = 0;
+    if (!t_state) {
+        t_state = (GetCurrentUS() << 16) ^ GetThreadId() ^ 0x9E3779B97F4A7C15ULL;
+    }
+    t_state ^= t_state >> 12;
+    t_state ^= t_state << 25;
+    t_state ^= t_state >> 27;
+    return (t_state * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+bool LogCallSite::admit(Logger* logger, LogLevel::Level level) {
+    double sample = logger->getSample();
+    if (sample < 1 && LogSampleRandom() >= sample * 4294967296.0) {
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint32_t rate = logger->getRateLimit();
+    if (rate) {
+        // GCRA: 每条日志使理论到达时间后移interval, 超前当前时间不超过tolerance时放行
+        uint64_t burst = logger->getBurst() ? logger->getBurst() : rate;
+        uint64_t interval = std::max<uint64_t>(1000000 / rate, 1);
+        uint64_t tolerance = interval * (burst - 1);
+        uint64_t now = GetMonotonicUS();
+        uint64_t tat = m_tat.load(std::memory_order_relaxed);
+        while (true) {
+            uint64_t t = std::max(tat, now);
+            if (t - now > tolerance) {
+                m_suppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (m_tat.compare_exchange_weak(tat, t + interval, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+    }
+
+    // 摘要每秒最多一条, 避免采样时每次放行都附带摘要
+    if (m_suppressed.load(std::memory_order_relaxed)) {
+        uint64_t now = GetMonotonicUS();
+        uint64_t last = m_last_report.load(std::memory_order_relaxed);
+        uint64_t suppressed = 0;
+        if (now - last >= 1000000 && m_last_report.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+            suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+        }
+        if (suppressed) {
+            LogEventWrap(m_file, m_line, GetElapsedMS(), GetThreadId(), Thread::GetInternedName(), GetFiberId(),
+                         GetWallClockUS(), logger, level)
+                .getEvent()
+                ->print("suppressed {} log events at this call site in the last {}ms", suppressed,
+                        last ? (now - last) / 1000 : 0);
+        }
+    }
+    return true;
+}
+
 Logger::Logger(const std::string& name)
     : m_name(name),
-      m_level(LogLevel::DEBUG) {
-    m_formatter.reset(new LogFormatter("%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T<%f:%l>%T%m%n"));
+      m_level(LogLevel::DEBUG),
+      m_appenders(new AppenderList) {
+    m_formatter.reset(new LogFormatter(SYLAR_LOG_DEFAULT_PATTERN));
+}
+
+Logger::~Logger() {
+    // 析构时不会再有读者
+    delete m_appenders.load();
+    // 地址可能被新的日志器复用
+    LogCallSite::InvalidateAll();
+}
+
+void Logger::setLevel(LogLevel::Level level) {
+    m_level = level;
+    LogCallSite::InvalidateAll();
+}
+
+void Logger::setRateLimit(uint32_t rate, uint32_t burst) {
+    m_rate_limit = rate;
+    m_burst = burst;
+    LogCallSite::InvalidateAll();
+}
+
+void Logger::setSample(double sample) {
+    m_sample = sample;
+    LogCallSite::InvalidateAll();
 }
 
 void Logger::log(LogLevel::Level level, LogEvent::ptr event) {
-    if (level >= m_level) {
+    if (level >= getLevel()) {
         // auto self = shared_from_this();
 
-        MutexType::Lock lock(m_mutex);
-
-        if (!m_appenders.empty()) {
-            for (auto& appender : m_appenders) {
+        RcuReadLock lock;
+        const AppenderList* appenders = m_appenders.load();
+        if (!appenders->empty()) {
+            for (auto& appender : *appenders) {
                 appender->log(level, event);
             }
         } else if (m_root) {
@@ -277,43 +616,51 @@ void Logger::fatal(LogEvent::ptr event) {
     log(LogLevel::Level::FATAL, event);
 }
 
+void Logger::updateAppenders(const std::function<void(AppenderList&)>& cb) {
+    const AppenderList* old_appenders = m_appenders.load();
+    AppenderList* appenders = new AppenderList(*old_appenders);
+    cb(*appenders);
+    m_appenders.store(appenders);
+    RcuRetire(old_appenders);
+}
+
 void Logger::addAppender(LogAppender::ptr appender) {
     MutexType::Lock lock(m_mutex);
     // appender没有自己的样式时, 用logger的样式初始化, 保持m_has_formatter不变
     if (!appender->getFormatter()) {
         MutexType::Lock lock(appender->m_mutex);
 
-        appender->m_formatter = m_formatter;
+        std::atomic_store(&appender->m_formatter, m_formatter);
     }
-    m_appenders.emplace_back(appender);
+    updateAppenders([&](AppenderList& appenders) { appenders.emplace_back(appender); });
 }
 
 void Logger::delAppender(LogAppender::ptr appender) {
     MutexType::Lock lock(m_mutex);
 
-    for (auto iter = m_appenders.begin(); iter != m_appenders.end(); ++iter) {
-        if (*iter == appender) {
-            m_appenders.erase(iter);
-            break;
+    updateAppenders([&](AppenderList& appenders) {
+        auto iter = std::find(appenders.begin(), appenders.end(), appender);
+        if (iter != appenders.end()) {
+            appenders.erase(iter);
         }
-    }
+    });
 }
 
 void Logger::clearAppenders() {
     MutexType::Lock lock(m_mutex);
 
-    m_appenders.clear();
+    updateAppenders([](AppenderList& appenders) { appenders.clear(); });
 }
 
 void Logger::setFormatter(LogFormatter::ptr formatter) {
     MutexType::Lock lock(m_mutex);
 
-    m_formatter = formatter;
-    for (auto& appender : m_appenders) {
+    std::atomic_store(&m_formatter, formatter);
+    for (auto& appender : *m_appenders.load()) {
         MutexType::Lock lock(appender->m_mutex);
 
         if (!appender->m_has_formatter) {
-            appender->m_formatter = formatter;
+            std::atomic_store(&appender->m_formatter, formatter);
         }
     }
 }
@@ -334,11 +681,20 @@ std::string Logger::toYamlString() {
 
     YAML::Node node;
     node["name"] = m_name;
-    node["level"] = LogLevel::ToString(m_level);
+    node["level"] = LogLevel::ToString(getLevel());
     if (m_formatter) {
         node["formatter"] = m_formatter->getPattern();
     }
-    for (auto& appender : m_appenders) {
+    if (getRateLimit()) {
+        node["rate_limit"] = getRateLimit();
+    }
+    if (getBurst()) {
+        node["burst"] = getBurst();
+    }
+    if (getSample() < 1) {
+        node["sample"] = getSample();
+    }
+    for (auto& appender : *m_appenders.load()) {
         node["appenders"].push_back(YAML::Load(appender->toYamlString()));
     }
     std::stringstream ss;
@@ -350,7 +706,9 @@ void StdoutLogAppender::log(LogLevel::Level level, LogEvent::ptr event) {
     if (level >= m_level) {
         MutexType::Lock lock(m_mutex);
 
-        std::cout << m_formatter->format(level, event);
+        LogBuffer buffer;
+        m_formatter->format(buffer, level, *event);
+        std::cout.write(buffer.data(), buffer.size());
     }
 }
 
@@ -371,24 +729,324 @@ std::string StdoutLogAppender::toYamlString() {
     return ss.str();
 }
 
+/**
+ * @brief COMPRESS_STREAM方式下后台线程写入的文件, 最后一个引用释放时关闭
+ */
+struct LogCompressFile {
+    int fd;
+
+    LogCompressFile(int v) : fd(v) {}
+    ~LogCompressFile() { close(fd); }
+};
+
+/**
+ * @brief 已创建的FileLogAppender, 供后台刷新, LogFlushAll与致命信号处理遍历
+ * @details 固定大小的槽位, 信号处理函数不加锁直接读取; 登记与注销由互斥量串行化.
+ *          其余遍历者持锁时对槽位加引用(pin)后释放锁再访问Appender, 注销时等待引用归零,
+ *          引用未归零的槽位不再分配
+ */
+static constexpr size_t LOG_FILE_APPENDER_SLOTS = 256;
+static std::atomic<FileLogAppender*> s_file_appenders[LOG_FILE_APPENDER_SLOTS];
+static uint32_t s_file_appender_pins[LOG_FILE_APPENDER_SLOTS];  // 持有注册表锁时访问
+
+static Mutex& GetAppenderRegistryMutex() {
+    // 不析构, 退出阶段析构的Appender仍需注销
+    static Mutex* s_mutex = new Mutex;
+    return *s_mutex;
+}
+
+// 引用归零时通知等待注销的Appender
+static Condition& GetAppenderRegistryCond() {
+    static Condition* s_cond = new Condition;
+    return *s_cond;
+}
+
+// 已创建的AsyncLogAppender, 供LogFlushAll遍历, 由同一互斥量保护
+static std::set<AsyncLogAppender*>& GetAsyncAppenders() {
+    static std::set<AsyncLogAppender*>* s_appenders = new std::set<AsyncLogAppender*>;
+    return *s_appenders;
+}
+
+// 遍历者对AsyncLogAppender的引用数, 析构时等待归零
+static std::map<AsyncLogAppender*, uint32_t>& GetAsyncAppenderPins() {
+    static std::map<AsyncLogAppender*, uint32_t>* s_pins = new std::map<AsyncLogAppender*, uint32_t>;
+    return *s_pins;
+}
+
+static void UnregisterAsyncAppender(AsyncLogAppender* appender) {
+    Mutex& mutex = GetAppenderRegistryMutex();
+    Mutex::Lock lock(mutex);
+    GetAsyncAppenders().erase(appender);
+    auto& pins = GetAsyncAppenderPins();
+    for (auto it = pins.find(appender); it != pins.end(); it = pins.find(appender)) {
+        if (!it->second) {
+            pins.erase(it);
+            break;
+        }
+        GetAppenderRegistryCond().wait(mutex);
+    }
+}
+
+/**
+ * @brief 对已登记的AsyncLogAppender逐个调用cb, 调用期间不持有注册表锁
+ */
+static void VisitAsyncAppenders(const std::function<void(AsyncLogAppender*)>& cb) {
+    Mutex& mutex = GetAppenderRegistryMutex();
+    std::vector<AsyncLogAppender*> pinned;
+    {
+        Mutex::Lock lock(mutex);
+        for (auto& i : GetAsyncAppenders()) {
+            ++GetAsyncAppenderPins()[i];
+            pinned.push_back(i);
+        }
+    }
+
+    for (auto& i : pinned) {
+        cb(i);
+    }
+
+    Mutex::Lock lock(mutex);
+    for (auto& i : pinned) {
+        --GetAsyncAppenderPins()[i];
+    }
+    GetAppenderRegistryCond().notifyAll();
+}
+
+static void RegisterFileAppender(FileLogAppender* appender) {
+    Mutex::Lock lock(GetAppenderRegistryMutex());
+    for (size_t i = 0; i < LOG_FILE_APPENDER_SLOTS; ++i) {
+        if (!s_file_appenders[i].load(std::memory_order_relaxed) && !s_file_appender_pins[i]) {
+            s_file_appenders[i].store(appender, std::memory_order_release);
+            return;
+        }
+    }
+    // 槽位用完时不登记, 只是不会定时刷新, 崩溃时也不写出它的缓冲区
+}
+
+static void UnregisterFileAppender(FileLogAppender* appender) {
+    Mutex& mutex = GetAppenderRegistryMutex();
+    Mutex::Lock lock(mutex);
+    for (size_t i = 0; i < LOG_FILE_APPENDER_SLOTS; ++i) {
+        if (s_file_appenders[i].load(std::memory_order_relaxed) == appender) {
+            s_file_appenders[i].store(nullptr, std::memory_order_release);
+            while (s_file_appender_pins[i]) {
+                GetAppenderRegistryCond().wait(mutex);
+            }
+            return;
+        }
+    }
+}
+
+/**
+ * @brief 对已登记的FileLogAppender逐个调用cb, 调用期间不持有注册表锁
+ */
+static void VisitFileAppenders(const std::function<void(FileLogAppender*)>& cb) {
+    Mutex& mutex = GetAppenderRegistryMutex();
+    std::vector<std::pair<size_t, FileLogAppender*>> pinned;
+    {
+        Mutex::Lock lock(mutex);
+        for (size_t i = 0; i < LOG_FILE_APPENDER_SLOTS; ++i) {
+            FileLogAppender* appender = s_file_appenders[i].load(std::memory_order_relaxed);
+            if (appender) {
+                ++s_file_appender_pins[i];
+                pinned.emplace_back(i, appender);
+            }
+        }
+    }
+
+    for (auto& [slot, appender] : pinned) {
+        cb(appender);
+    }
+
+    Mutex::Lock lock(mutex);
+    for (auto& [slot, appender] : pinned) {
+        --s_file_appender_pins[slot];
+    }
+    GetAppenderRegistryCond().notifyAll();
+}
+
+/**
+ * @brief 定时刷新的后台线程
+ * @details 安静的日志器没有后续写入触发刷新, 由该线程把超过刷新间隔的缓冲区写入文件.
+ *          按已登记Appender中最短刷新间隔的一半检查, 限制在10毫秒到500毫秒之间.
+ *          有FileLogAppender时运行, Appender析构与进程退出时通知cond, 线程醒来后
+ *          发现没有Appender或正在退出即结束
+ */
+struct FileFlusher {
+    Mutex mutex;
+    Condition cond;
+    Thread* thread = nullptr;  // 运行中或已结束待回收的线程
+    size_t appenders = 0;      // 存活的FileLogAppender数
+    bool running = false;      // thread是否仍在循环中
+    bool stopping = false;     // 进程正在退出, 不再启动
+    bool atexit = false;       // 是否已注册退出处理
+};
+
+// 不析构, 退出处理之后析构的Appender仍会通知cond
+static FileFlusher& GetFileFlusher() {
+    static FileFlusher* s_flusher = new FileFlusher;
+    return *s_flusher;
+}
+
+static void RunFileFlusher() {
+    FileFlusher& flusher = GetFileFlusher();
+    uint64_t period = 500;
+    while (true) {
+        {
+            Mutex::Lock lock(flusher.mutex);
+            if (!flusher.stopping && flusher.appenders) {
+                flusher.cond.waitFor(flusher.mutex, period);
+            }
+            if (flusher.stopping || !flusher.appenders) {
+                flusher.running = false;
+                return;
+            }
+        }
+        uint64_t now = GetMonotonicMS();
+        uint64_t min_interval = 1000;
+        VisitFileAppenders([&](FileLogAppender* appender) {
+            min_interval = std::min(min_interval, appender->getFlushInterval());
+            appender->flushExpired(now);
+        });
+        period = std::min<uint64_t>(std::max<uint64_t>(min_interval / 2, 10), 500);
+    }
+}
+
+/**
+ * @brief 进程退出时结束后台线程并等待
+ * @details 在退出处理中调用, 早于首个FileLogAppender之前创建的单例(如LoggerManager)析构,
+ *          它们持有的Appender随后在析构中自行写出缓冲区
+ */
+static void StopFileFlusher() {
+    FileFlusher& flusher = GetFileFlusher();
+    Thread* thread = nullptr;
+    {
+        Mutex::Lock lock(flusher.mutex);
+        flusher.stopping = true;
+        std::swap(thread, flusher.thread);
+        flusher.cond.notify();
+    }
+    if (thread) {
+        thread->join();
+        delete thread;
+    }
+}
+
+/**
+ * @brief FileLogAppender创建时调用, 后台线程未运行时启动
+ */
+static void AddFileFlusherAppender() {
+    FileFlusher& flusher = GetFileFlusher();
+    Thread* finished = nullptr;
+    {
+        Mutex::Lock lock(flusher.mutex);
+        ++flusher.appenders;
+        if (flusher.running || flusher.stopping) {
+            return;
+        }
+        if (!flusher.atexit) {
+            atexit(&StopFileFlusher);
+            flusher.atexit = true;
+        }
+        // 上一个线程已退出循环, 在锁外回收
+        finished = flusher.thread;
+        flusher.running = true;
+        flusher.thread = new Thread(&RunFileFlusher, "log_flush");
+    }
+    if (finished) {
+        finished->join();
+        delete finished;
+    }
+}
+
+/**
+ * @brief FileLogAppender析构时调用, 唤醒后台线程, 没有Appender时线程随即结束
+ */
+static void RemoveFileFlusherAppender() {
+    FileFlusher& flusher = GetFileFlusher();
+    Mutex::Lock lock(flusher.mutex);
+    --flusher.appenders;
+    flusher.cond.notify();
+}
+
+FileLogAppender::CompressMode FileLogAppender::CompressModeFromString(const std::string& str) {
+    if (str == "rotate") {
+        return COMPRESS_ROTATE;
+    }
+    if (str == "stream") {
+        return COMPRESS_STREAM;
+    }
+    return COMPRESS_NONE;
+}
+
+const char* FileLogAppender::CompressModeToString(CompressMode mode) {
+    switch (mode) {
+        case COMPRESS_ROTATE:
+            return "rotate";
+        case COMPRESS_STREAM:
+            return "stream";
+        default:
+            return "none";
+    }
+}
+
 FileLogAppender::FileLogAppender(const std::string& filename) : m_filename(filename) {
+    m_buffer.reserve(m_buffer_size);
     reopen();
+    RegisterFileAppender(this);
+    AddFileFlusherAppender();
+}
+
+FileLogAppender::~FileLogAppender() {
+    UnregisterFileAppender(this);
+    RemoveFileFlusherAppender();
+
+    MutexType::Lock lock(m_mutex);
+
+    writeFile(nullptr, 0);
+    closeFile();
+    if (m_compress == COMPRESS_STREAM) {
+        LogCompressor::GetInstance()->flush();
+    }
 }
 
 void FileLogAppender::log(LogLevel::Level level, LogEvent::ptr event) {
     if (level >= m_level) {
-        uint64_t now = time(0);
-        if (now != m_last_time) {
-            reopen();
-            m_last_time = now;
-        }
+        // 按时间切分用日志时间, 刷新间隔用单调时钟, 不受系统时间修改影响
+        uint64_t now = event->getTimeUs() / 1000000;
+        uint64_t now_ms = GetMonotonicMS();
 
         MutexType::Lock lock(m_mutex);
 
-        m_filestream << m_formatter->format(level, event);
+        LogBuffer buffer;
+        encode(buffer, level, *event);
+
+        uint64_t pending = m_file_size + m_buffer.size();
+        if ((m_next_rotate && now >= m_next_rotate) ||
+            (m_rotate_size && pending && pending + buffer.size() > m_rotate_size)) {
+            rotate(now);
+            // 新文件重新编码, 保证文件自包含
+            buffer.clear();
+            encode(buffer, level, *event);
+        }
+        if (m_buffer.size() + buffer.size() <= m_buffer_size) {
+            m_buffer.append(buffer.data(), buffer.size());
+            if (now_ms < m_last_flush + m_flush_interval) {
+                return;
+            }
+            writeFile(nullptr, 0);
+        } else {
+            // 缓冲区放不下, 与缓冲区内容一起写入
+            writeFile(buffer.data(), buffer.size());
+        }
+        m_last_flush = now_ms;
     }
 }
 
+void FileLogAppender::encode(LogBuffer& out, LogLevel::Level level, const LogEvent& event) {
+    m_formatter->format(out, level, event);
+}
+
 std::string FileLogAppender::toYamlString() {
     MutexType::Lock lock(m_mutex);
 
@@ -401,6 +1059,17 @@ std::string FileLogAppender::toYamlString() {
     if (m_has_formatter && m_formatter) {
         node["formatter"] = m_formatter->getPattern();
     }
+    node["buffer_size"] = m_buffer_size;
+    node["flush_interval"] = m_flush_interval.load();
+    if (m_rotate_size) {
+        node["rotate_size"] = m_rotate_size;
+    }
+    if (m_rotate_interval) {
+        node["rotate_interval"] = m_rotate_interval;
+    }
+    if (m_compress != COMPRESS_NONE) {
+        node["compress"] = CompressModeToString(m_compress);
+    }
     std::stringstream ss;
     ss << node;
     return ss.str();
@@ -409,23 +1078,988 @@ std::string FileLogAppender::toYamlString() {
 bool FileLogAppender::reopen() {
     MutexType::Lock lock(m_mutex);
 
-    if (m_filestream) {
-        m_filestream.close();
+    writeFile(nullptr, 0);
+    closeFile();
+    return openFile();
+}
+
+void FileLogAppender::flush() {
+    MutexType::Lock lock(m_mutex);
+
+    writeFile(nullptr, 0);
+    m_last_flush = GetMonotonicMS();
+    if (m_compress == COMPRESS_STREAM) {
+        LogCompressor::GetInstance()->flush();
     }
-    m_filestream.open(m_filename, std::ios::app);
-    return !!m_filestream;
 }
 
-LogFormatter::LogFormatter(const std::string& pattern) : m_pattern(pattern) {
-    init();
+bool FileLogAppender::tryFlush() {
+    if (!m_mutex.tryLock()) {
+        return false;
+    }
+    writeFile(nullptr, 0);
+    m_last_flush = GetMonotonicMS();
+    bool stream = m_compress == COMPRESS_STREAM;
+    m_mutex.unlock();
+    if (stream) {
+        LogCompressor::GetInstance()->flush();
+    }
+    return true;
 }
 
-std::string LogFormatter::format(LogLevel::Level level, LogEvent::ptr event) {
-    std::stringstream ss;
-    for (auto& i : m_items) {
-        i->format(ss, level, event);
+void FileLogAppender::flushExpired(uint64_t now) {
+    // 正在写入时由写入者按间隔刷新
+    if (!m_mutex.tryLock()) {
+        return;
+    }
+    if (!m_buffer.empty() && now >= m_last_flush + m_flush_interval) {
+        writeFile(nullptr, 0);
+        m_last_flush = now;
+    }
+    m_mutex.unlock();
+}
+
+void FileLogAppender::setBufferSize(size_t v) {
+    MutexType::Lock lock(m_mutex);
+
+    if (m_buffer.size() > v) {
+        writeFile(nullptr, 0);
+    }
+    m_buffer_size = v;
+    m_buffer.reserve(v);
+}
+
+void FileLogAppender::setRotateInterval(uint64_t v) {
+    MutexType::Lock lock(m_mutex);
+
+    m_rotate_interval = v;
+    m_next_rotate = nextRotateTime(time(0));
+}
+
+// 信号处理中写入, 不处理部分写入以外的错误
+static void CrashWrite(int fd, const char* data, size_t len) {
+    while (len) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+void FileLogAppender::crashFlush(const char* msg, size_t len, void* const* frames, int depth) {
+    bool locked = m_mutex.tryLock();
+    if (m_stream) {
+        // 未压缩的块, 格式见lz.h
+        uint32_t header[3] = {LZ_BLOCK_MAGIC, (uint32_t)(m_buffer.size() + len), 0};
+        CrashWrite(m_stream->fd, (const char*)header, sizeof(header));
+        CrashWrite(m_stream->fd, m_buffer.data(), m_buffer.size());
+        CrashWrite(m_stream->fd, msg, len);
+    } else if (m_fd >= 0) {
+        CrashWrite(m_fd, m_buffer.data(), m_buffer.size());
+        if (!isBinary()) {
+            CrashWrite(m_fd, msg, len);
+            backtrace_symbols_fd(frames, depth, m_fd);
+        }
+    }
+    if (locked) {
+        m_buffer.clear();
+        m_mutex.unlock();
+    }
+}
+
+void FileLogAppender::setCompress(CompressMode v) {
+    MutexType::Lock lock(m_mutex);
+
+    if (m_compress == v) {
+        return;
+    }
+    writeFile(nullptr, 0);
+    closeFile();
+    m_compress = v;
+    openFile();
+}
+
+bool FileLogAppender::openFile() {
+    m_fd = open(m_filename.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        std::cout << "log file open fail, file=" << m_filename << " errno=" << errno
+                  << " errstr=" << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    m_file_size = fstat(m_fd, &st) == 0 ? st.st_size : 0;
+    if (m_compress == COMPRESS_STREAM) {
+        int fd = dup(m_fd);
+        if (fd >= 0) {
+            m_stream = std::make_shared<LogCompressFile>(fd);
+        }
+    }
+    m_next_rotate = nextRotateTime(time(0));
+    onOpen();
+    return true;
+}
+
+void FileLogAppender::closeFile() {
+    // 后台线程写完已提交的块后关闭
+    m_stream.reset();
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void FileLogAppender::writeFile(const char* data, size_t len) {
+    if (m_stream) {
+        if (m_buffer.empty() && !len) {
+            return;
+        }
+        // 缓冲区整体移交给后台线程, 换入一个同样容量的空缓冲区
+        std::string block;
+        block.reserve(m_buffer_size);
+        block.swap(m_buffer);
+        block.append(data, len);
+        m_file_size += block.size();
+        LogCompressor::GetInstance()->write(m_stream, std::move(block));
+        return;
+    }
+
+    struct iovec iov[2];
+    int count = 0;
+    if (!m_buffer.empty()) {
+        iov[count].iov_base = m_buffer.data();
+        iov[count].iov_len = m_buffer.size();
+        ++count;
+    }
+    if (len) {
+        iov[count].iov_base = (void*)data;
+        iov[count].iov_len = len;
+        ++count;
+    }
+
+    struct iovec* cur = iov;
+    while (m_fd >= 0 && count > 0) {
+        ssize_t n = writev(m_fd, cur, count);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // 写入失败时丢弃, 避免缓冲区无限增长
+            break;
+        }
+        m_file_size += n;
+        // 部分写入, 跳过已写入的部分
+        while (count > 0 && (size_t)n >= cur->iov_len) {
+            n -= cur->iov_len;
+            ++cur;
+            --count;
+        }
+        if (count > 0) {
+            cur->iov_base = (char*)cur->iov_base + n;
+            cur->iov_len -= n;
+        }
+    }
+    m_buffer.clear();
+}
+
+void FileLogAppender::rotate(uint64_t now) {
+    writeFile(nullptr, 0);
+    closeFile();
+
+    struct tm tm;
+    time_t t = now;
+    localtime_r(&t, &tm);
+    char suffix[32];
+    strftime(suffix, sizeof(suffix), "%Y%m%d-%H%M%S", &tm);
+    std::string target = m_filename + "." + suffix;
+    // 同一秒内多次切分时追加序号, 已压缩的文件也占用名字
+    auto exists = [this](const std::string& path) {
+        return access(path.c_str(), F_OK) == 0 ||
+               (m_compress == COMPRESS_ROTATE && access((path + ".lz").c_str(), F_OK) == 0);
+    };
+    for (int i = 1; exists(target); ++i) {
+        target = m_filename + "." + suffix + "." + std::to_string(i);
+    }
+    if (rename(m_filename.c_str(), target.c_str())) {
+        std::cout << "log file rotate fail, file=" << m_filename << " target=" << target
+                  << " errno=" << errno << " errstr=" << strerror(errno) << std::endl;
+    } else if (m_compress == COMPRESS_ROTATE) {
+        LogCompressor::GetInstance()->compressFile(target);
+    }
+    openFile();
+    m_next_rotate = nextRotateTime(now);
+}
+
+uint64_t FileLogAppender::nextRotateTime(uint64_t now) const {
+    if (!m_rotate_interval) {
+        return 0;
+    }
+    // 按本地时间对齐, 如按天切分时在本地零点切分
+    struct tm tm;
+    time_t t = now;
+    localtime_r(&t, &tm);
+    uint64_t local = now + tm.tm_gmtoff;
+    return (local / m_rotate_interval + 1) * m_rotate_interval - tm.tm_gmtoff;
+}
+
+// 待写入的块数据超过此值时提交方等待
+static constexpr size_t LOG_COMPRESS_MAX_PENDING = 64 * 1024 * 1024;
+
+LogCompressor* LogCompressor::GetInstance() {
+    // 不析构, 退出阶段析构的Appender仍可能提交任务
+    static LogCompressor* s_compressor = new LogCompressor;
+    return s_compressor;
+}
+
+LogCompressor::LogCompressor() {
+    m_thread = std::make_shared<Thread>(std::bind(&LogCompressor::run, this), "log_compress");
+}
+
+void LogCompressor::compressFile(const std::string& path) {
+    {
+        MutexType::Lock lock(m_mutex);
+        m_tasks.emplace_back(Task{path, nullptr, std::string()});
+        ++m_submitted;
+    }
+    m_semaphore.notify();
+}
+
+void LogCompressor::write(std::shared_ptr<LogCompressFile> file, std::string&& data) {
+    size_t len = data.size();
+    {
+        MutexType::Lock lock(m_mutex);
+        // 后台线程跟不上, 等待而不是无限占用内存
+        while (m_pending_bytes >= LOG_COMPRESS_MAX_PENDING && !m_tasks.empty()) {
+            m_progress.wait(m_mutex);
+        }
+        m_pending_bytes += len;
+        m_tasks.emplace_back(Task{std::string(), std::move(file), std::move(data)});
+        ++m_submitted;
+    }
+    m_semaphore.notify();
+}
+
+void LogCompressor::flush() {
+    // 后台线程自己等待会死锁
+    if (Thread::GetThis() == m_thread.get()) {
+        return;
+    }
+    MutexType::Lock lock(m_mutex);
+    uint64_t target = m_submitted;
+    while (m_done < target) {
+        m_progress.wait(m_mutex);
+    }
+}
+
+void LogCompressor::run() {
+    while (true) {
+        m_semaphore.wait();
+        Task task;
+        {
+            MutexType::Lock lock(m_mutex);
+            if (m_tasks.empty()) {
+                continue;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        if (task.file) {
+            doWrite(*task.file, task.data);
+        } else {
+            doCompressFile(task.path);
+        }
+        MutexType::Lock lock(m_mutex);
+        m_pending_bytes -= task.data.size();
+        ++m_done;
+        m_progress.notifyAll();
+    }
+}
+
+void LogCompressor::doWrite(LogCompressFile& file, const std::string& data) {
+    std::string block;
+    LzAppendBlock(block, data.data(), data.size());
+    m_raw_bytes += data.size();
+    m_comp_bytes += block.size();
+
+    const char* p = block.data();
+    size_t left = block.size();
+    while (left) {
+        ssize_t n = ::write(file.fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // 写入失败时丢弃, 与FileLogAppender一致
+            break;
+        }
+        p += n;
+        left -= n;
+    }
+}
+
+void LogCompressor::doCompressFile(const std::string& path) {
+    std::string tmp = path + ".lz.tmp";
+    FILE* in = fopen(path.c_str(), "rb");
+    FILE* out = in ? fopen(tmp.c_str(), "wb") : nullptr;
+    bool ok = out && LzCompressStream(in, out);
+    if (out && fclose(out)) {
+        ok = false;
+    }
+    if (in) {
+        struct stat st;
+        if (fstat(fileno(in), &st) == 0) {
+            m_raw_bytes += st.st_size;
+        }
+        fclose(in);
+    }
+    // 先写临时文件再改名, 中途退出时原文件仍完整
+    if (ok && rename(tmp.c_str(), (path + ".lz").c_str()) == 0) {
+        struct stat st;
+        if (stat((path + ".lz").c_str(), &st) == 0) {
+            m_comp_bytes += st.st_size;
+        }
+        unlink(path.c_str());
+    } else {
+        std::cout << "log file compress fail, file=" << path << " errno=" << errno
+                  << " errstr=" << strerror(errno) << std::endl;
+        unlink(tmp.c_str());
+    }
+}
+
+/**
+ * @brief MmapLogAppender的一段映射
+ * @details writers为正在拷贝的线程数, 为0且不再是当前映射时才能解除映射;
+ *          结构体本身在Appender析构时才释放, 写入线程可以安全地访问已过期的映射对象
+ */
+struct LogMmapChunk {
+    void* base = nullptr;            // mmap返回的地址
+    size_t map_len = 0;              // 映射长度
+    char* data = nullptr;            // 可写区域起始, 映射失败时为空
+    uint64_t offset = 0;             // data在文件中的偏移
+    uint64_t size = 0;               // 可写区域大小
+    std::atomic<uint64_t> tail{0};   // 已预留的长度
+    std::atomic<uint32_t> writers{0};
+    std::atomic<uint32_t> generation{0};  // 被复用的次数
+    std::atomic<bool> retrying{false};
+    uint64_t retry_time = 0;         // 映射失败后下次重试的时间(秒)
+};
+
+// 确保文件长度不小于len, 优先分配磁盘空间, 避免写映射区时因磁盘满触发SIGBUS
+static bool ExtendFile(int fd, uint64_t len) {
+    struct stat st;
+    if (fstat(fd, &st)) {
+        return false;
+    }
+    if ((uint64_t)st.st_size >= len) {
+        return true;
+    }
+    int rt = posix_fallocate(fd, st.st_size, len - st.st_size);
+    if (rt == EOPNOTSUPP || rt == EINVAL) {
+        return ftruncate(fd, len) == 0;
+    }
+    return rt == 0;
+}
+
+// 已有日志的实际长度: 跳过末尾预扩展未写入的零字节
+static uint64_t FindLogEnd(int fd) {
+    struct stat st;
+    if (fstat(fd, &st)) {
+        return 0;
+    }
+    char buf[4096];
+    uint64_t end = st.st_size;
+    while (end > 0) {
+        size_t len = std::min<uint64_t>(end, sizeof(buf));
+        if (pread(fd, buf, len, end - len) != (ssize_t)len) {
+            break;
+        }
+        for (size_t i = len; i > 0; --i) {
+            if (buf[i - 1] != '\0') {
+                return end - len + i;
+            }
+        }
+        end -= len;
+    }
+    return end;
+}
+
+MmapLogAppender::MmapLogAppender(const std::string& filename, size_t chunk_size)
+    : m_filename(filename),
+      m_chunk_size(chunk_size) {
+    MutexType::Lock lock(m_mutex);
+
+    m_fd = open(m_filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        std::cout << "log file open fail, file=" << m_filename << " errno=" << errno
+                  << " errstr=" << strerror(errno) << std::endl;
+    }
+    m_chunk = map(m_fd < 0 ? 0 : FindLogEnd(m_fd), 0);
+}
+
+MmapLogAppender::~MmapLogAppender() {
+    LogMmapChunk* chunk = m_chunk;
+    uint64_t end = chunk->offset + std::min<uint64_t>(chunk->tail, chunk->size);
+    for (auto& i : m_chunks) {
+        if (i->base) {
+            munmap(i->base, i->map_len);
+        }
+    }
+    if (m_fd >= 0) {
+        if (ftruncate(m_fd, end)) {
+            std::cout << "log file truncate fail, file=" << m_filename << " errno=" << errno << std::endl;
+        }
+        close(m_fd);
+    }
+}
+
+void MmapLogAppender::log(LogLevel::Level level, LogEvent::ptr event) {
+    if (level >= m_level) {
+        LogFormatter::ptr formatter = std::atomic_load(&m_formatter);
+        LogBuffer buffer;
+        formatter->format(buffer, level, *event);
+        write(buffer.data(), buffer.size());
+    }
+}
+
+void MmapLogAppender::write(const char* data, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    while (true) {
+        LogMmapChunk* chunk = m_chunk;
+        // 登记后再确认仍是当前映射, 保证不会写入已解除的映射
+        ++chunk->writers;
+        if (m_chunk != chunk) {
+            --chunk->writers;
+            continue;
+        }
+        if (!chunk->data) {
+            // 映射失败, 每秒最多重试一次. 登记期间读取, 退出登记后结构可能被复用
+            bool retry = (uint64_t)time(0) >= chunk->retry_time && !chunk->retrying.exchange(true);
+            uint64_t offset = chunk->offset;
+            --chunk->writers;
+            if (retry) {
+                MutexType::Lock lock(m_mutex);
+                switchChunk(offset, data, len);
+                return;
+            }
+            ++m_dropped;
+            return;
+        }
+
+        uint64_t pos = chunk->tail.fetch_add(len);
+        if (pos + len <= chunk->size) {
+            memcpy(chunk->data + pos, data, len);
+            --chunk->writers;
+            return;
+        }
+        uint32_t generation = chunk->generation;
+        --chunk->writers;
+        if (pos <= chunk->size) {
+            // 跨越边界的线程只有一个, 由它从pos处映射下一段并写入本条日志
+            MutexType::Lock lock(m_mutex);
+            switchChunk(chunk->offset + pos, data, len);
+            return;
+        }
+        // 等待跨越边界的线程完成映射(可能阻塞在磁盘上), 映射结构可能已被复用为新的当前映射
+        MutexType::Lock lock(m_mutex);
+        while (m_chunk == chunk && chunk->generation == generation) {
+            m_switched.wait(m_mutex);
+        }
+    }
+}
+
+std::string MmapLogAppender::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+
+    YAML::Node node;
+    node["type"] = "MmapLogAppender";
+    node["file"] = m_filename;
+    node["chunk_size"] = m_chunk_size;
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_has_formatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+LogMmapChunk* MmapLogAppender::map(uint64_t offset, size_t reserve) {
+    // 复用已无线程写入的旧映射结构, 列表长度只取决于同时在写的映射数.
+    // 结构本身不释放: 读到旧指针的线程登记后会发现它不是当前映射而退出
+    LogMmapChunk* chunk = nullptr;
+    LogMmapChunk* current = m_chunk;
+    for (auto& i : m_chunks) {
+        if (i.get() != current && i->writers == 0) {
+            chunk = i.get();
+            break;
+        }
+    }
+    if (chunk) {
+        if (chunk->base) {
+            munmap(chunk->base, chunk->map_len);
+        }
+        chunk->base = nullptr;
+        chunk->map_len = 0;
+        chunk->data = nullptr;
+        chunk->size = 0;
+        chunk->retrying = false;
+        chunk->retry_time = 0;
+        ++chunk->generation;
+    } else {
+        m_chunks.emplace_back(new LogMmapChunk);
+        chunk = m_chunks.back().get();
+    }
+    chunk->offset = offset;
+    chunk->tail = reserve;
+
+    // mmap的偏移需按页对齐
+    static const uint64_t s_page_size = sysconf(_SC_PAGESIZE);
+    uint64_t aligned = offset / s_page_size * s_page_size;
+    uint64_t skip = offset - aligned;
+    size_t map_len = (skip + std::max(m_chunk_size, reserve) + s_page_size - 1) / s_page_size * s_page_size;
+    if (m_fd >= 0 && ExtendFile(m_fd, aligned + map_len)) {
+        void* base = mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, aligned);
+        if (base != MAP_FAILED) {
+            chunk->base = base;
+            chunk->map_len = map_len;
+            chunk->data = (char*)base + skip;
+            chunk->size = map_len - skip;
+        }
+    }
+    if (!chunk->data) {
+        std::cout << "log file mmap fail, file=" << m_filename << " offset=" << offset
+                  << " errno=" << errno << " errstr=" << strerror(errno) << std::endl;
+        chunk->retry_time = time(0) + 1;
+    }
+    return chunk;
+}
+
+void MmapLogAppender::switchChunk(uint64_t offset, const char* data, size_t len) {
+    LogMmapChunk* chunk = map(offset, len);
+    if (chunk->data) {
+        memcpy(chunk->data, data, len);
+    } else {
+        ++m_dropped;
+        chunk->tail = 0;
+    }
+    m_chunk = chunk;
+    m_switched.notifyAll();
+
+    // 解除已无线程写入的旧映射
+    for (auto& i : m_chunks) {
+        if (i.get() != chunk && i->base && i->writers == 0) {
+            munmap(i->base, i->map_len);
+            i->base = nullptr;
+        }
+    }
+}
+
+/**
+ * @brief 时间渲染缓存
+ * @details text为按秒渲染的文本, 被亚秒占位符分为多段
+ */
+struct LogTimeCache {
+    static const size_t MAX_FORMAT = 64;
+    static const size_t MAX_TEXT = 128;
+    static const size_t MAX_SEGMENT = 4;
+
+    char format[MAX_FORMAT];
+    size_t format_len = 0;
+    uint64_t second = UINT64_MAX;     // 渲染时的秒数
+    char text[MAX_TEXT];
+    uint16_t seg_end[MAX_SEGMENT];    // 每段在text中的结束位置
+    uint8_t seg_digits[MAX_SEGMENT];  // 每段之后亚秒的位数, 0表示没有
+    size_t seg_count = 0;
+};
+
+static const size_t LOG_TIME_CACHE_SIZE = 4;
+static thread_local LogTimeCache t_time_cache[LOG_TIME_CACHE_SIZE];
+static thread_local size_t t_time_cache_next = 0;
+
+// 按秒渲染fmt, 格式过长或亚秒占位符过多时返回false
+static bool RenderTimeCache(LogTimeCache& cache, uint64_t second, const char* fmt, size_t len) {
+    if (len >= LogTimeCache::MAX_FORMAT) {
+        return false;
+    }
+    struct tm tm;
+    time_t t = second;
+    localtime_r(&t, &tm);
+
+    char seg[LogTimeCache::MAX_FORMAT];
+    size_t seg_len = 0;
+    size_t text_len = 0;
+    cache.seg_count = 0;
+    auto flush = [&](uint8_t digits) {
+        if (cache.seg_count == LogTimeCache::MAX_SEGMENT) {
+            return false;
+        }
+        seg[seg_len] = '\0';
+        if (seg_len) {
+            text_len += strftime(cache.text + text_len, LogTimeCache::MAX_TEXT - text_len, seg, &tm);
+        }
+        cache.seg_end[cache.seg_count] = text_len;
+        cache.seg_digits[cache.seg_count] = digits;
+        ++cache.seg_count;
+        seg_len = 0;
+        return true;
+    };
+    for (size_t i = 0; i < len; ++i) {
+        if (fmt[i] != '%' || i + 1 == len) {
+            seg[seg_len++] = fmt[i];
+            continue;
+        }
+        if (fmt[i + 1] == 'f') {
+            if (!flush(6)) {
+                return false;
+            }
+            i += 1;
+        } else if ((fmt[i + 1] == '3' || fmt[i + 1] == '6') && i + 2 < len && fmt[i + 2] == 'f') {
+            if (!flush(fmt[i + 1] - '0')) {
+                return false;
+            }
+            i += 2;
+        } else {
+            // 其余转换说明(包括%%)原样交给strftime
+            seg[seg_len++] = fmt[i];
+            seg[seg_len++] = fmt[++i];
+        }
+    }
+    if (!flush(0)) {
+        return false;
+    }
+    memcpy(cache.format, fmt, len);
+    cache.format_len = len;
+    cache.second = second;
+    return true;
+}
+
+void LogAppendTime(LogBuffer& out, uint64_t time_us, const char* fmt, size_t len) {
+    uint64_t second = time_us / 1000000;
+    uint32_t usec = time_us % 1000000;
+
+    LogTimeCache* cache = nullptr;
+    for (auto& i : t_time_cache) {
+        if (i.format_len == len && memcmp(i.format, fmt, len) == 0) {
+            cache = &i;
+            break;
+        }
+    }
+    if (!cache) {
+        cache = &t_time_cache[t_time_cache_next++ % LOG_TIME_CACHE_SIZE];
+        cache->second = UINT64_MAX;
+    }
+    if (cache->second != second && !RenderTimeCache(*cache, second, fmt, len)) {
+        // 无法缓存, 直接渲染且不支持亚秒
+        cache->format_len = 0;
+        cache->second = UINT64_MAX;
+        struct tm tm;
+        time_t t = second;
+        localtime_r(&t, &tm);
+        char buf[256];
+        out.append(buf, strftime(buf, sizeof(buf), fmt, &tm));
+        return;
+    }
+
+    size_t begin = 0;
+    for (size_t i = 0; i < cache->seg_count; ++i) {
+        out.append(cache->text + begin, cache->seg_end[i] - begin);
+        begin = cache->seg_end[i];
+        int digits = cache->seg_digits[i];
+        if (digits) {
+            uint32_t v = digits == 3 ? usec / 1000 : usec;
+            char buf[6];
+            for (int j = digits - 1; j >= 0; --j) {
+                buf[j] = '0' + v % 10;
+                v /= 10;
+            }
+            out.append(buf, digits);
+        }
+    }
+}
+
+bool LogFieldReader::next(LogFieldView& field) {
+    if (m_cur >= m_end) {
+        return false;
+    }
+    size_t key_len = (uint8_t)*m_cur++;
+    if (m_cur + key_len + 1 > m_end) {
+        m_cur = m_end;
+        return false;
+    }
+    field.key = std::string_view(m_cur, key_len);
+    m_cur += key_len;
+    field.type = *m_cur++;
+
+    bool ok = true;
+    auto read = [this, &ok](auto& v) {
+        if (m_cur + sizeof(v) > m_end) {
+            ok = false;
+            return;
+        }
+        memcpy(&v, m_cur, sizeof(v));
+        m_cur += sizeof(v);
+    };
+    switch (field.type) {
+#define XX(tag, wire, dst)  \
+    case tag: {             \
+        wire w = 0;         \
+        read(w);            \
+        field.dst = w;      \
+        break;              \
+    }
+        XX('i', int32_t, i);
+        XX('I', int64_t, i);
+        XX('c', char, i);
+        XX('b', uint8_t, i);
+        XX('u', uint32_t, u);
+        XX('U', uint64_t, u);
+        XX('p', uint64_t, u);
+        XX('d', double, d);
+#undef XX
+        case 's': {
+            uint32_t len = 0;
+            read(len);
+            ok = ok && m_cur + len <= m_end;
+            if (ok) {
+                field.s = std::string_view(m_cur, len);
+                m_cur += len;
+            }
+            break;
+        }
+        default:
+            ok = false;
+    }
+    if (!ok) {
+        m_cur = m_end;
+    }
+    return ok;
+}
+
+// 字段值的文本形式, 字符串不加引号
+static void LogAppendFieldValue(LogBuffer& out, const LogFieldView& field) {
+    switch (field.type) {
+        case 'c':
+            out.append((char)field.i);
+            break;
+        case 'b':
+            LogAppendStr(out, field.i ? "true" : "false");
+            break;
+        case 'u':
+        case 'U':
+            LogAppendUInt(out, field.u);
+            break;
+        case 'p': {
+            char buf[24] = "0x";
+            auto res = std::to_chars(buf + 2, buf + sizeof(buf), field.u, 16);
+            out.append(buf, res.ptr - buf);
+            break;
+        }
+        case 'd':
+            LogFormatDouble(out, std::string_view(), field.d);
+            break;
+        case 's':
+            out.append(field.s.data(), field.s.size());
+            break;
+        default:
+            LogAppendInt(out, field.i);
+    }
+}
+
+void LogAppendFields(LogBuffer& out, const LogBuffer& fields) {
+    LogFieldReader reader(fields);
+    LogFieldView field;
+    while (reader.next(field)) {
+        out.append(' ');
+        out.append(field.key.data(), field.key.size());
+        out.append('=');
+        LogAppendFieldValue(out, field);
+    }
+}
+
+/**
+ * @brief JSON字符串的转义表: 0 原样输出, 'u' 输出\u00XX, 其余输出反斜杠加该字符
+ */
+static constexpr std::array<char, 256> LogJsonEscapeTable() {
+    std::array<char, 256> table{};
+    for (int i = 0; i < 0x20; ++i) {
+        table[i] = 'u';
+    }
+    table['"'] = '"';
+    table['\\'] = '\\';
+    table['\b'] = 'b';
+    table['\f'] = 'f';
+    table['\n'] = 'n';
+    table['\r'] = 'r';
+    table['\t'] = 't';
+    table[0x7f] = 'u';
+    return table;
+}
+
+static constexpr std::array<char, 256> s_json_escape = LogJsonEscapeTable();
+
+void LogAppendJsonString(LogBuffer& out, std::string_view str) {
+    static const char s_hex[] = "0123456789abcdef";
+    out.append('"');
+    const char* p = str.data();
+    const char* end = p + str.size();
+    const char* run = p;
+    // 不需转义的连续片段整段拷贝, UTF-8多字节字符原样输出
+    for (; p < end; ++p) {
+        char esc = s_json_escape[(uint8_t)*p];
+        if (!esc) {
+            continue;
+        }
+        out.append(run, p - run);
+        run = p + 1;
+        if (esc == 'u') {
+            char buf[6] = {'\\', 'u', '0', '0', s_hex[(uint8_t)*p >> 4], s_hex[*p & 0xf]};
+            out.append(buf, sizeof(buf));
+        } else {
+            char buf[2] = {'\\', esc};
+            out.append(buf, sizeof(buf));
+        }
+    }
+    out.append(run, end - run);
+    out.append('"');
+}
+
+// 追加",\"key\":", 用于首个成员之后的成员
+static void LogAppendJsonKey(LogBuffer& out, std::string_view key) {
+    out.append(',');
+    LogAppendJsonString(out, key);
+    out.append(':');
+}
+
+void LogAppendJson(LogBuffer& out, const char* time_fmt, size_t len, LogLevel::Level level, const LogEvent& event) {
+    LogBuffer tmp;
+    out.append("{\"time\":", 8);
+    LogAppendTime(tmp, event.getTimeUs(), time_fmt, len);
+    LogAppendJsonString(out, tmp.view());
+    out.append(",\"level\":\"", 10);
+    LogAppendStr(out, LogLevel::ToString(level));
+    out.append('"');
+    LogAppendJsonKey(out, "logger");
+    LogAppendJsonString(out, event.getLogger()->getName());
+    LogAppendJsonKey(out, "thread_id");
+    LogAppendUInt(out, event.getThreadId());
+    LogAppendJsonKey(out, "thread_name");
+    LogAppendJsonString(out, event.getThreadName());
+    LogAppendJsonKey(out, "fiber_id");
+    LogAppendUInt(out, event.getFiberId());
+    LogAppendJsonKey(out, "file");
+    LogAppendJsonString(out, event.getFilename());
+    LogAppendJsonKey(out, "line");
+    LogAppendInt(out, event.getLine());
+    LogAppendJsonKey(out, "message");
+    if (event.getBinSite()) {
+        const LogBinSite* site = event.getBinSite();
+        tmp.clear();
+        LogBinRender(tmp, site->fmt, site->types, event.getBuffer().data(), event.getBuffer().size());
+        LogAppendJsonString(out, tmp.view());
+    } else {
+        LogAppendJsonString(out, event.getBuffer().view());
+    }
+
+    LogFieldReader reader(event.getFields());
+    LogFieldView field;
+    while (reader.next(field)) {
+        LogAppendJsonKey(out, field.key);
+        switch (field.type) {
+            case 'b':
+                LogAppendStr(out, field.i ? "true" : "false");
+                break;
+            case 'd':
+                // JSON不能表示NaN与无穷大
+                if (std::isfinite(field.d)) {
+                    LogFormatDouble(out, std::string_view(), field.d);
+                } else {
+                    out.append("null", 4);
+                }
+                break;
+            case 'c':
+            case 's':
+            case 'p':
+                tmp.clear();
+                LogAppendFieldValue(tmp, field);
+                LogAppendJsonString(out, tmp.view());
+                break;
+            default:
+                LogAppendFieldValue(out, field);
+        }
+    }
+    out.append('}');
+}
+
+/**
+ * @brief 编译期展开的常用模板, 运行期配置的模板与之相同时直接使用
+ */
+static LogFormatter::CompiledFormat FindCompiledFormat(const std::string& pattern) {
+#define XX(str) \
+    { std::string_view(str), &StaticLogFormatter<str>::Format }
+    static const std::pair<std::string_view, LogFormatter::CompiledFormat> s_compiled[] = {
+        XX(SYLAR_LOG_DEFAULT_PATTERN),
+        XX("%d{%Y-%m-%d %H:%M:%S}%T%m%n"),
+        XX("%m%n"),
+        XX(SYLAR_LOG_JSON_PATTERN),
+    };
+#undef XX
+    for (auto& [str, func] : s_compiled) {
+        if (str == pattern) {
+            return func;
+        }
+    }
+    return nullptr;
+}
+
+LogFormatter::LogFormatter(const std::string& pattern) : m_pattern(pattern) {
+    init();
+}
+
+std::string LogFormatter::format(LogLevel::Level level, LogEvent::ptr event) {
+    LogBuffer buffer;
+    format(buffer, level, *event);
+    return std::string(buffer.view());
+}
+
+void LogFormatter::format(LogBuffer& out, LogLevel::Level level, const LogEvent& event) const {
+    if (m_compiled) {
+        m_compiled(out, level, event);
+        return;
+    }
+    const char* operands = m_operands.data();
+    for (auto& op : m_program) {
+        switch (op.code) {
+#define XX(code)                                                          \
+    case code:                                                            \
+        LogFormatOp<code>(out, operands + op.offset, op.len, level, event); \
+        break;
+            XX(OP_STRING);
+            XX(OP_MESSAGE);
+            XX(OP_LEVEL);
+            XX(OP_ELAPSE);
+            XX(OP_NAME);
+            XX(OP_THREAD_ID);
+            XX(OP_THREAD_NAME);
+            XX(OP_FIBER_ID);
+            XX(OP_TIME);
+            XX(OP_FILENAME);
+            XX(OP_LINE);
+            XX(OP_NEWLINE);
+            XX(OP_TAB);
+            XX(OP_JSON);
+            XX(OP_FORMAT_ERROR);
+            XX(OP_PATTERN_ERROR);
+#undef XX
+        }
     }
-    return ss.str();
 }
 
 void LogFormatter::init() {
@@ -433,129 +2067,310 @@ void LogFormatter::init() {
     // %xxx{xxx} 带格式的文本
     // %str{fmt} example: %d{20.32}
     // %m -- 消息体
+    // %p -- 日志级别
     // %r -- 启动后的时间
     // %c -- 日志名称
     // %t -- 线程id
+    // %N -- 线程名称
+    // %F -- 协程id
     // %n -- 回车换行
-    // %d -- 时间
+    // %d -- 时间, %d{fmt} fmt为strftime格式, 另支持%3f毫秒, %6f或%f微秒
     // %f -- 文件名
     // %l -- 行号
-    // str, format, type
-    std::vector<std::tuple<std::string, std::string, int>> vec;
-    std::string nstr;
-    for (size_t i = 0; i < m_pattern.size(); ++i) {
-        if (m_pattern[i] != '%') {
-            nstr.append(1, m_pattern[i]);
-            continue;
+    // %T -- Tab
+    // %J -- 整个事件输出为JSON对象, 可带时间格式 %J{%Y-%m-%d %H:%M:%S}
+    m_program.clear();
+    m_operands.clear();
+    m_error = !ParseLogPattern(m_pattern, [this](OpCode code, std::string_view arg) {
+        if (code == OP_PATTERN_ERROR) {
+            std::cout << "pattern parse error: " << m_pattern << " - " << arg << std::endl;
         }
+        // 操作数以'\0'结尾, 时间格式可以直接交给strftime
+        m_program.push_back(Op{code, (uint32_t)m_operands.size(), (uint32_t)arg.size()});
+        m_operands.append(arg);
+        m_operands.push_back('\0');
+    });
+    m_compiled = m_error ? nullptr : FindCompiledFormat(m_pattern);
+}
 
-        if ((i + 1) < m_pattern.size()) {
-            if (m_pattern[i + 1] == '%') {
-                nstr.append(1, '%');
-                continue;
-            }
-        }
+AsyncLogAppender::AsyncLogAppender(LogAppender::ptr appender, size_t capacity, OverflowPolicy policy)
+    : m_appender(appender), m_policy(policy), m_events(std::max<size_t>(capacity, 1)) {
+    m_level = LogLevel::UNKNOW;
+    // 被包装的Appender有自己的格式器时沿用, 不被日志器的格式器覆盖
+    if (appender->m_has_formatter) {
+        setFormatter(appender->getFormatter());
+    }
+    m_thread = std::make_shared<Thread>(std::bind(&AsyncLogAppender::run, this), "log_appender");
+    Mutex::Lock lock(GetAppenderRegistryMutex());
+    GetAsyncAppenders().insert(this);
+}
+
+AsyncLogAppender::~AsyncLogAppender() {
+    UnregisterAsyncAppender(this);
+    bool wake;
+    {
+        MutexType::Lock lock(m_queue_mutex);
+        m_stopping = true;
+        wake = takeSleeping();
+    }
+    if (wake) {
+        m_semaphore.notify();
+    }
+    // 后台线程输出剩余事件后退出
+    m_thread->join();
+}
+
+AsyncLogAppender::OverflowPolicy AsyncLogAppender::PolicyFromString(const std::string& str) {
+    if (str == "drop_oldest") {
+        return DROP_OLDEST;
+    }
+    if (str == "drop_newest") {
+        return DROP_NEWEST;
+    }
+    return BLOCK;
+}
+
+const char* AsyncLogAppender::PolicyToString(OverflowPolicy policy) {
+    switch (policy) {
+        case DROP_OLDEST:
+            return "drop_oldest";
+        case DROP_NEWEST:
+            return "drop_newest";
+        default:
+            return "block";
+    }
+}
 
-        size_t n = i + 1;
-        int fmt_status = 0;
-        size_t fmt_begin = 0;
+bool AsyncLogAppender::takeSleeping() {
+    bool v = m_sleeping;
+    m_sleeping = false;
+    return v;
+}
 
-        std::string str;
-        std::string fmt;
-        while (n < m_pattern.size()) {
-            if (!fmt_status && (!isalpha(m_pattern[n]) && m_pattern[n] != '{' && m_pattern[n] != '}')) {
-                str = m_pattern.substr(i + 1, n - i - 1);
+void AsyncLogAppender::log(LogLevel::Level level, LogEvent::ptr event) {
+    if (level < m_level) {
+        return;
+    }
+    size_t capacity = m_events.size();
+    bool blocked = false;
+    bool wake = false;
+    {
+        MutexType::Lock lock(m_queue_mutex);
+        while (m_tail - m_head >= capacity) {
+            if (m_policy == DROP_NEWEST) {
+                ++m_dropped;
+                return;
+            }
+            if (m_policy == DROP_OLDEST) {
+                m_events[m_head++ % capacity].reset();
+                ++m_dropped;
+                ++m_done;
                 break;
             }
-            if (fmt_status == 0) {
-                if (m_pattern[n] == '{') {
-                    str = m_pattern.substr(i + 1, n - i - 1);
-                    fmt_status = 1;
-                    fmt_begin = n;
-                    ++n;
-                    continue;
-                }
-            } else if (fmt_status == 1) {
-                if (m_pattern[n] == '}') {
-                    fmt = m_pattern.substr(fmt_begin + 1, n - fmt_begin - 1);
-                    fmt_status = 0;
-                    ++n;
+            // BLOCK: 等待后台线程取出. 队列非空时后台线程已被唤醒
+            if (!blocked) {
+                blocked = true;
+                ++m_blocked;
+            }
+            m_progress.wait(m_queue_mutex);
+        }
+        // 事件可能在调用方栈上, 拷贝到槽位并持有日志器
+        LogEvent& slot = m_events[m_tail++ % capacity];
+        slot = *event;
+        slot.retainLogger();
+        ++m_pushed;
+        wake = takeSleeping();
+    }
+    if (wake) {
+        m_semaphore.notify();
+    }
+}
+
+void AsyncLogAppender::run() {
+    std::vector<LogEvent> batch;
+    while (true) {
+        size_t count = 0;
+        {
+            MutexType::Lock lock(m_queue_mutex);
+            size_t capacity = m_events.size();
+            count = m_tail - m_head;
+            if (!count) {
+                if (m_stopping) {
                     break;
                 }
+                m_sleeping = true;
+                lock.unlock();
+                m_semaphore.wait();
+                continue;
             }
-            ++n;
-            if (n == m_pattern.size()) {
-                if (str.empty()) {
-                    str = m_pattern.substr(i + 1);
-                }
+            // 交换出队列中的事件, 槽位与batch的缓冲区都可复用
+            if (batch.size() < count) {
+                batch.resize(count);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                std::swap(batch[i], m_events[m_head++ % capacity]);
             }
+            // 队列已有空位
+            m_progress.notifyAll();
+        }
+
+        LogFormatter::ptr formatter = std::atomic_load(&m_formatter);
+        if (formatter != std::atomic_load(&m_appender->m_formatter)) {
+            MutexType::Lock lock(m_appender->m_mutex);
+            std::atomic_store(&m_appender->m_formatter, formatter);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            LogEvent& event = batch[i];
+            m_appender->log(event.getLevel(), LogEvent::ptr(LogEvent::ptr(), &event));
+            event.reset();
+        }
+        m_written += count;
+        MutexType::Lock lock(m_queue_mutex);
+        m_done += count;
+        m_progress.notifyAll();
+    }
+}
+
+bool AsyncLogAppender::flush(uint64_t timeout_ms) {
+    // 后台线程自己等待会死锁
+    if (Thread::GetThis() == m_thread.get()) {
+        return false;
+    }
+    uint64_t deadline = timeout_ms == UINT64_MAX ? UINT64_MAX : GetMonotonicMS() + timeout_ms;
+    MutexType::Lock lock(m_queue_mutex);
+    uint64_t target = m_pushed;
+    // 入队时已唤醒后台线程, 等待它输出
+    while (m_done < target) {
+        if (deadline == UINT64_MAX) {
+            m_progress.wait(m_queue_mutex);
+            continue;
+        }
+        uint64_t now = GetMonotonicMS();
+        if (now >= deadline) {
+            return false;
+        }
+        m_progress.waitFor(m_queue_mutex, deadline - now);
+    }
+    return true;
+}
+
+std::string AsyncLogAppender::toYamlString() {
+    YAML::Node node = YAML::Load(m_appender->toYamlString());
+    {
+        MutexType::Lock lock(m_mutex);
+        node.remove("level");
+        node.remove("formatter");
+        if (m_level != LogLevel::UNKNOW) {
+            node["level"] = LogLevel::ToString(m_level);
+        }
+        if (m_has_formatter && m_formatter) {
+            node["formatter"] = m_formatter->getPattern();
         }
+    }
+    node["async"] = true;
+    node["queue_size"] = m_events.size();
+    node["overflow"] = PolicyToString(m_policy);
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
 
-        if (fmt_status == 0) {
-            if (!nstr.empty()) {
-                vec.emplace_back(nstr, std::string(), 0);
-                nstr.clear();
-            }
-            vec.emplace_back(str, fmt, 1);
-            i = n - 1;
-        } else if (fmt_status == 1) {
-            std::cout << "pattern parse error: " << m_pattern << " - " << m_pattern.substr(i) << std::endl;
-            m_error = true;
-            vec.emplace_back("<<pattern_error>>", fmt, 0);
-        }
-    }
-    if (!nstr.empty()) {
-        vec.emplace_back(nstr, std::string(), 0);
-    }
-    static std::map<std::string, std::function<FormatItem::ptr(const std::string& fmt)>> s_format_items = {
-        {"m", [](const std::string& fmt) { return std::make_shared<MessageFormatItem>(fmt); }},     // m:消息
-        {"p", [](const std::string& fmt) { return std::make_shared<LevelFormatItem>(fmt); }},       // p:日志级别
-        {"r", [](const std::string& fmt) { return std::make_shared<ElapseFormatItem>(fmt); }},      // r:累计毫秒数
-        {"c", [](const std::string& fmt) { return std::make_shared<NameFormatItem>(fmt); }},        // c:日志名称
-        {"t", [](const std::string& fmt) { return std::make_shared<ThreadIdFormatItem>(fmt); }},    // t:线程id
-        {"N", [](const std::string& fmt) { return std::make_shared<ThreadNameFormatItem>(fmt); }},  // N:线程名称
-        {"F", [](const std::string& fmt) { return std::make_shared<FiberIdFormatItem>(fmt); }},     // F:协程id
-        {"d", [](const std::string& fmt) { return std::make_shared<TimeFormatItem>(fmt); }},        // d:时间
-        {"f", [](const std::string& fmt) { return std::make_shared<FilenameFormatItem>(fmt); }},    // f:文件名
-        {"l", [](const std::string& fmt) { return std::make_shared<LineFormatItem>(fmt); }},        // l:行号
-        {"n", [](const std::string& fmt) { return std::make_shared<NewLineFormatItem>(fmt); }},     // n:换行
-        {"T", [](const std::string& fmt) { return std::make_shared<TabFormatItem>(fmt); }},         // T:Tab
+/**
+ * @brief 开放寻址(线性探测)的日志器哈希表, 发布后不再修改
+ */
+struct LoggerManager::LoggerTable {
+    struct Entry {
+        uint64_t hash = 0;
+        Logger::ptr logger;  // 为空表示空槽
     };
 
-    for (auto& i : vec) {
-        if (std::get<2>(i) == 0) {
-            m_items.emplace_back(std::make_shared<StringFormatItem>(std::get<0>(i)));
-        } else {
-            auto iter = s_format_items.find(std::get<0>(i));
-            if (iter == s_format_items.end()) {
-                m_items.emplace_back(std::make_shared<StringFormatItem>("<<error_format %" + std::get<0>(i) + ">>"));
-                m_error = true;
-            } else {
-                m_items.emplace_back(iter->second(std::get<1>(i)));
+    LoggerTable(size_t count) {
+        size_t size = 16;
+        while (size < count * 2) {
+            size <<= 1;
+        }
+        entries.resize(size);
+        mask = size - 1;
+    }
+
+    const Logger::ptr* find(uint64_t hash, std::string_view name) const {
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            const Entry& entry = entries[i];
+            if (!entry.logger) {
+                return nullptr;
+            }
+            if (entry.hash == hash && entry.logger->getName() == name) {
+                return &entry.logger;
             }
         }
-        // std::cout << "(" << std::get<0>(i) << ") - (" << std::get<1>(i) << ") - (" << std::get<2>(i) << ")" << std::endl;
     }
-}
+
+    void insert(uint64_t hash, const Logger::ptr& logger) {
+        size_t i = hash & mask;
+        while (entries[i].logger) {
+            i = (i + 1) & mask;
+        }
+        entries[i].hash = hash;
+        entries[i].logger = logger;
+    }
+
+    std::vector<Entry> entries;
+    size_t mask = 0;
+};
 
 LoggerManager::LoggerManager() {
     m_root.reset(new Logger());
     m_root->addAppender(std::make_shared<StdoutLogAppender>());
 
     m_loggers[m_root->m_name] = m_root;
+    LoggerTable* table = new LoggerTable(m_loggers.size());
+    table->insert(LogNameHash(m_root->m_name), m_root);
+    m_table.store(table);
+}
+
+LoggerManager::~LoggerManager() {
+    delete m_table.load();
 }
 
 Logger::ptr LoggerManager::getLogger(const std::string& name) {
+    return getLogger(LogNameHash(name), name);
+}
+
+Logger::ptr LoggerManager::getLogger(uint64_t hash, std::string_view name) {
+    {
+        RcuReadLock lock;
+        const Logger::ptr* logger = m_table.load()->find(hash, name);
+        if (logger) {
+            return *logger;
+        }
+    }
+    return create(hash, name);
+}
+
+Logger::ptr LoggerManager::create(uint64_t hash, std::string_view name) {
     MutexType::Lock lock(m_mutex);
 
-    auto iter = m_loggers.find(name);
+    std::string key(name);
+    auto iter = m_loggers.find(key);
     if (iter != m_loggers.end()) {
+        // 其他线程已创建
         return iter->second;
     }
     // 如果没有找到该logger, 则创建
-    Logger::ptr logger = std::make_shared<Logger>(name);
+    Logger::ptr logger = std::make_shared<Logger>(key);
     logger->m_root = m_root;
-    m_loggers[name] = logger;
+    m_loggers[key] = logger;
+
+    const LoggerTable* old_table = m_table.load();
+    LoggerTable* table = new LoggerTable(m_loggers.size());
+    for (auto& entry : old_table->entries) {
+        if (entry.logger) {
+            table->insert(entry.hash, entry.logger);
+        }
+    }
+    table->insert(hash, logger);
+    m_table.store(table);
+    RcuRetire(old_table);
     return logger;
 }
 
@@ -571,17 +2386,418 @@ std::string LoggerManager::toYamlString() {
     return ss.str();
 }
 
+/**
+ * @brief 单生产者单消费者的无锁环形队列
+ * @details 生产者为所属线程, 消费者为异步日志后台线程
+ */
+class LogRing {
+public:
+    LogRing(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_mask = size - 1;
+        m_events.resize(size);
+    }
+
+    bool push(const LogEvent& event) {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) > m_mask) {
+            return false;
+        }
+        // 事件在调用方栈上, 拷贝到预分配的槽位并持有日志器
+        LogEvent& slot = m_events[tail & m_mask];
+        slot = event;
+        slot.retainLogger();
+        // seq_cst与后台线程的休眠标记配对, 避免丢失唤醒
+        m_tail.store(tail + 1, std::memory_order_seq_cst);
+        return true;
+    }
+
+    template <class Callback>
+    size_t pop(Callback cb) {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        uint64_t tail = m_tail.load(std::memory_order_acquire);
+        for (uint64_t i = head; i < tail; ++i) {
+            LogEvent& event = m_events[i & m_mask];
+            cb(event);
+            event.reset();
+        }
+        m_head.store(tail, std::memory_order_release);
+        return tail - head;
+    }
+
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    // 生产位置与消费位置即该队列的累计入队数与出队数
+    uint64_t pushed() const { return m_tail.load(std::memory_order_acquire); }
+    uint64_t popped() const { return m_head.load(std::memory_order_acquire); }
+    bool full() const { return pushed() - popped() > m_mask; }
+
+    void close() { m_closed = true; }
+    bool isClosed() const { return m_closed; }
+
+private:
+    alignas(64) std::atomic<uint64_t> m_head{0};  // 消费位置
+    alignas(64) std::atomic<uint64_t> m_tail{0};  // 生产位置
+    alignas(64) std::atomic<bool> m_closed{false};  // 所属线程已退出
+    uint64_t m_mask = 0;
+    std::vector<LogEvent> m_events;
+};
+
+/**
+ * @brief 线程退出时关闭该线程的队列, 剩余日志由后台线程输出后释放
+ */
+struct LogRingHolder {
+    std::shared_ptr<LogRing> ring;
+
+    ~LogRingHolder() {
+        if (ring) {
+            ring->close();
+        }
+    }
+};
+
+static thread_local LogRingHolder t_log_ring;
+static thread_local bool t_log_flusher = false;
+
+AsyncLogManager::AsyncLogManager() {
+}
+
+AsyncLogManager::~AsyncLogManager() {
+    m_enabled = false;
+    if (m_thread) {
+        m_stopping = true;
+        wakeup();
+        m_thread->join();
+    }
+    drain();
+}
+
+void AsyncLogManager::setEnabled(bool v) {
+    if (v) {
+        MutexType::Lock lock(m_mutex);
+        if (!m_thread) {
+            m_thread = std::make_shared<Thread>(std::bind(&AsyncLogManager::run, this), "log_async");
+        }
+    }
+    m_enabled = v;
+    if (!v) {
+        flush();
+    }
+}
+
+AsyncLogManager::OverflowPolicy AsyncLogManager::PolicyFromString(const std::string& str) {
+    if (str == "drop") {
+        return DROP;
+    }
+    if (str == "drop_low_level") {
+        return DROP_LOW_LEVEL;
+    }
+    return BLOCK;
+}
+
+LogRing* AsyncLogManager::getRing() {
+    if (!t_log_ring.ring) {
+        t_log_ring.ring = std::make_shared<LogRing>(m_capacity);
+        MutexType::Lock lock(m_mutex);
+        m_rings.emplace_back(t_log_ring.ring);
+    }
+    return t_log_ring.ring.get();
+}
+
+bool AsyncLogManager::push(const LogEvent& event) {
+    // 后台线程自身产生的日志同步输出, 避免等待自己
+    if (t_log_flusher) {
+        return false;
+    }
+    LogRing* ring = getRing();
+    if (ring->push(event)) {
+        wakeup();
+        return true;
+    }
+
+    OverflowPolicy policy = m_policy;
+    if (policy == DROP || (policy == DROP_LOW_LEVEL && event.getLevel() < LogLevel::WARN)) {
+        ++m_dropped;
+        return true;
+    }
+    ++m_blocked;
+    while (!ring->push(event)) {
+        if (!m_enabled) {
+            return false;
+        }
+        MutexType::Lock lock(m_wait_mutex);
+        wakeup();
+        // 后台线程每输出一批后在m_wait_mutex下通知, 持锁检查不会错过
+        if (ring->full()) {
+            m_drained.wait(m_wait_mutex);
+        }
+    }
+    wakeup();
+    return true;
+}
+void AsyncLogManager::wakeup() {
+    if (m_sleeping.load() && m_sleeping.exchange(false)) {
+        m_semaphore.notify();
+    }
+}
+
+size_t AsyncLogManager::drain() {
+    std::vector<std::shared_ptr<LogRing>> rings;
+    {
+        MutexType::Lock lock(m_mutex);
+        rings.reserve(m_rings.size());
+        for (auto iter = m_rings.begin(); iter != m_rings.end();) {
+            // 线程已退出且队列为空的可以释放
+            if ((*iter)->isClosed() && (*iter)->empty()) {
+                m_retired_pushed += (*iter)->pushed();
+                iter = m_rings.erase(iter);
+            } else {
+                rings.emplace_back(*iter);
+                ++iter;
+            }
+        }
+    }
+
+    size_t count = 0;
+    for (auto& ring : rings) {
+        count += ring->pop([](LogEvent& event) {
+            event.getLogger()->log(event.getLevel(), LogEvent::ptr(LogEvent::ptr(), &event));
+        });
+    }
+    if (count) {
+        m_written += count;
+        // 通知等待队列空间的生产者与flush
+        MutexType::Lock lock(m_wait_mutex);
+        m_drained.notifyAll();
+    }
+    return count;
+}
+
+void AsyncLogManager::run() {
+    t_log_flusher = true;
+    while (!m_stopping) {
+        if (drain()) {
+            continue;
+        }
+        // 先标记休眠再检查一次, 与生产者的seq_cst写及析构时的m_stopping配对
+        m_sleeping = true;
+        if (drain() || m_stopping) {
+            m_sleeping = false;
+            continue;
+        }
+        m_semaphore.wait();
+    }
+}
+
+uint64_t AsyncLogManager::getPushed() const {
+    MutexType::Lock lock(m_mutex);
+    uint64_t pushed = m_retired_pushed;
+    for (auto& ring : m_rings) {
+        pushed += ring->pushed();
+    }
+    return pushed;
+}
+
+bool AsyncLogManager::flush(uint64_t timeout_ms) {
+    // 后台线程无法等待自己输出
+    if (t_log_flusher || !m_thread) {
+        return !m_thread;
+    }
+    uint64_t deadline = timeout_ms == UINT64_MAX ? UINT64_MAX : GetMonotonicMS() + timeout_ms;
+    // 记录各队列当前的生产位置, 等待消费位置追上
+    std::vector<std::pair<std::shared_ptr<LogRing>, uint64_t>> targets;
+    {
+        MutexType::Lock lock(m_mutex);
+        for (auto& ring : m_rings) {
+            targets.emplace_back(ring, ring->pushed());
+        }
+    }
+    auto done = [&targets]() {
+        for (auto& [ring, target] : targets) {
+            if (ring->popped() < target) {
+                return false;
+            }
+        }
+        return true;
+    };
+    MutexType::Lock lock(m_wait_mutex);
+    while (!done()) {
+        wakeup();
+        if (deadline == UINT64_MAX) {
+            m_drained.wait(m_wait_mutex);
+            continue;
+        }
+        uint64_t now = GetMonotonicMS();
+        if (now >= deadline) {
+            return false;
+        }
+        m_drained.waitFor(m_wait_mutex, deadline - now);
+    }
+    return true;
+}
+
+// LogFlushAll等待每个异步队列的上限
+static constexpr uint64_t LOG_FLUSH_ALL_TIMEOUT_MS = 1000;
+
+void LogFlushAll() {
+    // 调用方可能是某个后台输出线程, 也可能正持有某个Appender的锁(如在其输出过程中断言失败):
+    // 跳过调用方自己的后台线程, 等待有上限, 被占用的FileLogAppender不等待
+    AsyncLogMgr::GetInstance()->flush(LOG_FLUSH_ALL_TIMEOUT_MS);
+    VisitAsyncAppenders([](AsyncLogAppender* appender) { appender->flush(LOG_FLUSH_ALL_TIMEOUT_MS); });
+    VisitFileAppenders([](FileLogAppender* appender) { appender->tryFlush(); });
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(stdout);
+    fflush(stderr);
+}
+
+static const int s_crash_signals[] = {SIGSEGV, SIGABRT, SIGBUS};
+static struct sigaction s_crash_old_actions[sizeof(s_crash_signals) / sizeof(s_crash_signals[0])];
+static bool s_crash_installed = false;
+static volatile sig_atomic_t s_crashing = 0;
+static char s_crash_stack[64 * 1024];
+
+static const char* CrashSignalName(int sig) {
+    switch (sig) {
+        case SIGSEGV:
+            return "SIGSEGV";
+        case SIGABRT:
+            return "SIGABRT";
+        case SIGBUS:
+            return "SIGBUS";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+// 异步信号安全的字符串拼接, 超出容量时截断
+struct CrashMessage {
+    char data[512];
+    size_t size = 0;
+
+    void append(const char* str, size_t len) {
+        len = std::min(len, sizeof(data) - size);
+        memcpy(data + size, str, len);
+        size += len;
+    }
+
+    void append(const char* str) { append(str, strlen(str)); }
+
+    void append(uint64_t v) {
+        char buf[24];
+        char* p = buf + sizeof(buf);
+        do {
+            *--p = '0' + v % 10;
+            v /= 10;
+        } while (v);
+        append(p, buf + sizeof(buf) - p);
+    }
+};
+
+static void LogCrashHandler(int sig) {
+    size_t index = 0;
+    while (s_crash_signals[index] != sig) {
+        ++index;
+    }
+    if (!s_crashing) {
+        s_crashing = 1;
+
+        CrashMessage msg;
+        msg.append("\n*** FATAL: signal ");
+        msg.append((uint64_t)sig);
+        msg.append(" (");
+        msg.append(CrashSignalName(sig));
+        msg.append(") thread_id=");
+        msg.append((uint64_t)GetThreadId());
+        msg.append(" thread_name=");
+        msg.append(Thread::GetName().c_str(), Thread::GetName().size());
+        msg.append(", backtrace:\n");
+        void* frames[64];
+        int depth = ::backtrace(frames, 64);
+
+        for (auto& i : s_file_appenders) {
+            FileLogAppender* appender = i.load(std::memory_order_acquire);
+            if (appender) {
+                appender->crashFlush(msg.data, msg.size, frames, depth);
+            }
+        }
+        CrashWrite(STDERR_FILENO, msg.data, msg.size);
+        backtrace_symbols_fd(frames, depth, STDERR_FILENO);
+    }
+    // 恢复原处理方式后重新发送, 信号在返回后递达(SIGSEGV等会在原指令处再次触发)
+    sigaction(sig, &s_crash_old_actions[index], nullptr);
+    raise(sig);
+}
+
+void InstallLogCrashHandler() {
+    if (s_crash_installed) {
+        return;
+    }
+    s_crash_installed = true;
+    // backtrace首次调用会加载libgcc并分配内存, 提前调用一次
+    void* frames[1];
+    ::backtrace(frames, 1);
+
+    stack_t ss;
+    memset(&ss, 0, sizeof(ss));
+    ss.ss_sp = s_crash_stack;
+    ss.ss_size = sizeof(s_crash_stack);
+    sigaltstack(&ss, nullptr);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = LogCrashHandler;
+    sa.sa_flags = SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    for (size_t i = 0; i < sizeof(s_crash_signals) / sizeof(s_crash_signals[0]); ++i) {
+        sigaction(s_crash_signals[i], &sa, &s_crash_old_actions[i]);
+    }
+}
+
+void UninstallLogCrashHandler() {
+    if (!s_crash_installed) {
+        return;
+    }
+    s_crash_installed = false;
+    for (size_t i = 0; i < sizeof(s_crash_signals) / sizeof(s_crash_signals[0]); ++i) {
+        sigaction(s_crash_signals[i], &s_crash_old_actions[i], nullptr);
+    }
+}
+
 struct LogAppenderDefine {
-    int type = 0;  // 1: File, 2: Stdout
+    int type = 0;  // 1: File, 2: Stdout, 3: Mmap, 4: Binary
     LogLevel::Level level = LogLevel::UNKNOW;
     std::string formatter;
     std::string file;
+    uint64_t buffer_size = 64 * 1024;  // File: 缓冲区大小
+    uint64_t flush_interval = 1000;    // File: 缓冲区最长滞留时间(毫秒)
+    uint64_t rotate_size = 0;          // File: 按大小切分的阈值(字节)
+    uint64_t rotate_interval = 0;      // File: 按时间切分的周期(秒)
+    uint64_t chunk_size = 16 * 1024 * 1024;  // Mmap: 每次映射的大小
+    int compress = 0;                  // File: 压缩方式, 见FileLogAppender::CompressMode
+    bool async = false;                // 在独立队列和线程上运行, 见AsyncLogAppender
+    uint64_t queue_size = 1024;        // async: 队列容量
+    int overflow = 0;                  // async: 队列满时的策略, 见AsyncLogAppender::OverflowPolicy
 
     bool operator==(const LogAppenderDefine& oth) const {
         return type == oth.type &&
                level == oth.level &&
                formatter == oth.formatter &&
-               file == oth.file;
+               file == oth.file &&
+               buffer_size == oth.buffer_size &&
+               flush_interval == oth.flush_interval &&
+               rotate_size == oth.rotate_size &&
+               rotate_interval == oth.rotate_interval &&
+               chunk_size == oth.chunk_size &&
+               compress == oth.compress &&
+               async == oth.async &&
+               queue_size == oth.queue_size &&
+               overflow == oth.overflow;
     }
 };
 
@@ -590,11 +2806,17 @@ struct LogDefine {
     LogLevel::Level level = LogLevel::UNKNOW;  // 日志级别
     std::vector<LogAppenderDefine> appenders;  // 目标目录列表
     std::string formatter;                     // 日志格式器
+    uint32_t rate_limit = 0;                   // 每个调用点每秒最多输出的条数, 0不限
+    uint32_t burst = 0;                        // 每个调用点允许的突发条数, 0与rate_limit相同
+    double sample = 1;                         // 采样比例
 
     bool operator==(const LogDefine& oth) const {
         return name == oth.name &&
                level == oth.level &&
                formatter == oth.formatter &&
+               rate_limit == oth.rate_limit &&
+               burst == oth.burst &&
+               sample == oth.sample &&
                appenders == oth.appenders;
     }
 
@@ -604,10 +2826,9 @@ struct LogDefine {
 };
 
 template <>
-class LexicalCast<std::string, LogDefine> {
+class LexicalCast<YAML::Node, LogDefine> {
 public:
-    LogDefine operator()(const std::string& str) {
-        YAML::Node node = YAML::Load(str);
+    LogDefine operator()(const YAML::Node& node) {
         LogDefine log_define;
         if (!node["name"].IsDefined()) {
             std::cout << "log config error: name is null, " << node << std::endl;
@@ -618,6 +2839,19 @@ public:
         if (node["formatter"].IsDefined()) {
             log_define.formatter = node["formatter"].as<std::string>();
         }
+        if (node["rate_limit"].IsDefined()) {
+            log_define.rate_limit = node["rate_limit"].as<uint32_t>();
+        }
+        if (node["burst"].IsDefined()) {
+            log_define.burst = node["burst"].as<uint32_t>();
+        }
+        if (node["sample"].IsDefined()) {
+            log_define.sample = node["sample"].as<double>();
+            if (!(log_define.sample > 0 && log_define.sample <= 1)) {
+                std::cout << "log config error: sample must be in (0, 1], " << node << std::endl;
+                log_define.sample = 1;
+            }
+        }
         if (node["appenders"].IsDefined()) {
             for (size_t i = 0; i < node["appenders"].size(); ++i) {
                 auto appender_node = node["appenders"][i];
@@ -627,13 +2861,39 @@ public:
                 }
                 std::string type = appender_node["type"].as<std::string>();
                 LogAppenderDefine appender_define;
-                if (type == "FileLogAppender") {
-                    appender_define.type = 1;
+                if (type == "FileLogAppender" || type == "BinaryLogAppender") {
+                    appender_define.type = type == "FileLogAppender" ? 1 : 4;
                     if (!appender_node["file"].IsDefined()) {
                         std::cout << "log config error: fileappender file is null, " << appender_node << std::endl;
                         continue;
                     }
                     appender_define.file = appender_node["file"].as<std::string>();
+#define XX(name)                                                                 \
+    if (appender_node[#name].IsDefined()) {                                      \
+        appender_define.name = appender_node[#name].as<uint64_t>();              \
+    }
+                    XX(buffer_size);
+                    XX(flush_interval);
+                    XX(rotate_size);
+                    XX(rotate_interval);
+#undef XX
+                    if (appender_node["compress"].IsDefined()) {
+                        appender_define.compress =
+                            FileLogAppender::CompressModeFromString(appender_node["compress"].as<std::string>());
+                    }
+                    if (appender_node["formatter"].IsDefined()) {
+                        appender_define.formatter = appender_node["formatter"].as<std::string>();
+                    }
+                } else if (type == "MmapLogAppender") {
+                    appender_define.type = 3;
+                    if (!appender_node["file"].IsDefined()) {
+                        std::cout << "log config error: mmapappender file is null, " << appender_node << std::endl;
+                        continue;
+                    }
+                    appender_define.file = appender_node["file"].as<std::string>();
+                    if (appender_node["chunk_size"].IsDefined()) {
+                        appender_define.chunk_size = appender_node["chunk_size"].as<uint64_t>();
+                    }
                     if (appender_node["formatter"].IsDefined()) {
                         appender_define.formatter = appender_node["formatter"].as<std::string>();
                     }
@@ -643,6 +2903,16 @@ public:
                     std::cout << "log config error: appender type is invalid, " << appender_node << std::endl;
                     continue;
                 }
+                if (appender_node["async"].IsDefined()) {
+                    appender_define.async = appender_node["async"].as<bool>();
+                }
+                if (appender_node["queue_size"].IsDefined()) {
+                    appender_define.queue_size = appender_node["queue_size"].as<uint64_t>();
+                }
+                if (appender_node["overflow"].IsDefined()) {
+                    appender_define.overflow =
+                        AsyncLogAppender::PolicyFromString(appender_node["overflow"].as<std::string>());
+                }
                 log_define.appenders.emplace_back(appender_define);
             }
         }
@@ -650,6 +2920,14 @@ public:
     }
 };
 
+template <>
+class LexicalCast<std::string, LogDefine> {
+public:
+    LogDefine operator()(const std::string& str) {
+        return LexicalCast<YAML::Node, LogDefine>()(YAML::Load(str));
+    }
+};
+
 template <>
 class LexicalCast<LogDefine, std::string> {
 public:
@@ -662,13 +2940,44 @@ public:
         if (!log_define.formatter.empty()) {
             node["formatter"] = log_define.formatter;
         }
+        if (log_define.rate_limit) {
+            node["rate_limit"] = log_define.rate_limit;
+        }
+        if (log_define.burst) {
+            node["burst"] = log_define.burst;
+        }
+        if (log_define.sample < 1) {
+            node["sample"] = log_define.sample;
+        }
         for (auto& appender_define : log_define.appenders) {
             YAML::Node appender_node;
-            if (appender_define.type == 1) {
-                appender_node["type"] = "FileLogAppender";
+            if (appender_define.type == 1 || appender_define.type == 4) {
+                appender_node["type"] = appender_define.type == 1 ? "FileLogAppender" : "BinaryLogAppender";
                 appender_node["file"] = appender_define.file;
+                appender_node["buffer_size"] = appender_define.buffer_size;
+                appender_node["flush_interval"] = appender_define.flush_interval;
+                if (appender_define.rotate_size) {
+                    appender_node["rotate_size"] = appender_define.rotate_size;
+                }
+                if (appender_define.rotate_interval) {
+                    appender_node["rotate_interval"] = appender_define.rotate_interval;
+                }
+                if (appender_define.compress) {
+                    appender_node["compress"] =
+                        FileLogAppender::CompressModeToString((FileLogAppender::CompressMode)appender_define.compress);
+                }
             } else if (appender_define.type == 2) {
                 appender_node["type"] = "StdoutLogAppender";
+            } else if (appender_define.type == 3) {
+                appender_node["type"] = "MmapLogAppender";
+                appender_node["file"] = appender_define.file;
+                appender_node["chunk_size"] = appender_define.chunk_size;
+            }
+            if (appender_define.async) {
+                appender_node["async"] = true;
+                appender_node["queue_size"] = appender_define.queue_size;
+                appender_node["overflow"] =
+                    AsyncLogAppender::PolicyToString((AsyncLogAppender::OverflowPolicy)appender_define.overflow);
             }
             if (appender_define.level != LogLevel::UNKNOW) {
                 appender_node = LogLevel::ToString(appender_define.level);
@@ -688,6 +2997,48 @@ public:
 sylar::ConfigVar<std::set<LogDefine>>::ptr g_log_defines =
     sylar::Config::Lookup("logs", std::set<LogDefine>(), "logs config");
 
+static sylar::ConfigVar<bool>::ptr g_log_async_enable =
+    sylar::Config::Lookup("log.async.enable", false, "log async mode");
+
+static sylar::ConfigVar<uint32_t>::ptr g_log_async_capacity =
+    sylar::Config::Lookup("log.async.capacity", (uint32_t)1024, "per-thread async log ring capacity");
+
+static sylar::ConfigVar<std::string>::ptr g_log_async_overflow =
+    sylar::Config::Lookup("log.async.overflow", std::string("block"), "async log overflow policy: block, drop, drop_low_level");
+
+// 默认不安装: 库在main之前加载, 不应覆盖宿主程序或sanitizer的信号处理
+static sylar::ConfigVar<bool>::ptr g_log_crash_handler =
+    sylar::Config::Lookup("log.crash_handler", false, "flush log buffers on SIGSEGV, SIGABRT, SIGBUS");
+
+struct CrashLogIniter {
+    CrashLogIniter() {
+        g_log_crash_handler->addListener([](const bool& old_value, const bool& new_value) {
+            if (new_value) {
+                InstallLogCrashHandler();
+            } else {
+                UninstallLogCrashHandler();
+            }
+        });
+    }
+};
+
+static CrashLogIniter __crash_log_init;
+
+struct AsyncLogIniter {
+    AsyncLogIniter() {
+        g_log_async_capacity->addListener([](const uint32_t& old_value, const uint32_t& new_value) {
+            AsyncLogMgr::GetInstance()->setCapacity(new_value);
+        });
+        g_log_async_overflow->addListener([](const std::string& old_value, const std::string& new_value) {
+            AsyncLogMgr::GetInstance()->setOverflowPolicy(AsyncLogManager::PolicyFromString(new_value));
+        });
+        g_log_async_enable->addListener([](const bool& old_value, const bool& new_value) {
+            AsyncLogMgr::GetInstance()->setEnabled(new_value);
+        });
+    }
+};
+static AsyncLogIniter __async_log_init;
+
 struct LogIniter {
     LogIniter() {
         g_log_defines->addListener([](const std::set<LogDefine>& old_value,
@@ -709,6 +3060,8 @@ struct LogIniter {
                     }
                 }
                 logger->setLevel(log_define.level);
+                logger->setRateLimit(log_define.rate_limit, log_define.burst);
+                logger->setSample(log_define.sample);
                 if (!log_define.formatter.empty()) {
                     // 如果log_define.formatter格式有问题, logger.formatter格式保持默认
                     logger->setFormatter(log_define.formatter);
@@ -716,10 +3069,28 @@ struct LogIniter {
                 logger->clearAppenders();
                 for (auto& appender_define : log_define.appenders) {
                     LogAppender::ptr appender;
-                    if (appender_define.type == 1) {
-                        appender.reset(new FileLogAppender(appender_define.file));
+                    if (appender_define.type == 1 || appender_define.type == 4) {
+                        FileLogAppender::ptr file_appender;
+                        if (appender_define.type == 1) {
+                            file_appender = std::make_shared<FileLogAppender>(appender_define.file);
+                        } else {
+                            file_appender = std::make_shared<BinaryLogAppender>(appender_define.file);
+                        }
+                        file_appender->setBufferSize(appender_define.buffer_size);
+                        file_appender->setFlushInterval(appender_define.flush_interval);
+                        file_appender->setRotateSize(appender_define.rotate_size);
+                        file_appender->setRotateInterval(appender_define.rotate_interval);
+                        file_appender->setCompress((FileLogAppender::CompressMode)appender_define.compress);
+                        appender = file_appender;
                     } else if (appender_define.type == 2) {
                         appender.reset(new StdoutLogAppender());
+                    } else if (appender_define.type == 3) {
+                        appender.reset(new MmapLogAppender(appender_define.file, appender_define.chunk_size));
+                    }
+                    if (appender_define.async) {
+                        appender = std::make_shared<AsyncLogAppender>(
+                            appender, appender_define.queue_size,
+                            (AsyncLogAppender::OverflowPolicy)appender_define.overflow);
                     }
                     appender->setLevel(appender_define.level);
                     if (!appender_define.formatter.empty()) {
@@ -741,6 +3112,8 @@ struct LogIniter {
                     // 删除logger
                     auto logger = SYLAR_LOG_NAME(log_define.name);
                     logger->setLevel((LogLevel::Level)100);
+                    logger->setRateLimit(0);
+                    logger->setSample(1);
                     logger->clearAppenders();
                 }
             }
@@ -14,28 +14,52 @@
 
 #include <stdarg.h>
 
+#include <atomic>
 #include <fstream>
+#include <functional>
 #include <list>
 #include <map>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 #include "singleton.h"
 #include "thread.h"
 #include "util.h"
 
+/**
+ * @brief 编译期最低日志级别, 由CMake选项SYLAR_LOG_MIN_LEVEL设置
+ * @details 低于该级别的日志宏不产生代码, 参数只做类型检查不求值
+ */
+#ifndef SYLAR_LOG_MIN_LEVEL
+#define SYLAR_LOG_MIN_LEVEL sylar::LogLevel::DEBUG
+#endif
+
+/**
+ * @brief 日志宏的级别判断
+ * @details 先按编译期最低级别裁剪, 再查调用点缓存的判断结果,
+ *          关闭的调用点只有一次比较; 日志器配置了限流或采样时由调用点判断是否放行
+ */
+#define SYLAR_LOG_IF(logger, level)                                                        \
+    if ((level) < SYLAR_LOG_MIN_LEVEL) {                                                   \
+    } else if ([](sylar::Logger* l, sylar::LogLevel::Level lv)                             \
+                   __attribute__((always_inline)) {                                        \
+                       static sylar::LogCallSite s_site(__FILE__, __LINE__);               \
+                       return s_site.isEnabled(l, lv);                                     \
+                   }(&*(logger), level))
+
 /**
  * @brief 使用流式方式将日志级别level的日志写入到logger
+ * @details 日志事件构造在栈上, 内容写入事件的内置缓冲区, 常见情况下不产生堆分配
  */
-#define SYLAR_LOG_LEVEL(logger, level)                                              \
-    if (logger->getLevel() <= level)                                                \
-    sylar::LogEventWrap(std::make_shared<sylar::LogEvent>(__FILE__, __LINE__, 0,    \
-                                                          sylar::GetThreadId(),     \
-                                                          sylar::Thread::GetName(), \
-                                                          sylar::GetFiberId(),      \
-                                                          time(0), logger, level))  \
+#define SYLAR_LOG_LEVEL(logger, level)                                                     \
+    SYLAR_LOG_IF(logger, level)                                                            \
+    sylar::LogEventWrap(__FILE__, __LINE__, sylar::GetElapsedMS(), sylar::GetThreadId(),   \
+                        sylar::Thread::GetInternedName(), sylar::GetFiberId(),             \
+                        sylar::GetWallClockUS(), &*(logger), level)                        \
         .getSS()
 
 #define SYLAR_LOG_DEBUG(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::DEBUG)
@@ -47,14 +71,12 @@
 /**
  * @brief 使用格式化方式将日志级别level的日志写入到logger
  */
-#define SYLAR_LOG_FMT_LEVEL(logger, level, fmt, ...)                                \
-    if (logger->getLevel() <= level)                                                \
-    sylar::LogEventWrap(std::make_shared<sylar::LogEvent>(__FILE__, __LINE__, 0,    \
-                                                          sylar::GetThreadId(),     \
-                                                          sylar::Thread::GetName(), \
-                                                          sylar::GetFiberId(),      \
-                                                          time(0), logger, level))  \
-        .getEvent()                                                                 \
+#define SYLAR_LOG_FMT_LEVEL(logger, level, fmt, ...)                                       \
+    SYLAR_LOG_IF(logger, level)                                                            \
+    sylar::LogEventWrap(__FILE__, __LINE__, sylar::GetElapsedMS(), sylar::GetThreadId(),   \
+                        sylar::Thread::GetInternedName(), sylar::GetFiberId(),             \
+                        sylar::GetWallClockUS(), &*(logger), level)                        \
+        .getEvent()                                                                        \
         ->format(fmt, __VA_ARGS__)
 #define SYLAR_LOG_FMT_DEBUG(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::DEBUG, fmt, __VA_ARGS__)
 #define SYLAR_LOG_FMT_INFO(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::INFO, fmt, __VA_ARGS__)
@@ -62,6 +84,45 @@
 #define SYLAR_LOG_FMT_ERROR(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::ERROR, fmt, __VA_ARGS__)
 #define SYLAR_LOG_FMT_FATAL(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::FATAL, fmt, __VA_ARGS__)
 
+/**
+ * @brief 使用{}格式将日志级别level的日志写入到logger
+ * @details SYLAR_LOG_FORMAT_INFO(g_logger, "name={} cost={:.3f}ms", name, cost);
+ *          占位符与参数在编译期检查, 直接写入事件的内置缓冲区
+ */
+#define SYLAR_LOG_FORMAT_LEVEL(logger, level, fmt, ...)                                    \
+    SYLAR_LOG_IF(logger, level)                                                            \
+    sylar::LogEventWrap(__FILE__, __LINE__, sylar::GetElapsedMS(), sylar::GetThreadId(),   \
+                        sylar::Thread::GetInternedName(), sylar::GetFiberId(),             \
+                        sylar::GetWallClockUS(), &*(logger), level)                        \
+        .getEvent()                                                                        \
+        ->print(fmt __VA_OPT__(, ) __VA_ARGS__)
+#define SYLAR_LOG_FORMAT_DEBUG(logger, fmt, ...) SYLAR_LOG_FORMAT_LEVEL(logger, sylar::LogLevel::DEBUG, fmt, __VA_ARGS__)
+#define SYLAR_LOG_FORMAT_INFO(logger, fmt, ...) SYLAR_LOG_FORMAT_LEVEL(logger, sylar::LogLevel::INFO, fmt, __VA_ARGS__)
+#define SYLAR_LOG_FORMAT_WARN(logger, fmt, ...) SYLAR_LOG_FORMAT_LEVEL(logger, sylar::LogLevel::WARN, fmt, __VA_ARGS__)
+#define SYLAR_LOG_FORMAT_ERROR(logger, fmt, ...) SYLAR_LOG_FORMAT_LEVEL(logger, sylar::LogLevel::ERROR, fmt, __VA_ARGS__)
+#define SYLAR_LOG_FORMAT_FATAL(logger, fmt, ...) SYLAR_LOG_FORMAT_LEVEL(logger, sylar::LogLevel::FATAL, fmt, __VA_ARGS__)
+
+/**
+ * @brief 以二进制方式将日志级别level的日志写入到logger
+ * @details fmt为printf格式, 参数按原始字节写入事件, 调用点的文件, 行号与fmt只登记一次.
+ *          BinaryLogAppender直接输出二进制记录, 其余Appender在输出时才格式化
+ */
+#define SYLAR_LOG_BIN_LEVEL(logger, level, fmt, ...)                                       \
+    SYLAR_LOG_IF(logger, level)                                                            \
+    sylar::LogEventWrap(__FILE__, __LINE__, sylar::GetElapsedMS(), sylar::GetThreadId(),   \
+                        sylar::Thread::GetInternedName(), sylar::GetFiberId(),             \
+                        sylar::GetWallClockUS(), &*(logger), level)                        \
+        .getEvent()                                                                        \
+        ->encode([]() {                                                                    \
+            static sylar::LogBinSite s_site{__FILE__, __LINE__, fmt};                      \
+            return &s_site;                                                                \
+        }() __VA_OPT__(, ) __VA_ARGS__)
+#define SYLAR_LOG_BIN_DEBUG(logger, fmt, ...) SYLAR_LOG_BIN_LEVEL(logger, sylar::LogLevel::DEBUG, fmt, __VA_ARGS__)
+#define SYLAR_LOG_BIN_INFO(logger, fmt, ...) SYLAR_LOG_BIN_LEVEL(logger, sylar::LogLevel::INFO, fmt, __VA_ARGS__)
+#define SYLAR_LOG_BIN_WARN(logger, fmt, ...) SYLAR_LOG_BIN_LEVEL(logger, sylar::LogLevel::WARN, fmt, __VA_ARGS__)
+#define SYLAR_LOG_BIN_ERROR(logger, fmt, ...) SYLAR_LOG_BIN_LEVEL(logger, sylar::LogLevel::ERROR, fmt, __VA_ARGS__)
+#define SYLAR_LOG_BIN_FATAL(logger, fmt, ...) SYLAR_LOG_BIN_LEVEL(logger, sylar::LogLevel::FATAL, fmt, __VA_ARGS__)
+
 /**
  * @brief 获取主日志器
  */
@@ -69,10 +130,28 @@
 
 #define SYLAR_LOG_NAME(name) sylar::LoggerMgr::GetInstance()->getLogger(name)
 
+/**
+ * @brief 按字符串字面量获取日志器, 名称哈希在编译期计算
+ */
+#define SYLAR_LOG_NAME_HASHED(name) \
+    sylar::LoggerMgr::GetInstance()->getLogger(std::integral_constant<uint64_t, sylar::LogNameHash(name)>::value, name)
+
 namespace sylar {
 class Logger;
 class LoggerManger;
 
+/**
+ * @brief 日志器名称的哈希(FNV-1a), 可在编译期计算
+ */
+constexpr uint64_t LogNameHash(std::string_view name) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : name) {
+        hash ^= (uint8_t)c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
 /**
  * @brief 日志级别
  */
@@ -91,30 +170,491 @@ public:
     static LogLevel::Level FromString(const std::string& str);
 };
 
+/**
+ * @brief 日志宏调用点缓存的日志器级别与限流状态
+ * @details m_tag为日志器地址, 低3位为编码: 1~6 为日志器级别+1, 调用时直接与传入的级别比较,
+ *          级别在运行时才确定的调用点同样适用; TAG_LIMITED 日志器配置了限流或采样; 0 未缓存.
+ *          与当前日志器不符时重新判断并用CAS写回, 不加锁.
+ *          任一日志器级别或限流配置变化(包括logs配置变化)或日志器析构时清空所有调用点,
+ *          清空时写入递增的失效值, 失效前开始的判断不会写回.
+ *          限流为令牌桶(GCRA, 单个原子变量记录理论到达时间), 采样为线程局部的伪随机数,
+ *          都不加锁. 被抑制的条数在放行时以一条摘要日志输出, 每秒最多一条
+ */
+class LogCallSite {
+public:
+    enum Tag : uintptr_t {
+        TAG_LIMITED = 7,
+        TAG_MASK = 7,
+    };
+
+    constexpr LogCallSite(const char* file, int32_t line) : m_file(file), m_line(line) {}
+
+    __attribute__((always_inline)) bool isEnabled(Logger* logger, LogLevel::Level level) {
+        uintptr_t code = m_tag.load(std::memory_order_relaxed) ^ (uintptr_t)logger;
+        if (__builtin_expect(code - 1 < TAG_LIMITED - 1, 1)) {
+            return (uintptr_t)level + 1 >= code;
+        }
+        return check(logger, level, code);
+    }
+
+    /**
+     * @brief 被抑制且尚未报告的日志条数
+     */
+    uint64_t getSuppressed() const { return m_suppressed.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 清空所有调用点的缓存
+     */
+    static void InvalidateAll();
+
+private:
+    bool check(Logger* logger, LogLevel::Level level, uintptr_t code);
+    uintptr_t refresh(Logger* logger);
+    void registerSite();
+    bool admit(Logger* logger, LogLevel::Level level);
+
+private:
+    const char* m_file;
+    int32_t m_line;
+    std::atomic<uintptr_t> m_tag{0};
+    std::atomic<uint64_t> m_tat{0};         // 令牌桶的理论到达时间(微秒)
+    std::atomic<uint64_t> m_suppressed{0};  // 被抑制的条数
+    std::atomic<uint64_t> m_last_report{0}; // 上一次输出摘要的时间(微秒)
+    LogCallSite* m_next = nullptr;          // 已登记的调用点链表
+    std::atomic<bool> m_registered{false};
+};
+
+/**
+ * @brief 日志内容缓冲区
+ * @details 内容不超过INLINE_SIZE时存放在内置数组中, 不产生堆分配;
+ *          超出后整体转存到m_spill
+ */
+class LogBuffer {
+public:
+    static const size_t INLINE_SIZE = 256;
+
+    LogBuffer() {}
+    LogBuffer(const LogBuffer& oth) { *this = oth; }
+    LogBuffer& operator=(const LogBuffer& oth);
+
+    const char* data() const { return m_spilled ? m_spill.data() : m_inline; }
+    size_t size() const { return m_spilled ? m_spill.size() : m_size; }
+    bool empty() const { return size() == 0; }
+    std::string_view view() const { return std::string_view(data(), size()); }
+
+    /**
+     * @brief 是否已转存到堆上
+     */
+    bool isSpilled() const { return m_spilled; }
+
+    void append(const char* str, size_t len);
+    void append(char c) { append(&c, 1); }
+
+    /**
+     * @brief 按printf格式追加
+     */
+    void appendf(const char* fmt, va_list al);
+
+    /**
+     * @brief 清空内容, 已转存的堆内存保留以便复用
+     */
+    void clear();
+
+private:
+    void spill(size_t reserve);
+
+private:
+    char m_inline[INLINE_SIZE];  // 内置缓冲区
+    size_t m_size = 0;           // 内置缓冲区已用长度
+    bool m_spilled = false;      // 内容是否在m_spill中
+    std::string m_spill;         // 超出内置缓冲区后的存储
+};
+
+/**
+ * @brief 二进制日志的调用点
+ * @details 由SYLAR_LOG_BIN_*宏在每个调用点静态构造, 首次使用时登记得到id
+ */
+struct LogBinSite {
+    const char* file;                 // 文件名
+    int32_t line;                     // 行号
+    const char* fmt;                  // printf格式
+    std::atomic<uint32_t> id{0};      // 登记后的id, 0表示未登记
+    const char* types = nullptr;      // 参数类型签名, 见LogBinTypeOf
+
+    uint32_t getId(const char* sig) {
+        uint32_t v = id.load(std::memory_order_acquire);
+        return v ? v : Register(this, sig);
+    }
+
+    static uint32_t Register(LogBinSite* site, const char* types);
+};
+
+/**
+ * @brief 二进制日志参数的类型标记
+ * @details i: int32, I: int64, u: uint32, U: uint64, d: double, c: char, b: bool, s: 字符串, p: 指针
+ */
+template <class T>
+constexpr char LogBinTypeOf() {
+    typedef std::decay_t<T> Type;
+    if constexpr (std::is_same_v<Type, char>) {
+        return 'c';
+    } else if constexpr (std::is_same_v<Type, bool>) {
+        return 'b';
+    } else if constexpr (std::is_enum_v<Type>) {
+        return sizeof(Type) > 4 ? 'I' : 'i';
+    } else if constexpr (std::is_integral_v<Type>) {
+        if constexpr (std::is_signed_v<Type>) {
+            return sizeof(Type) > 4 ? 'I' : 'i';
+        } else {
+            return sizeof(Type) > 4 ? 'U' : 'u';
+        }
+    } else if constexpr (std::is_floating_point_v<Type>) {
+        return 'd';
+    } else if constexpr (std::is_same_v<Type, const char*> || std::is_same_v<Type, char*> ||
+                         std::is_same_v<Type, std::string> || std::is_same_v<Type, std::string_view>) {
+        return 's';
+    } else if constexpr (std::is_pointer_v<Type>) {
+        return 'p';
+    } else {
+        static_assert(sizeof(Type) == 0, "unsupported binary log argument type");
+    }
+}
+
+template <class... Args>
+struct LogBinSignature {
+    static constexpr char value[] = {LogBinTypeOf<Args>()..., '\0'};
+};
+
+/**
+ * @brief 按类型标记写入一个参数的原始字节, 字符串为4字节长度加内容
+ */
+template <class T>
+inline void LogBinAppend(LogBuffer& out, const T& v) {
+    constexpr char type = LogBinTypeOf<T>();
+    if constexpr (type == 's') {
+        std::string_view str;
+        if constexpr (std::is_array_v<T>) {
+            str = std::string_view(v);
+        } else if constexpr (std::is_pointer_v<T>) {
+            str = v ? std::string_view(v) : std::string_view("(null)");
+        } else {
+            str = std::string_view(v);
+        }
+        uint32_t len = str.size();
+        out.append((const char*)&len, sizeof(len));
+        out.append(str.data(), len);
+    } else {
+        typedef std::conditional_t<type == 'i', int32_t,
+                std::conditional_t<type == 'I', int64_t,
+                std::conditional_t<type == 'u', uint32_t,
+                std::conditional_t<type == 'U', uint64_t,
+                std::conditional_t<type == 'd', double,
+                std::conditional_t<type == 'c', char,
+                std::conditional_t<type == 'b', uint8_t, uint64_t>>>>>>> WireType;
+        WireType w;
+        if constexpr (type == 'p') {
+            w = (uint64_t)(uintptr_t)v;
+        } else {
+            w = (WireType)v;
+        }
+        out.append((const char*)&w, sizeof(w));
+    }
+}
+
+/**
+ * @brief 按printf格式fmt与类型签名types渲染二进制参数
+ */
+void LogBinRender(LogBuffer& out, const char* fmt, const char* types, const char* args, size_t len);
+
+/**
+ * @brief 解析{}格式串, 运行期与编译期共用
+ * @details {} 或 {:spec} 为占位符, {{ 与 }} 为转义的大括号, 其余为纯文本.
+ *          按顺序对每一项调用cb(arg, placeholder): 纯文本的arg为文本, 占位符的arg为spec
+ * @return 大括号是否配对
+ */
+template <class Callback>
+constexpr bool ParseLogFormat(std::string_view fmt, Callback&& cb) {
+    size_t literal = 0;  // 未输出的纯文本起始位置
+    size_t i = 0;
+    while (i < fmt.size()) {
+        char c = fmt[i];
+        if (c != '{' && c != '}') {
+            ++i;
+            continue;
+        }
+        if (literal < i) {
+            cb(fmt.substr(literal, i - literal), false);
+        }
+        if (i + 1 < fmt.size() && fmt[i + 1] == c) {
+            cb(fmt.substr(i, 1), false);
+            i += 2;
+            literal = i;
+            continue;
+        }
+        if (c == '}') {
+            return false;
+        }
+        size_t end = fmt.find('}', i);
+        if (end == std::string_view::npos) {
+            return false;
+        }
+        std::string_view spec = fmt.substr(i + 1, end - i - 1);
+        if (!spec.empty()) {
+            if (spec[0] != ':') {
+                return false;
+            }
+            spec.remove_prefix(1);
+        }
+        cb(spec, true);
+        i = end + 1;
+        literal = i;
+    }
+    if (literal < fmt.size()) {
+        cb(fmt.substr(literal), false);
+    }
+    return true;
+}
+
+/**
+ * @brief 类型擦除后的{}格式参数
+ */
+struct LogFormatArg {
+    enum Type : uint8_t {
+        INT,
+        UINT,
+        DOUBLE,
+        CHAR,
+        BOOL,
+        STRING,
+        POINTER,
+    };
+
+    template <class T>
+    static constexpr Type TypeOf() {
+        typedef std::decay_t<T> Type;
+        if constexpr (std::is_same_v<Type, bool>) {
+            return BOOL;
+        } else if constexpr (std::is_same_v<Type, char>) {
+            return CHAR;
+        } else if constexpr (std::is_enum_v<Type>) {
+            return std::is_signed_v<std::underlying_type_t<Type>> ? INT : UINT;
+        } else if constexpr (std::is_integral_v<Type>) {
+            return std::is_signed_v<Type> ? INT : UINT;
+        } else if constexpr (std::is_floating_point_v<Type>) {
+            return DOUBLE;
+        } else if constexpr (std::is_same_v<Type, const char*> || std::is_same_v<Type, char*> ||
+                             std::is_same_v<Type, std::string> || std::is_same_v<Type, std::string_view>) {
+            return STRING;
+        } else if constexpr (std::is_pointer_v<Type>) {
+            return POINTER;
+        } else {
+            static_assert(sizeof(Type) == 0, "unsupported log format argument type");
+        }
+    }
+
+    /**
+     * @brief 格式说明是否适用于该类型
+     * @details 整数: d, x, X, o, b; 浮点: [.精度][f|e|g]; 其余类型只能为空
+     */
+    static constexpr bool SpecValid(Type type, std::string_view spec) {
+        if (spec.empty()) {
+            return true;
+        }
+        if (type == INT || type == UINT) {
+            return spec.size() == 1 && std::string_view("dxXob").find(spec[0]) != std::string_view::npos;
+        }
+        if (type != DOUBLE) {
+            return false;
+        }
+        size_t i = 0;
+        if (spec[0] == '.') {
+            while (++i < spec.size() && spec[i] >= '0' && spec[i] <= '9') {
+            }
+            if (i == 1 || i > 3) {
+                return false;
+            }
+        }
+        return i == spec.size() ||
+               (i + 1 == spec.size() && (spec[i] == 'f' || spec[i] == 'e' || spec[i] == 'g'));
+    }
+
+    template <class T>
+    LogFormatArg(const T& v) : type(TypeOf<T>()) {
+        if constexpr (TypeOf<T>() == STRING) {
+            std::string_view str;
+            if constexpr (std::is_array_v<T>) {
+                str = std::string_view(v);
+            } else if constexpr (std::is_pointer_v<T>) {
+                str = v ? std::string_view(v) : std::string_view("(null)");
+            } else {
+                str = std::string_view(v);
+            }
+            s.data = str.data();
+            s.len = str.size();
+        } else if constexpr (TypeOf<T>() == POINTER) {
+            p = v;
+        } else if constexpr (TypeOf<T>() == DOUBLE) {
+            d = v;
+        } else if constexpr (TypeOf<T>() == INT) {
+            i = (int64_t)v;
+        } else if constexpr (TypeOf<T>() == UINT) {
+            u = (uint64_t)v;
+        } else if constexpr (TypeOf<T>() == CHAR) {
+            c = v;
+        } else {
+            b = v;
+        }
+    }
+
+    Type type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        char c;
+        bool b;
+        const void* p;
+        struct {
+            const char* data;
+            size_t len;
+        } s;
+    };
+};
+
+// 只在编译期被"调用", 出现在报错信息中
+void LogFormatArgumentsMismatch();
+
+/**
+ * @brief 编译期检查过的{}格式串
+ * @details 占位符个数与参数个数不一致, 大括号不配对, 或格式说明不适用于对应参数时编译失败
+ */
+template <class... Args>
+class LogFormatString {
+public:
+    template <class S>
+        requires std::is_convertible_v<const S&, std::string_view>
+    consteval LogFormatString(const S& str) : m_str(str) {
+        constexpr LogFormatArg::Type types[] = {LogFormatArg::TypeOf<Args>()..., LogFormatArg::INT};
+        size_t index = 0;
+        bool ok = true;
+        bool paired = ParseLogFormat(m_str, [&](std::string_view spec, bool placeholder) {
+            if (placeholder) {
+                ok = ok && index < sizeof...(Args) && LogFormatArg::SpecValid(types[index], spec);
+                ++index;
+            }
+        });
+        if (!paired || !ok || index != sizeof...(Args)) {
+            LogFormatArgumentsMismatch();
+        }
+    }
+
+    std::string_view get() const { return m_str; }
+
+private:
+    std::string_view m_str;
+};
+
+template <class... Args>
+using LogFormatStringT = LogFormatString<std::type_identity_t<Args>...>;
+
+/**
+ * @brief 按{}格式串把参数直接写入buffer
+ * @details 整数与浮点数用to_chars转换, 不经过printf与流
+ */
+void LogFormatTo(LogBuffer& out, std::string_view fmt, const LogFormatArg* args, size_t count);
+
 /**
  * @brief 日志事件
+ * @details 由SYLAR_LOG_*宏在栈上构造, 线程名为驻留字符串, 日志器为裸指针,
+ *          构造与写入内容都不需要堆分配.
+ *          Logger::log和LogAppender::log收到的LogEvent::ptr可能不拥有事件,
+ *          需要在调用返回后继续使用时必须拷贝事件并调用retainLogger()
  */
 class LogEvent {
 public:
     typedef std::shared_ptr<LogEvent> ptr;
 
+    LogEvent() {}
+
+    /**
+     * @param[in] time 时间戳, 单位微秒
+     */
     LogEvent(const char* file, int32_t line, uint32_t elapse,
-             uint32_t thread_id, const std::string& thread_name,
+             uint32_t thread_id, const char* thread_name,
              uint32_t fiber_id, uint64_t time,
-             std::shared_ptr<Logger> logger, LogLevel::Level level);
+             Logger* logger, LogLevel::Level level);
 
     const char* getFilename() const { return m_file; }
     int32_t getLine() const { return m_line; }
     uint32_t getElapse() const { return m_elapse; }
     uint32_t getThreadId() const { return m_threadId; }
-    std::string getThreadName() const { return m_threadName; }
+    const char* getThreadName() const { return m_threadName; }
     uint32_t getFiberId() const { return m_fiberId; }
-    uint64_t getTime() const { return m_time; }
-    std::string getContent() const { return m_ss.str(); }
-    std::stringstream& getSS() { return m_ss; }
-    std::shared_ptr<Logger> getLogger() const { return m_logger; }
+    uint64_t getTime() const { return m_time / 1000000; }  // 秒
+    uint64_t getTimeUs() const { return m_time; }          // 微秒
+    std::string getContent() const;
+    std::string_view getContentView() const { return m_buffer.view(); }  // 二进制事件为编码后的参数
+    LogBuffer& getBuffer() { return m_buffer; }
+    const LogBuffer& getBuffer() const { return m_buffer; }
+    Logger* getLogger() const { return m_logger; }
     LogLevel::Level getLevel() const { return m_level; }
 
+    /**
+     * @brief 二进制事件的调用点, 文本事件为空
+     */
+    const LogBinSite* getBinSite() const { return m_site; }
+
+    /**
+     * @brief 以二进制方式写入参数, 格式化推迟到输出时
+     */
+    template <class... Args>
+    void encode(LogBinSite* site, const Args&... args) {
+        site->getId(LogBinSignature<Args...>::value);
+        m_site = site;
+        (LogBinAppend(m_buffer, args), ...);
+    }
+
+    /**
+     * @brief 附加结构化字段
+     * @details 键与按类型标记(见LogBinTypeOf)编码的值写入事件的字段缓冲区,
+     *          常见情况下不产生堆分配; 输出时才渲染, 二进制Appender原样写入.
+     *          键超过255字节时截断
+     */
+    template <class T>
+    LogEvent& addField(std::string_view key, const T& value) {
+        uint8_t len = key.size() > 255 ? 255 : key.size();
+        m_fields.append((const char*)&len, 1);
+        m_fields.append(key.data(), len);
+        m_fields.append(LogBinTypeOf<T>());
+        LogBinAppend(m_fields, value);
+        return *this;
+    }
+
+    /**
+     * @brief 编码后的结构化字段, 用LogFieldReader读取
+     */
+    LogBuffer& getFields() { return m_fields; }
+    const LogBuffer& getFields() const { return m_fields; }
+
+    /**
+     * @brief 按{}格式串写入日志内容, 占位符在编译期检查
+     */
+    template <class... Args>
+    void print(LogFormatStringT<Args...> fmt, const Args&... args) {
+        const LogFormatArg list[] = {LogFormatArg(args)..., LogFormatArg(0)};
+        LogFormatTo(m_buffer, fmt.get(), list, sizeof...(Args));
+    }
+
+    /**
+     * @brief 持有日志器的引用, 事件脱离调用栈(如异步队列)前调用
+     */
+    void retainLogger();
+
+    /**
+     * @brief 释放持有的日志器引用并清空内容
+     */
+    void reset();
+
     /**
      * @brief 格式化写入日志内容
      */
@@ -122,64 +662,208 @@ public:
     void format(const char* fmt, va_list al);
 
 private:
-    const char* m_file = nullptr;      // 文件名
-    int32_t m_line = 0;                // 行号
-    uint32_t m_elapse = 0;             // 程序启动到现在的毫秒数
-    uint32_t m_threadId = 0;           // 线程id
-    std::string m_threadName;          // 线程名称
-    uint32_t m_fiberId = 0;            // 协程id
-    uint64_t m_time = 0;               // 时间戳
-    std::stringstream m_ss;            // 日志内容流
-    std::shared_ptr<Logger> m_logger;  // 日志器
-    LogLevel::Level m_level;           // 日志等级
+    const char* m_file = nullptr;              // 文件名
+    int32_t m_line = 0;                        // 行号
+    uint32_t m_elapse = 0;                     // 程序启动到现在的毫秒数
+    uint32_t m_threadId = 0;                   // 线程id
+    const char* m_threadName = "";             // 线程名称(驻留字符串)
+    uint32_t m_fiberId = 0;                    // 协程id
+    uint64_t m_time = 0;                       // 时间戳(微秒)
+    Logger* m_logger = nullptr;                // 日志器
+    LogLevel::Level m_level = LogLevel::UNKNOW;  // 日志等级
+    LogBuffer m_buffer;                        // 日志内容
+    LogBuffer m_fields;                        // 结构化字段
+    const LogBinSite* m_site = nullptr;        // 二进制事件的调用点
+    std::shared_ptr<Logger> m_holder;          // 脱离调用栈时持有的日志器
+};
+
+/**
+ * @brief 解码后的结构化字段, 字符串指向事件的字段缓冲区
+ */
+struct LogFieldView {
+    std::string_view key;
+    char type = 0;     // 类型标记, 见LogBinTypeOf
+    int64_t i = 0;     // i I c b
+    uint64_t u = 0;    // u U p
+    double d = 0;      // d
+    std::string_view s;  // s
+};
+
+/**
+ * @brief 顺序读取事件的结构化字段
+ */
+class LogFieldReader {
+public:
+    LogFieldReader(const LogBuffer& fields) : m_cur(fields.data()), m_end(fields.data() + fields.size()) {}
+
+    /**
+     * @return 没有更多字段或数据不完整时返回false
+     */
+    bool next(LogFieldView& field);
+
+private:
+    const char* m_cur;
+    const char* m_end;
 };
 
+/**
+ * @brief 以" key=value"的形式追加全部字段
+ */
+void LogAppendFields(LogBuffer& out, const LogBuffer& fields);
+
+/**
+ * @brief 追加JSON字符串(含引号), 按需转义
+ */
+void LogAppendJsonString(LogBuffer& out, std::string_view str);
+
+/**
+ * @brief 把事件输出为一个JSON对象, 结构化字段作为对象的成员
+ * @param[in] time_fmt 以'\0'结尾的时间格式, 见LogAppendTime
+ */
+void LogAppendJson(LogBuffer& out, const char* time_fmt, size_t len, LogLevel::Level level, const LogEvent& event);
+
+/**
+ * @brief 返回流绑定的日志事件, 不是日志宏的流时返回nullptr
+ */
+LogEvent* LogStreamEvent(std::ostream& os);
+
+/**
+ * @brief 在流式日志中附加结构化字段
+ * @details SYLAR_LOG_INFO(g_logger) << "login" << sylar::LogField("uid", uid);
+ *          写入其他流时输出" key=value"
+ */
+template <class T>
+struct LogField {
+    LogField(std::string_view k, const T& v) : key(k), value(v) {}
+
+    std::string_view key;
+    const T& value;
+};
+
+template <class T>
+std::ostream& operator<<(std::ostream& os, const LogField<T>& field) {
+    LogEvent* event = LogStreamEvent(os);
+    if (event) {
+        event->addField(field.key, field.value);
+    } else {
+        os << ' ' << field.key << '=' << field.value;
+    }
+    return os;
+}
+
+class LogStream;
+
 /**
  * @brief 日志事件包装器
+ * @details 事件存放在包装器内(栈上), 析构时输出;
+ *          getSS()返回线程复用的输出流, 直接写入事件的缓冲区
  */
 class LogEventWrap {
 public:
-    LogEventWrap(LogEvent::ptr event);
+    LogEventWrap(const char* file, int32_t line, uint32_t elapse,
+                 uint32_t thread_id, const char* thread_name,
+                 uint32_t fiber_id, uint64_t time,
+                 Logger* logger, LogLevel::Level level);
     ~LogEventWrap();
 
-    LogEvent::ptr getEvent() const { return m_event; }
-    std::stringstream& getSS();
+    /**
+     * @brief 返回不拥有所有权的事件指针, 只在包装器存活期间有效
+     */
+    LogEvent::ptr getEvent() { return LogEvent::ptr(LogEvent::ptr(), &m_event); }
+    std::ostream& getSS();
+
+private:
+    LogEventWrap(const LogEventWrap&) = delete;
+    LogEventWrap& operator=(const LogEventWrap&) = delete;
 
 private:
-    LogEvent::ptr m_event;
+    LogEvent m_event;
+    LogStream* m_stream = nullptr;  // 绑定到m_event的输出流
+    bool m_own_stream = false;      // 线程复用的流被占用(嵌套日志)时自行创建
 };
 
-// 日志格式器
+/**
+ * @brief 默认日志格式模板
+ */
+#define SYLAR_LOG_DEFAULT_PATTERN "%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T<%f:%l>%T%m%n"
+
+/**
+ * @brief 每行一个JSON对象的日志格式模板
+ */
+#define SYLAR_LOG_JSON_PATTERN "%J%n"
+
+/**
+ * @brief 日志格式器
+ * @details 模板在构造时编译为扁平的操作码程序, 格式化时顺序执行;
+ *          模板与编译期展开的常用模板(见log_pattern.h)相同时直接调用特化的格式化函数
+ */
 class LogFormatter {
 public:
     typedef std::shared_ptr<LogFormatter> ptr;
+    typedef void (*CompiledFormat)(LogBuffer& out, LogLevel::Level level, const LogEvent& event);
+
+    /**
+     * @brief 操作码
+     */
+    enum OpCode : uint8_t {
+        OP_STRING = 0,     // 纯文本
+        OP_MESSAGE,        // %m 消息
+        OP_LEVEL,          // %p 日志级别
+        OP_ELAPSE,         // %r 累计毫秒数
+        OP_NAME,           // %c 日志名称
+        OP_THREAD_ID,      // %t 线程id
+        OP_THREAD_NAME,    // %N 线程名称
+        OP_FIBER_ID,       // %F 协程id
+        OP_TIME,           // %d 时间
+        OP_FILENAME,       // %f 文件名
+        OP_LINE,           // %l 行号
+        OP_NEWLINE,        // %n 换行
+        OP_TAB,            // %T Tab
+        OP_JSON,           // %J 整个事件输出为JSON对象
+        OP_FORMAT_ERROR,   // 未知的格式项
+        OP_PATTERN_ERROR,  // 模板解析错误
+    };
+
+    /**
+     * @brief 一条指令, 操作数为m_operands中以'\0'结尾的一段
+     */
+    struct Op {
+        OpCode code;
+        uint32_t offset;  // 操作数偏移
+        uint32_t len;     // 操作数长度
+    };
 
     LogFormatter(const std::string& pattern);
-    std::string format(LogLevel::Level level, LogEvent::ptr event);
 
-public:
-    class FormatItem {
-    public:
-        typedef std::shared_ptr<FormatItem> ptr;
+    std::string format(LogLevel::Level level, LogEvent::ptr event);
 
-        virtual ~FormatItem() {}
-        virtual void format(std::ostream& os, LogLevel::Level level, LogEvent::ptr event) = 0;
-    };
+    /**
+     * @brief 格式化追加到调用方提供的缓冲区
+     */
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& event) const;
 
-    void init();  // pattern解析
+    void init();  // pattern编译
 
     bool isError() const { return m_error; }
     const std::string getPattern() const { return m_pattern; }
 
+    /**
+     * @brief 是否使用编译期展开的格式化函数
+     */
+    bool isCompiled() const { return m_compiled != nullptr; }
+
 private:
-    std::string m_pattern;                 // 日志格式模板
-    std::vector<FormatItem::ptr> m_items;  // 日志格式解析后格式
-    bool m_error = false;                  // 是否有错误
+    std::string m_pattern;                // 日志格式模板
+    std::vector<Op> m_program;            // 编译后的指令
+    std::string m_operands;               // 指令的操作数
+    CompiledFormat m_compiled = nullptr;  // 编译期展开的格式化函数
+    bool m_error = false;                 // 是否有错误
 };
 
 // 日志输出地
 class LogAppender {
     friend class Logger;
+    friend class AsyncLogAppender;
 
 public:
     typedef std::shared_ptr<LogAppender> ptr;
@@ -205,7 +889,7 @@ public:
 protected:
     LogLevel::Level m_level = LogLevel::DEBUG;
     bool m_has_formatter = false;
-    LogFormatter::ptr m_formatter;
+    LogFormatter::ptr m_formatter;  // 持有m_mutex时用atomic_store写入, 无锁读取时用atomic_load
 
     MutexType m_mutex;
 };
@@ -219,6 +903,7 @@ public:
     typedef Mutex MutexType;
 
     Logger(const std::string& name = "root");
+    ~Logger();
     void log(LogLevel::Level level, LogEvent::ptr event);
     void debug(LogEvent::ptr event);
     void info(LogEvent::ptr event);
@@ -231,24 +916,53 @@ public:
     void clearAppenders();
 
     const std::string& getName() const { return m_name; }
-    LogLevel::Level getLevel() const { return m_level; }
-    void setLevel(LogLevel::Level level) { m_level = level; }
+    LogLevel::Level getLevel() const { return m_level.load(std::memory_order_relaxed); }
+    void setLevel(LogLevel::Level level);
+
+    /**
+     * @brief 设置每个调用点的限流
+     * @param[in] rate 每秒最多输出的条数, 0表示不限
+     * @param[in] burst 允许的突发条数, 0表示与rate相同
+     */
+    void setRateLimit(uint32_t rate, uint32_t burst = 0);
+    uint32_t getRateLimit() const { return m_rate_limit.load(std::memory_order_relaxed); }
+    uint32_t getBurst() const { return m_burst.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 设置采样比例, 每条日志以sample的概率输出, 1表示全部输出
+     */
+    void setSample(double sample);
+    double getSample() const { return m_sample.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 是否配置了限流或采样
+     */
+    bool isLimited() const { return getRateLimit() || getSample() < 1; }
 
     void setFormatter(LogFormatter::ptr formatter);
     void setFormatter(const std::string& pattern);
-    LogFormatter::ptr getFormatter() const { return m_formatter; }
+    LogFormatter::ptr getFormatter() const { return std::atomic_load(&m_formatter); }
 
     std::string toYamlString();
 
 private:
-    std::string m_name;                       // 日志名称
-    LogLevel::Level m_level;                  // 日志级别
-    std::list<LogAppender::ptr> m_appenders;  // 目标目录列表
-    LogFormatter::ptr m_formatter;            // 日志格式器
+    typedef std::vector<LogAppender::ptr> AppenderList;
+
+    // 持有m_mutex时复制当前列表, 由cb修改后发布, 旧列表延迟回收
+    void updateAppenders(const std::function<void(AppenderList&)>& cb);
+
+private:
+    std::string m_name;                          // 日志名称
+    std::atomic<LogLevel::Level> m_level;        // 日志级别
+    std::atomic<uint32_t> m_rate_limit{0};       // 每个调用点每秒最多输出的条数
+    std::atomic<uint32_t> m_burst{0};            // 每个调用点允许的突发条数
+    std::atomic<double> m_sample{1};             // 采样比例
+    std::atomic<const AppenderList*> m_appenders;  // 目标目录列表, 不可变快照, 读者在RcuReadLock内无锁读取
+    LogFormatter::ptr m_formatter;               // 日志格式器, 持有m_mutex时用atomic_store写入
 
     Logger::ptr m_root;  // 主日志器
 
-    MutexType m_mutex;
+    MutexType m_mutex;  // 只用于串行化写者
 };
 
 // 输出到控制台的Appender
@@ -260,23 +974,314 @@ public:
     std::string toYamlString() override;
 };
 
-// 输出到文件的Appender
+struct LogCompressFile;
+
+/**
+ * @brief 输出到文件的Appender
+ * @details 日志先写入用户态缓冲区, 缓冲区满或距上次写入超过flush_interval时
+ *          用writev一次写入以O_APPEND打开的文件.
+ *          文件大小超过rotate_size或跨过rotate_interval的整点时重命名为
+ *          filename.YYYYmmdd-HHMMSS后重新打开.
+ *          压缩(见CompressMode)由LogCompressor的后台线程完成, 不占用写日志的线程
+ */
 class FileLogAppender : public LogAppender {
 public:
     typedef std::shared_ptr<FileLogAppender> ptr;
 
+    /**
+     * @brief 压缩方式
+     */
+    enum CompressMode {
+        COMPRESS_NONE = 0,    // 不压缩
+        COMPRESS_ROTATE = 1,  // 切分出的文件压缩为filename.YYYYmmdd-HHMMSS.lz, 当前文件为文本
+        COMPRESS_STREAM = 2,  // 每次写入压缩为一个块(见lz.h), 文件为块流,
+                              // rotate_size按压缩前的大小计算
+    };
+
+    static CompressMode CompressModeFromString(const std::string& str);
+    static const char* CompressModeToString(CompressMode mode);
+
     FileLogAppender(const std::string& filename);
+    ~FileLogAppender();
     virtual void log(LogLevel::Level level, LogEvent::ptr event) override;
     std::string toYamlString() override;
 
     // 重新打开文件, 文件打开成功返回true
     bool reopen();
 
+    /**
+     * @brief 将缓冲区写入文件
+     */
+    void flush();
+
+    /**
+     * @brief 锁未被占用时将缓冲区写入文件, 否则直接返回false
+     * @details 供断言失败等不能等待的场景使用, 当前线程自己持有锁时也不会死锁
+     */
+    bool tryFlush();
+
+    /**
+     * @brief 缓冲区自上次写入起超过刷新间隔时写入文件
+     * @details 由后台线程定时调用, 安静的日志器最后几行也会在刷新间隔后落盘.
+     *          Appender正被其他线程使用时不等待, 直接返回
+     * @param[in] now 当前单调时钟(毫秒), 见GetMonotonicMS
+     */
+    void flushExpired(uint64_t now);
+
+    /**
+     * @brief 设置缓冲区大小, 0表示每条日志直接写入
+     */
+    void setBufferSize(size_t v);
+
+    /**
+     * @brief 设置缓冲区最长滞留时间(毫秒)
+     */
+    void setFlushInterval(uint64_t v) { m_flush_interval = v; }
+
+    /**
+     * @brief 设置按大小切分的阈值(字节), 0表示不按大小切分
+     */
+    void setRotateSize(uint64_t v) { m_rotate_size = v; }
+
+    /**
+     * @brief 设置按时间切分的周期(秒), 按本地时间对齐, 0表示不按时间切分
+     */
+    void setRotateInterval(uint64_t v);
+
+    /**
+     * @brief 设置压缩方式, 之后打开的文件生效
+     */
+    void setCompress(CompressMode v);
+
+    size_t getBufferSize() const { return m_buffer_size; }
+    uint64_t getFlushInterval() const { return m_flush_interval; }
+    uint64_t getRotateSize() const { return m_rotate_size; }
+    uint64_t getRotateInterval() const { return m_rotate_interval; }
+    CompressMode getCompress() const { return m_compress; }
+
+    /**
+     * @brief 致命信号处理中写出缓冲区, 再写入msg与调用栈
+     * @details 只调用异步信号安全的函数. 锁被占用(如崩溃线程正在写日志)时不等待,
+     *          直接写出缓冲区中已有的内容. COMPRESS_STREAM方式下缓冲区与msg作为一个未压缩的块写入,
+     *          不写调用栈, 已移交后台线程但未写入的块会丢失. isBinary()的Appender只写出缓冲区
+     */
+    void crashFlush(const char* msg, size_t len, void* const* frames, int depth);
+
+protected:
+    /**
+     * @brief 写入的是否为二进制格式, 崩溃时不向二进制文件写入文本
+     */
+    virtual bool isBinary() const { return false; }
+
+    /**
+     * @brief 将日志编码为写入文件的内容, 默认按格式器输出文本. 持有m_mutex时调用
+     */
+    virtual void encode(LogBuffer& out, LogLevel::Level level, const LogEvent& event);
+
+    /**
+     * @brief 文件打开(包括切分后重新打开)后调用. 持有m_mutex时调用
+     */
+    virtual void onOpen() {}
+
+private:
+    // 以下需持有m_mutex
+    bool openFile();
+    void closeFile();
+    void writeFile(const char* data, size_t len);
+    void rotate(uint64_t now);
+    uint64_t nextRotateTime(uint64_t now) const;
+
 private:
     std::string m_filename;
-    std::ofstream m_filestream;
+    int m_fd = -1;
+    std::string m_buffer;            // 待写入的日志
+    size_t m_buffer_size = 64 * 1024;  // 缓冲区大小
+    std::atomic<uint64_t> m_flush_interval{1000};  // 缓冲区最长滞留时间(毫秒), 后台刷新线程读取
+    uint64_t m_rotate_size = 0;        // 按大小切分的阈值(字节)
+    uint64_t m_rotate_interval = 0;    // 按时间切分的周期(秒)
+    uint64_t m_file_size = 0;          // 当前文件大小
+    uint64_t m_last_flush = 0;         // 上次写入文件的单调时钟(毫秒)
+    uint64_t m_next_rotate = 0;        // 下次按时间切分的时间(秒)
+    CompressMode m_compress = COMPRESS_NONE;     // 压缩方式
+    std::shared_ptr<LogCompressFile> m_stream;   // COMPRESS_STREAM: 交给后台线程写入的文件
+};
+
+/**
+ * @brief 日志压缩的后台线程
+ * @details 按提交顺序执行两类任务: 把切分出的文件压缩为块流(file.lz), 以及
+ *          把FileLogAppender在COMPRESS_STREAM方式下的写入内容压缩为块后写入文件.
+ *          写日志的线程只移交数据, 待写入的数据超过上限时等待后台线程
+ */
+class LogCompressor {
+public:
+    typedef Mutex MutexType;
 
-    uint64_t m_last_time;
+    /**
+     * @brief 全局实例, 首次使用时启动后台线程
+     */
+    static LogCompressor* GetInstance();
+
+    /**
+     * @brief 压缩文件为path.lz后删除原文件
+     */
+    void compressFile(const std::string& path);
+
+    /**
+     * @brief 将data压缩为一个块后追加写入file
+     */
+    void write(std::shared_ptr<LogCompressFile> file, std::string&& data);
+
+    /**
+     * @brief 等待调用前提交的任务全部完成
+     */
+    void flush();
+
+    uint64_t getRawBytes() const { return m_raw_bytes; }    // 压缩前的字节数
+    uint64_t getCompBytes() const { return m_comp_bytes; }  // 压缩后的字节数
+
+private:
+    LogCompressor();
+
+    struct Task {
+        std::string path;                       // 非空时为压缩文件
+        std::shared_ptr<LogCompressFile> file;  // 否则为写入块
+        std::string data;
+    };
+
+    void run();
+    void doCompressFile(const std::string& path);
+    void doWrite(LogCompressFile& file, const std::string& data);
+
+private:
+    std::list<Task> m_tasks;
+    size_t m_pending_bytes = 0;           // 尚未写入的块数据
+    uint64_t m_submitted = 0;             // 已提交的任务数
+    uint64_t m_done = 0;                  // 已完成的任务数
+    std::atomic<uint64_t> m_raw_bytes{0};
+    std::atomic<uint64_t> m_comp_bytes{0};
+    std::shared_ptr<Thread> m_thread;
+    Semaphore m_semaphore;
+    MutexType m_mutex;
+    Condition m_progress;  // 任务完成时通知等待空间或等待完成的提交方
+};
+
+struct LogMmapChunk;
+
+/**
+ * @brief 通过mmap写文件的Appender
+ * @details 文件按chunk_size预先扩展并映射, 写入线程用原子的尾部游标预留空间后直接拷贝,
+ *          不加锁, 由内核负责回写. 进程崩溃时已拷贝的日志在页缓存中, 不会丢失.
+ *          映射区用完时由跨越边界的线程映射下一段, 新映射从它预留的位置开始, 文件内容连续;
+ *          其余越界的线程在m_switched上等待映射完成.
+ *          文件末尾预扩展的部分为零字节: 打开已存在的文件时从最后一个非零字节之后继续写,
+ *          正常析构时截断到实际长度
+ */
+class MmapLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<MmapLogAppender> ptr;
+
+    MmapLogAppender(const std::string& filename, size_t chunk_size = 16 * 1024 * 1024);
+    ~MmapLogAppender();
+    virtual void log(LogLevel::Level level, LogEvent::ptr event) override;
+    std::string toYamlString() override;
+
+    /**
+     * @brief 写入一段已格式化的日志
+     */
+    void write(const char* data, size_t len);
+
+    size_t getChunkSize() const { return m_chunk_size; }
+
+    /**
+     * @brief 映射失败而丢弃的日志条数
+     */
+    uint64_t getDropped() const { return m_dropped; }
+
+private:
+    // 以下需持有m_mutex
+    LogMmapChunk* map(uint64_t offset, size_t reserve);
+    void switchChunk(uint64_t offset, const char* data, size_t len);
+
+private:
+    std::string m_filename;
+    int m_fd = -1;
+    size_t m_chunk_size;                                // 每次映射的大小
+    std::atomic<LogMmapChunk*> m_chunk{nullptr};        // 当前写入的映射
+    std::list<std::unique_ptr<LogMmapChunk>> m_chunks;  // 映射结构, 空闲的在换段时复用
+    std::atomic<uint64_t> m_dropped{0};
+    Condition m_switched;  // 换段后通知, 与m_mutex配合
+};
+
+/**
+ * @brief 在独立队列和线程上运行另一个Appender
+ * @details log()把事件拷贝进有界环形队列后立即返回, 后台线程批量取出交给被包装的Appender,
+ *          慢的输出目标(拥塞的磁盘, 消费慢的管道)不会拖慢共享同一日志器的其他Appender.
+ *          事件可能在调用方栈上, 入队时拷贝并持有日志器. 级别在入队前过滤,
+ *          格式器由后台线程同步给被包装的Appender. 配置中以async: true开启
+ */
+class AsyncLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<AsyncLogAppender> ptr;
+
+    /**
+     * @brief 队列满时的处理策略
+     */
+    enum OverflowPolicy {
+        BLOCK = 0,        // 等待后台线程取出
+        DROP_OLDEST = 1,  // 丢弃队列中最早的事件
+        DROP_NEWEST = 2,  // 丢弃新事件
+    };
+
+    AsyncLogAppender(LogAppender::ptr appender, size_t capacity = 1024, OverflowPolicy policy = BLOCK);
+    ~AsyncLogAppender();
+
+    void log(LogLevel::Level level, LogEvent::ptr event) override;
+    std::string toYamlString() override;
+
+    /**
+     * @brief 等待调用前入队的事件全部输出或被丢弃
+     * @param[in] timeout_ms 最长等待的毫秒数, 默认一直等待
+     * @return 超时或在后台线程上调用时返回false
+     */
+    bool flush(uint64_t timeout_ms = UINT64_MAX);
+
+    LogAppender::ptr getAppender() const { return m_appender; }
+    size_t getCapacity() const { return m_events.size(); }
+    OverflowPolicy getOverflowPolicy() const { return m_policy; }
+
+    uint64_t getPushed() const { return m_pushed; }    // 入队数
+    uint64_t getWritten() const { return m_written; }  // 已输出数
+    uint64_t getDropped() const { return m_dropped; }  // 丢弃数
+    uint64_t getBlocked() const { return m_blocked; }  // 因队列满而等待的次数
+
+    static OverflowPolicy PolicyFromString(const std::string& str);
+    static const char* PolicyToString(OverflowPolicy policy);
+
+private:
+    void run();
+    // 唤醒后台线程, 持有m_queue_mutex时调用
+    bool takeSleeping();
+
+private:
+    LogAppender::ptr m_appender;
+    OverflowPolicy m_policy;
+    // 环形队列及其状态, 由m_queue_mutex保护
+    std::vector<LogEvent> m_events;
+    uint64_t m_head = 0;
+    uint64_t m_tail = 0;
+    bool m_sleeping = false;  // 后台线程在等待信号量
+    bool m_stopping = false;
+
+    std::atomic<uint64_t> m_pushed{0};
+    std::atomic<uint64_t> m_done{0};  // 已输出与因DROP_OLDEST丢弃的入队事件
+    std::atomic<uint64_t> m_written{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_blocked{0};
+
+    std::shared_ptr<Thread> m_thread;
+    Semaphore m_semaphore;
+    MutexType m_queue_mutex;
+    Condition m_progress;  // 后台线程取出或输出事件后通知, 唤醒等待空位与flush的线程
 };
 
 /**
@@ -287,17 +1292,30 @@ public:
     typedef Mutex MutexType;
 
     LoggerManager();
+    ~LoggerManager();
 
     Logger::ptr getLogger(const std::string& name);
-    Logger::ptr getRoot() { return m_root; }
+
+    /**
+     * @brief 按预先计算的名称哈希查找, hash必须为LogNameHash(name)
+     */
+    Logger::ptr getLogger(uint64_t hash, std::string_view name);
+    const Logger::ptr& getRoot() const { return m_root; }
 
     std::string toYamlString();
 
 private:
-    std::map<std::string, Logger::ptr> m_loggers;
+    struct LoggerTable;
+
+    // 持有m_mutex时创建日志器并发布新的哈希表
+    Logger::ptr create(uint64_t hash, std::string_view name);
+
+private:
+    std::map<std::string, Logger::ptr> m_loggers;  // 持有m_mutex访问
+    std::atomic<const LoggerTable*> m_table;       // 查找用的不可变哈希表, 读者在RcuReadLock内无锁读取
     Logger::ptr m_root;
 
-    MutexType m_mutex;
+    MutexType m_mutex;  // 只用于串行化创建
 };
 
 // 日志器管理类单例模式
@@ -305,4 +1323,116 @@ typedef Singleton<LoggerManager> LoggerMgr;
 
 typedef Singletonptr<LoggerManager> LoggerMgrPtr;
 
+class LogRing;
+
+/**
+ * @brief 异步日志管理器
+ * @details 开启后LogEventWrap析构时把日志事件压入当前线程的无锁环形队列
+ *          (单生产者单消费者), 由后台线程批量取出后交给Logger输出.
+ *          队列满时的处理策略见OverflowPolicy.
+ *          通过配置log.async.enable, log.async.capacity, log.async.overflow控制
+ */
+class AsyncLogManager {
+public:
+    typedef Mutex MutexType;
+
+    /**
+     * @brief 队列满时的处理策略
+     */
+    enum OverflowPolicy {
+        BLOCK = 0,           // 等待后台线程取出
+        DROP = 1,            // 丢弃
+        DROP_LOW_LEVEL = 2,  // 丢弃WARN以下级别, 其余等待
+    };
+
+    AsyncLogManager();
+    ~AsyncLogManager();
+
+    bool isEnabled() const { return m_enabled; }
+    void setEnabled(bool v);
+
+    /**
+     * @brief 设置每个线程的队列容量(向上取整为2的幂), 只影响之后创建队列的线程
+     */
+    void setCapacity(size_t v) { m_capacity = v; }
+    void setOverflowPolicy(OverflowPolicy v) { m_policy = v; }
+
+    /**
+     * @brief 将日志事件压入当前线程的队列
+     * @return 未开启异步或当前为后台线程时返回false, 调用方应同步输出
+     */
+    bool push(const LogEvent& event);
+
+    /**
+     * @brief 等待调用前已入队的日志全部输出
+     * @param[in] timeout_ms 最长等待的毫秒数, 默认一直等待
+     * @return 超时或在后台线程上调用时返回false
+     */
+    bool flush(uint64_t timeout_ms = UINT64_MAX);
+
+    /**
+     * @brief 入队数, 由各队列的生产位置汇总, 生产者不写共享计数
+     */
+    uint64_t getPushed() const;
+    uint64_t getWritten() const { return m_written; }  // 已输出数
+    uint64_t getDropped() const { return m_dropped; }  // 丢弃数
+    uint64_t getBlocked() const { return m_blocked; }  // 因队列满而等待的次数
+
+    static OverflowPolicy PolicyFromString(const std::string& str);
+
+private:
+    // 返回当前线程的队列, 不存在时创建并登记
+    LogRing* getRing();
+    // 取出所有队列中的日志并输出, 返回输出条数
+    size_t drain();
+    // 唤醒后台线程
+    void wakeup();
+    void run();
+
+private:
+    std::atomic<bool> m_enabled{false};
+    std::atomic<bool> m_stopping{false};
+    std::atomic<bool> m_sleeping{false};
+    std::atomic<size_t> m_capacity{1024};
+    std::atomic<OverflowPolicy> m_policy{BLOCK};
+
+    std::atomic<uint64_t> m_written{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_blocked{0};
+    uint64_t m_retired_pushed = 0;  // 已释放队列的入队数, 持有m_mutex时访问
+
+    std::list<std::shared_ptr<LogRing>> m_rings;  // 各线程的队列
+    std::shared_ptr<Thread> m_thread;             // 后台输出线程
+    Semaphore m_semaphore;                        // 后台线程休眠时等待
+
+    mutable MutexType m_mutex;
+    MutexType m_wait_mutex;  // 与m_drained配合, 后台线程每输出一批后通知
+    Condition m_drained;
+};
+
+typedef Singleton<AsyncLogManager> AsyncLogMgr;
+
+/**
+ * @brief 输出所有尚未写出的日志
+ * @details 等待异步队列, 各AsyncLogAppender与压缩线程, 写出各FileLogAppender的缓冲区并刷新标准输出.
+ *          SYLAR_ASSERT在abort前调用, 只尽力输出: 跳过调用方所在的后台线程, 每个队列最多等待1秒,
+ *          锁被占用的FileLogAppender(包括调用方自己持有的)不写出; 不能在信号处理函数中调用
+ */
+void LogFlushAll();
+
+/**
+ * @brief 安装SIGSEGV, SIGABRT, SIGBUS的处理函数
+ * @details 收到信号时把各FileLogAppender缓冲区中已格式化的日志写入文件,
+ *          再向文件和标准错误写入信号信息与崩溃线程的调用栈, 之后恢复原处理方式并重新发送信号.
+ *          只使用异步信号安全的函数: 异步队列中尚未格式化的日志与标准输出的缓冲不处理.
+ *          为当前线程设置备用信号栈, 栈溢出时也能执行.
+ *          默认不安装, 由应用调用或通过配置log.crash_handler: true开启
+ */
+void InstallLogCrashHandler();
+
+/**
+ * @brief 恢复安装前的信号处理方式
+ */
+void UninstallLogCrashHandler();
+
 }  // namespace sylar
@@ -0,0 +1,431 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Sylar-Server
+//
+// log_binary.cpp
+//
+// Identification: src/log_binary.cpp
+//
+// Copyright (c) 2022, pyc
+//
+//===----------------------------------------------------------------------===//
+
+#include "log_binary.h"
+
+#include <string.h>
+
+#include <sstream>
+
+#include "config.h"
+#include "log_pattern.h"
+
+namespace sylar {
+
+/**
+ * @brief 已登记的二进制日志调用点
+ */
+struct LogBinRegistry {
+    Mutex mutex;
+    std::vector<LogBinSite*> sites;
+};
+
+static LogBinRegistry& GetLogBinRegistry() {
+    static LogBinRegistry s_registry;
+    return s_registry;
+}
+
+uint32_t LogBinSite::Register(LogBinSite* site, const char* types) {
+    LogBinRegistry& registry = GetLogBinRegistry();
+    Mutex::Lock lock(registry.mutex);
+
+    uint32_t v = site->id.load(std::memory_order_relaxed);
+    if (v) {
+        return v;
+    }
+    site->types = types;
+    registry.sites.push_back(site);
+    v = registry.sites.size();
+    site->id.store(v, std::memory_order_release);
+    return v;
+}
+
+template <class T>
+static bool ReadArg(const char*& cur, const char* end, T& v) {
+    if (cur + sizeof(v) > end) {
+        return false;
+    }
+    memcpy(&v, cur, sizeof(v));
+    cur += sizeof(v);
+    return true;
+}
+
+// 用单个参数执行一个printf转换说明
+template <class T>
+static void AppendSpec(LogBuffer& out, const char* spec, T value) {
+    char buf[128];
+    int len = snprintf(buf, sizeof(buf), spec, value);
+    if (len < 0) {
+        return;
+    }
+    if ((size_t)len < sizeof(buf)) {
+        out.append(buf, len);
+        return;
+    }
+    std::string tmp(len + 1, '\0');
+    snprintf(&tmp[0], len + 1, spec, value);
+    out.append(tmp.data(), len);
+}
+
+void LogBinRender(LogBuffer& out, const char* fmt, const char* types, const char* args, size_t len) {
+    const char* cur = args;
+    const char* end = args + len;
+    const char* p = fmt;
+    while (*p) {
+        if (*p != '%') {
+            const char* next = strchr(p, '%');
+            size_t n = next ? (size_t)(next - p) : strlen(p);
+            out.append(p, n);
+            p += n;
+            continue;
+        }
+        if (p[1] == '%') {
+            out.append('%');
+            p += 2;
+            continue;
+        }
+
+        // %[flags][width][.precision][length]conversion
+        const char* begin = p++;
+        while (*p && strchr("-+ #0", *p)) {
+            ++p;
+        }
+        while (*p && ((*p >= '0' && *p <= '9') || *p == '.')) {
+            ++p;
+        }
+        size_t prefix = p - begin;
+        // 长度修饰符按实际参数类型重写
+        while (*p && strchr("hlLqjzt", *p)) {
+            ++p;
+        }
+        char conv = *p;
+        if (!conv) {
+            out.append(begin, p - begin);
+            break;
+        }
+        ++p;
+        char type = *types;
+        if (!type || prefix > 24) {
+            // 参数不足或无法处理的转换说明原样输出
+            out.append(begin, p - begin);
+            continue;
+        }
+        ++types;
+
+        int64_t ival = 0;
+        double dval = 0;
+        std::string sval;
+        bool ok = true;
+        switch (type) {
+#define XX(tag, wire, dst)                 \
+    case tag: {                            \
+        wire w;                            \
+        ok = ReadArg(cur, end, w);         \
+        dst = w;                           \
+        break;                             \
+    }
+            XX('i', int32_t, ival);
+            XX('I', int64_t, ival);
+            XX('u', uint32_t, ival);
+            XX('U', uint64_t, ival);
+            XX('c', char, ival);
+            XX('b', uint8_t, ival);
+            XX('p', uint64_t, ival);
+            XX('d', double, dval);
+#undef XX
+            case 's': {
+                uint32_t slen = 0;
+                ok = ReadArg(cur, end, slen) && cur + slen <= end;
+                if (ok) {
+                    sval.assign(cur, slen);
+                    cur += slen;
+                }
+                break;
+            }
+            default:
+                ok = false;
+        }
+        if (!ok) {
+            LogAppendStr(out, "<<bad_args>>");
+            return;
+        }
+
+        // 与printf一致, 32位有符号参数按无符号转换时只取低32位
+        uint64_t uval = type == 'i' ? (uint32_t)ival : (uint64_t)ival;
+        // 没有标志, 宽度与精度的整数转换(最常见)用to_chars, 不经过snprintf
+        if (prefix == 1 && type != 'd' && strchr("diuoxX", conv)) {
+            bool is_signed = conv == 'd' || conv == 'i';
+            bool negative = is_signed && ival < 0;
+            uint64_t v = is_signed ? (negative ? -(uint64_t)ival : (uint64_t)ival) : uval;
+            LogAppendInt(out, v, negative, conv == 'o' ? 8 : conv == 'x' || conv == 'X' ? 16 : 10, conv == 'X');
+            continue;
+        }
+
+        char spec[32];
+        memcpy(spec, begin, prefix);
+        char* s = spec + prefix;
+        switch (conv) {
+            case 'd':
+            case 'i':
+                memcpy(s, "lld", 4);
+                AppendSpec(out, spec, type == 'd' ? (long long)dval : (long long)ival);
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                s[0] = 'l';
+                s[1] = 'l';
+                s[2] = conv;
+                s[3] = '\0';
+                AppendSpec(out, spec, type == 'd' ? (unsigned long long)dval : (unsigned long long)uval);
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                s[0] = conv;
+                s[1] = '\0';
+                AppendSpec(out, spec, type == 'd' ? dval : (double)ival);
+                break;
+            case 'c':
+                memcpy(s, "c", 2);
+                AppendSpec(out, spec, (int)ival);
+                break;
+            case 'p':
+                memcpy(s, "p", 2);
+                AppendSpec(out, spec, (void*)(uintptr_t)ival);
+                break;
+            case 's':
+                memcpy(s, "s", 2);
+                if (type == 's') {
+                    AppendSpec(out, spec, sval.c_str());
+                } else if (type == 'd') {
+                    AppendSpec(out, "%g", dval);
+                } else {
+                    AppendSpec(out, "%lld", (long long)ival);
+                }
+                break;
+            default:
+                out.append(begin, p - begin);
+        }
+    }
+}
+
+template <class T>
+static void Put(LogBuffer& out, T v) {
+    out.append((const char*)&v, sizeof(v));
+}
+
+BinaryLogAppender::BinaryLogAppender(const std::string& filename)
+    : FileLogAppender(filename) {
+}
+
+void BinaryLogAppender::onOpen() {
+    m_sites.clear();
+    m_strings.clear();
+    m_next_string_id = 1;
+}
+
+uint32_t BinaryLogAppender::stringId(LogBuffer& out, const void* key, std::string_view str) {
+    auto it = m_strings.find(key);
+    if (it != m_strings.end() && it->second.second == str) {
+        return it->second.first;
+    }
+    // 同一地址的字符串已变化(如日志器被释放后地址复用)时也使用新的id, id不重复使用
+    uint32_t id = m_next_string_id++;
+    if (it != m_strings.end()) {
+        m_strings.erase(it);
+    }
+    m_strings.emplace(key, std::make_pair(id, std::string(str)));
+
+    Put<uint8_t>(out, LOG_BIN_STRING);
+    Put<uint32_t>(out, id);
+    Put<uint32_t>(out, str.size());
+    out.append(str.data(), str.size());
+    return id;
+}
+
+void BinaryLogAppender::encode(LogBuffer& out, LogLevel::Level level, const LogEvent& event) {
+    const LogBinSite* site = event.getBinSite();
+    uint32_t site_id = 0;
+    uint32_t file_id = 0;
+    if (site) {
+        site_id = site->id;
+        if (m_sites.size() <= site_id) {
+            m_sites.resize(site_id + 1);
+        }
+        if (!m_sites[site_id]) {
+            m_sites[site_id] = true;
+            uint16_t file_len = strlen(site->file);
+            uint16_t fmt_len = strlen(site->fmt);
+            uint16_t types_len = strlen(site->types);
+            Put<uint8_t>(out, LOG_BIN_SITE);
+            Put<uint32_t>(out, site_id);
+            Put<int32_t>(out, site->line);
+            Put<uint16_t>(out, file_len);
+            Put<uint16_t>(out, fmt_len);
+            Put<uint16_t>(out, types_len);
+            out.append(site->file, file_len);
+            out.append(site->fmt, fmt_len);
+            out.append(site->types, types_len);
+        }
+    } else {
+        file_id = stringId(out, event.getFilename(), event.getFilename());
+    }
+    const char* thread_name = event.getThreadName();
+    uint32_t thread_name_id = stringId(out, thread_name, thread_name);
+    uint32_t logger_name_id = stringId(out, event.getLogger(), event.getLogger()->getName());
+
+    if (site) {
+        Put<uint8_t>(out, LOG_BIN_EVENT);
+        Put<uint32_t>(out, site_id);
+    } else {
+        Put<uint8_t>(out, LOG_BIN_TEXT);
+        Put<uint32_t>(out, file_id);
+        Put<int32_t>(out, event.getLine());
+    }
+    const LogBuffer& payload = event.getBuffer();
+    Put<uint8_t>(out, level);
+    Put<uint32_t>(out, event.getThreadId());
+    Put<uint32_t>(out, event.getFiberId());
+    Put<uint32_t>(out, thread_name_id);
+    Put<uint32_t>(out, logger_name_id);
+    Put<uint64_t>(out, event.getTimeUs());
+    Put<uint32_t>(out, payload.size());
+    out.append(payload.data(), payload.size());
+    // 结构化字段已是类型化的二进制编码, 原样写入
+    const LogBuffer& fields = event.getFields();
+    Put<uint32_t>(out, fields.size());
+    out.append(fields.data(), fields.size());
+}
+
+std::string BinaryLogAppender::toYamlString() {
+    YAML::Node node = YAML::Load(FileLogAppender::toYamlString());
+    node["type"] = "BinaryLogAppender";
+    node.remove("formatter");
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+LogBinReader::LogBinReader(const std::string& filename) {
+    m_file = fopen(filename.c_str(), "rb");
+}
+
+LogBinReader::~LogBinReader() {
+    if (m_file) {
+        fclose(m_file);
+    }
+}
+
+bool LogBinReader::read(void* buf, size_t len) {
+    return fread(buf, 1, len, m_file) == len;
+}
+
+bool LogBinReader::readString(std::string& str, size_t len) {
+    str.resize(len);
+    return len == 0 || read(&str[0], len);
+}
+
+bool LogBinReader::next(LogEvent& event) {
+    if (!m_file) {
+        return false;
+    }
+    uint8_t type = 0;
+    while (read(type)) {
+        if (type == LOG_BIN_SITE) {
+            uint32_t id = 0;
+            uint16_t file_len = 0;
+            uint16_t fmt_len = 0;
+            uint16_t types_len = 0;
+            Site site;
+            if (!read(id) || !read(site.line) || !read(file_len) || !read(fmt_len) || !read(types_len) ||
+                !readString(site.file, file_len) || !readString(site.fmt, fmt_len) ||
+                !readString(site.types, types_len)) {
+                break;
+            }
+            m_sites[id] = std::move(site);
+        } else if (type == LOG_BIN_STRING) {
+            uint32_t id = 0;
+            uint32_t len = 0;
+            std::string str;
+            if (!read(id) || !read(len) || !readString(str, len)) {
+                break;
+            }
+            m_strings[id] = std::move(str);
+            m_loggers.erase(id);
+        } else if (type == LOG_BIN_EVENT || type == LOG_BIN_TEXT) {
+            const Site* site = nullptr;
+            const char* file = nullptr;
+            int32_t line = 0;
+            if (type == LOG_BIN_EVENT) {
+                uint32_t site_id = 0;
+                if (!read(site_id)) {
+                    break;
+                }
+                auto it = m_sites.find(site_id);
+                if (it == m_sites.end()) {
+                    break;
+                }
+                site = &it->second;
+                file = site->file.c_str();
+                line = site->line;
+            } else {
+                uint32_t file_id = 0;
+                if (!read(file_id) || !read(line)) {
+                    break;
+                }
+                file = m_strings[file_id].c_str();
+            }
+
+            uint8_t level = 0;
+            uint32_t thread_id = 0;
+            uint32_t fiber_id = 0;
+            uint32_t thread_name_id = 0;
+            uint32_t logger_name_id = 0;
+            uint64_t time_us = 0;
+            uint32_t len = 0;
+            uint32_t fields_len = 0;
+            if (!read(level) || !read(thread_id) || !read(fiber_id) || !read(thread_name_id) ||
+                !read(logger_name_id) || !read(time_us) || !read(len) || !readString(m_payload, len) ||
+                !read(fields_len) || !readString(m_fields, fields_len)) {
+                break;
+            }
+
+            Logger::ptr& logger = m_loggers[logger_name_id];
+            if (!logger) {
+                logger = std::make_shared<Logger>(m_strings[logger_name_id]);
+            }
+            event = LogEvent(file, line, 0, thread_id, m_strings[thread_name_id].c_str(), fiber_id, time_us,
+                             logger.get(), (LogLevel::Level)level);
+            if (site) {
+                LogBinRender(event.getBuffer(), site->fmt.c_str(), site->types.c_str(),
+                             m_payload.data(), m_payload.size());
+            } else {
+                event.getBuffer().append(m_payload.data(), m_payload.size());
+            }
+            event.getFields().append(m_fields.data(), m_fields.size());
+            return true;
+        } else {
+            break;
+        }
+    }
+    m_error = !feof(m_file);
+    return false;
+}
+
+}  // namespace sylar
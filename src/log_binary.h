@@ -0,0 +1,125 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Sylar-Server
+//
+// log_binary.h
+//
+// Identification: src/log_binary.h
+//
+// Copyright (c) 2022, pyc
+//
+// 二进制日志的写入与读取
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <stdio.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "log.h"
+
+namespace sylar {
+
+/**
+ * @brief 二进制日志文件的记录类型
+ * @details 整数按本机字节序写入, 记录格式:
+ *          SITE:   type(1) id(4) line(4) file_len(2) fmt_len(2) types_len(2) file fmt types
+ *          STRING: type(1) id(4) len(4) str
+ *          EVENT:  type(1) site(4) level(1) thread_id(4) fiber_id(4) thread_name(4)
+ *                  logger_name(4) time_us(8) len(4) payload fields_len(4) fields
+ *          TEXT:   type(1) file(4) line(4) level(1) thread_id(4) fiber_id(4) thread_name(4)
+ *                  logger_name(4) time_us(8) len(4) text fields_len(4) fields
+ *          EVENT的payload为编码后的参数, TEXT为已格式化的文本日志;
+ *          fields为LogEvent::addField编码的结构化字段;
+ *          file, thread_name与logger_name为STRING记录的id.
+ *          定义记录总在首次引用它的EVENT之前, 每个文件(包括切分后的文件)自包含
+ */
+enum LogBinRecord : uint8_t {
+    LOG_BIN_SITE = 1,
+    LOG_BIN_STRING = 2,
+    LOG_BIN_EVENT = 3,
+    LOG_BIN_TEXT = 4,
+};
+
+/**
+ * @brief 以二进制格式写文件的Appender
+ * @details 输出与切分复用FileLogAppender, 只替换编码: 每条日志只写调用点id,
+ *          时间戳与参数的原始字节, 不做格式化. 文本日志(SYLAR_LOG_*)按TEXT记录原样写入.
+ *          用log_decode工具按LogFormatter模板还原为文本
+ */
+class BinaryLogAppender : public FileLogAppender {
+public:
+    typedef std::shared_ptr<BinaryLogAppender> ptr;
+
+    BinaryLogAppender(const std::string& filename);
+    std::string toYamlString() override;
+
+protected:
+    void encode(LogBuffer& out, LogLevel::Level level, const LogEvent& event) override;
+    void onOpen() override;
+    bool isBinary() const override { return true; }
+
+private:
+    // 返回字符串的id, 首次出现时先写入STRING记录
+    uint32_t stringId(LogBuffer& out, const void* key, std::string_view str);
+
+private:
+    std::vector<bool> m_sites;  // 已写入当前文件的调用点
+    std::unordered_map<const void*, std::pair<uint32_t, std::string>> m_strings;  // 已写入的字符串
+    uint32_t m_next_string_id = 1;  // 下一个字符串id, 只增不减
+};
+
+/**
+ * @brief 二进制日志文件的读取器
+ */
+class LogBinReader {
+public:
+    LogBinReader(const std::string& filename);
+    ~LogBinReader();
+
+    bool isOpen() const { return m_file != nullptr; }
+
+    /**
+     * @brief 读取下一条日志, 内容已按调用点的fmt渲染为文本
+     * @details event中的文件名, 线程名与日志器在下一次调用前有效
+     * @return 文件结束或格式错误时返回false
+     */
+    bool next(LogEvent& event);
+
+    /**
+     * @brief 是否因格式错误(而非文件结束)停止
+     */
+    bool isError() const { return m_error; }
+
+private:
+    bool read(void* buf, size_t len);
+
+    template <class T>
+    bool read(T& v) {
+        return read(&v, sizeof(v));
+    }
+
+    bool readString(std::string& str, size_t len);
+
+private:
+    struct Site {
+        std::string file;
+        int32_t line = 0;
+        std::string fmt;
+        std::string types;
+    };
+
+    FILE* m_file = nullptr;
+    bool m_error = false;
+    std::unordered_map<uint32_t, Site> m_sites;
+    std::unordered_map<uint32_t, std::string> m_strings;
+    std::unordered_map<uint32_t, Logger::ptr> m_loggers;  // %c按日志器名称输出
+    std::string m_payload;
+    std::string m_fields;
+};
+
+}  // namespace sylar
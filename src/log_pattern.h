@@ -0,0 +1,312 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Sylar-Server
+//
+// log_pattern.h
+//
+// Identification: src/log_pattern.h
+//
+// Copyright (c) 2022, pyc
+//
+// 日志格式模板的解析与编译期展开
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <string.h>
+#include <time.h>
+
+#include <array>
+#include <charconv>
+#include <string_view>
+#include <utility>
+
+#include "log.h"
+
+namespace sylar {
+
+/**
+ * @brief 格式项名称对应的操作码
+ */
+constexpr LogFormatter::OpCode LogOpFromKey(std::string_view key) {
+    if (key.size() != 1) {
+        return LogFormatter::OP_FORMAT_ERROR;
+    }
+    switch (key[0]) {
+        case 'm':
+            return LogFormatter::OP_MESSAGE;
+        case 'p':
+            return LogFormatter::OP_LEVEL;
+        case 'r':
+            return LogFormatter::OP_ELAPSE;
+        case 'c':
+            return LogFormatter::OP_NAME;
+        case 't':
+            return LogFormatter::OP_THREAD_ID;
+        case 'N':
+            return LogFormatter::OP_THREAD_NAME;
+        case 'F':
+            return LogFormatter::OP_FIBER_ID;
+        case 'd':
+            return LogFormatter::OP_TIME;
+        case 'f':
+            return LogFormatter::OP_FILENAME;
+        case 'l':
+            return LogFormatter::OP_LINE;
+        case 'n':
+            return LogFormatter::OP_NEWLINE;
+        case 'T':
+            return LogFormatter::OP_TAB;
+        case 'J':
+            return LogFormatter::OP_JSON;
+        default:
+            return LogFormatter::OP_FORMAT_ERROR;
+    }
+}
+
+/**
+ * @brief 解析日志模板, 运行期与编译期共用
+ * @details %xxx 格式项, %xxx{fmt} 带格式的格式项, %% 百分号, 其余为纯文本.
+ *          按顺序对每一项调用cb(code, arg): 纯文本的arg为文本, %d与%J的arg为时间格式,
+ *          未知格式项的arg为其名称, 解析错误的arg为出错位置之后的模板
+ * @return 模板是否合法
+ */
+template <class Callback>
+constexpr bool ParseLogPattern(std::string_view pattern, Callback&& cb) {
+    auto is_alpha = [](char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); };
+
+    bool ok = true;
+    size_t literal = 0;  // 未输出的纯文本起始位置
+    size_t i = 0;
+    while (i < pattern.size()) {
+        if (pattern[i] != '%') {
+            ++i;
+            continue;
+        }
+        if (literal < i) {
+            cb(LogFormatter::OP_STRING, pattern.substr(literal, i - literal));
+        }
+        if (i + 1 < pattern.size() && pattern[i + 1] == '%') {
+            cb(LogFormatter::OP_STRING, pattern.substr(i + 1, 1));
+            i += 2;
+            literal = i;
+            continue;
+        }
+
+        size_t n = i + 1;
+        while (n < pattern.size() && is_alpha(pattern[n])) {
+            ++n;
+        }
+        std::string_view key = pattern.substr(i + 1, n - i - 1);
+        std::string_view fmt;
+        if (n < pattern.size() && pattern[n] == '{') {
+            size_t end = pattern.find('}', n);
+            if (end == std::string_view::npos) {
+                cb(LogFormatter::OP_PATTERN_ERROR, pattern.substr(i));
+                return false;
+            }
+            fmt = pattern.substr(n + 1, end - n - 1);
+            n = end + 1;
+        }
+
+        LogFormatter::OpCode code = LogOpFromKey(key);
+        if (code == LogFormatter::OP_FORMAT_ERROR) {
+            ok = false;
+            cb(code, key);
+        } else if (code == LogFormatter::OP_TIME || code == LogFormatter::OP_JSON) {
+            cb(code, fmt.empty() ? std::string_view("%Y-%m-%d %H:%M:%S") : fmt);
+        } else {
+            cb(code, std::string_view());
+        }
+        i = n;
+        literal = n;
+    }
+    if (literal < pattern.size()) {
+        cb(LogFormatter::OP_STRING, pattern.substr(literal));
+    }
+    return ok;
+}
+
+inline void LogAppendUInt(LogBuffer& out, uint64_t v) {
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, res.ptr - buf);
+}
+
+inline void LogAppendInt(LogBuffer& out, int64_t v) {
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, res.ptr - buf);
+}
+
+/**
+ * @brief 按进制追加整数的绝对值v, negative为true时前加负号; upper为true时十六进制用大写字母
+ */
+inline void LogAppendInt(LogBuffer& out, uint64_t v, bool negative, int base, bool upper) {
+    char buf[72];
+    char* p = buf;
+    if (negative) {
+        *p++ = '-';
+    }
+    char* end = std::to_chars(p, buf + sizeof(buf), v, base).ptr;
+    if (upper) {
+        for (; p < end; ++p) {
+            if (*p >= 'a') {
+                *p -= 'a' - 'A';
+            }
+        }
+    }
+    out.append(buf, end - buf);
+}
+
+inline void LogAppendStr(LogBuffer& out, const char* str) {
+    out.append(str, strlen(str));
+}
+
+/**
+ * @brief 追加时间
+ * @details fmt为strftime格式, 另支持亚秒: %3f 毫秒, %6f或%f 微秒.
+ *          每个线程缓存最近使用的几种格式按秒渲染的结果, 秒数不变时只拷贝文本并填入亚秒,
+ *          不调用localtime_r与strftime
+ * @param[in] time_us 时间戳, 单位微秒
+ * @param[in] fmt 以'\0'结尾的格式
+ * @param[in] len 格式长度
+ */
+void LogAppendTime(LogBuffer& out, uint64_t time_us, const char* fmt, size_t len);
+
+/**
+ * @brief 执行一条指令
+ * @param[in] arg 以'\0'结尾的操作数
+ * @param[in] len 操作数长度
+ */
+template <LogFormatter::OpCode Code>
+inline void LogFormatOp(LogBuffer& out, const char* arg, size_t len,
+                        LogLevel::Level level, const LogEvent& event) {
+    if constexpr (Code == LogFormatter::OP_STRING) {
+        out.append(arg, len);
+    } else if constexpr (Code == LogFormatter::OP_MESSAGE) {
+        const LogBuffer& content = event.getBuffer();
+        const LogBinSite* site = event.getBinSite();
+        if (site) {
+            LogBinRender(out, site->fmt, site->types, content.data(), content.size());
+        } else {
+            out.append(content.data(), content.size());
+        }
+        if (!event.getFields().empty()) {
+            LogAppendFields(out, event.getFields());
+        }
+    } else if constexpr (Code == LogFormatter::OP_LEVEL) {
+        LogAppendStr(out, LogLevel::ToString(level));
+    } else if constexpr (Code == LogFormatter::OP_ELAPSE) {
+        LogAppendUInt(out, event.getElapse());
+    } else if constexpr (Code == LogFormatter::OP_NAME) {
+        const std::string& name = event.getLogger()->getName();
+        out.append(name.data(), name.size());
+    } else if constexpr (Code == LogFormatter::OP_THREAD_ID) {
+        LogAppendUInt(out, event.getThreadId());
+    } else if constexpr (Code == LogFormatter::OP_THREAD_NAME) {
+        LogAppendStr(out, event.getThreadName());
+    } else if constexpr (Code == LogFormatter::OP_FIBER_ID) {
+        LogAppendUInt(out, event.getFiberId());
+    } else if constexpr (Code == LogFormatter::OP_TIME) {
+        LogAppendTime(out, event.getTimeUs(), arg, len);
+    } else if constexpr (Code == LogFormatter::OP_FILENAME) {
+        LogAppendStr(out, event.getFilename());
+    } else if constexpr (Code == LogFormatter::OP_LINE) {
+        LogAppendInt(out, event.getLine());
+    } else if constexpr (Code == LogFormatter::OP_NEWLINE) {
+        out.append('\n');
+    } else if constexpr (Code == LogFormatter::OP_TAB) {
+        out.append('\t');
+    } else if constexpr (Code == LogFormatter::OP_JSON) {
+        LogAppendJson(out, arg, len, level, event);
+    } else if constexpr (Code == LogFormatter::OP_FORMAT_ERROR) {
+        LogAppendStr(out, "<<error_format %");
+        out.append(arg, len);
+        LogAppendStr(out, ">>");
+    } else {
+        LogAppendStr(out, "<<pattern_error>>");
+    }
+}
+
+/**
+ * @brief 可作为模板参数的日志格式模板
+ */
+template <size_t N>
+struct LogPattern {
+    constexpr LogPattern(const char (&str)[N]) {
+        for (size_t i = 0; i < N; ++i) {
+            data[i] = str[i];
+        }
+    }
+
+    constexpr std::string_view view() const { return std::string_view(data, N - 1); }
+
+    char data[N] = {};
+};
+
+/**
+ * @brief 编译期展开的日志格式器
+ * @details 模板在编译期解析, 每个格式项展开为一次内联调用, 没有虚函数与指令分派.
+ *          模板非法时编译失败.
+ *          StaticLogFormatter<SYLAR_LOG_DEFAULT_PATTERN>::Format(buffer, level, event)
+ */
+template <LogPattern Pattern>
+class StaticLogFormatter {
+public:
+    static void Format(LogBuffer& out, LogLevel::Level level, const LogEvent& event) {
+        FormatImpl(out, level, event, std::make_index_sequence<OpCount()>());
+    }
+
+private:
+    struct StaticOp {
+        LogFormatter::OpCode code = LogFormatter::OP_STRING;
+        size_t offset = 0;
+        size_t len = 0;
+    };
+
+    static constexpr size_t OpCount() {
+        size_t count = 0;
+        ParseLogPattern(Pattern.view(), [&](LogFormatter::OpCode, std::string_view) { ++count; });
+        return count;
+    }
+
+    static constexpr size_t OperandSize() {
+        size_t size = 0;
+        ParseLogPattern(Pattern.view(), [&](LogFormatter::OpCode, std::string_view arg) { size += arg.size() + 1; });
+        return size;
+    }
+
+    struct Program {
+        std::array<StaticOp, OpCount()> ops;
+        std::array<char, OperandSize() + 1> operands;
+        bool ok = false;
+    };
+
+    static constexpr Program Compile() {
+        Program program{};
+        size_t index = 0;
+        size_t offset = 0;
+        program.ok = ParseLogPattern(Pattern.view(), [&](LogFormatter::OpCode code, std::string_view arg) {
+            program.ops[index++] = StaticOp{code, offset, arg.size()};
+            for (char c : arg) {
+                program.operands[offset++] = c;
+            }
+            program.operands[offset++] = '\0';
+        });
+        return program;
+    }
+
+    static constexpr Program s_program = Compile();
+    static_assert(s_program.ok, "invalid log pattern");
+
+    template <size_t... I>
+    static void FormatImpl(LogBuffer& out, LogLevel::Level level, const LogEvent& event, std::index_sequence<I...>) {
+        (LogFormatOp<s_program.ops[I].code>(out, s_program.operands.data() + s_program.ops[I].offset,
+                                            s_program.ops[I].len, level, event),
+         ...);
+    }
+};
+
+}  // namespace sylar
@@ -0,0 +1,248 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Sylar-Server
+//
+// lz.cpp
+//
+// Identification: src/lz.cpp
+//
+// Copyright (c) 2022, pyc
+//
+//===----------------------------------------------------------------------===//
+
+#include "lz.h"
+
+#include <string.h>
+
+#include <vector>
+
+namespace sylar {
+
+static constexpr size_t LZ_MIN_MATCH = 4;
+static constexpr size_t LZ_LAST_LITERALS = 5;  // 末尾至少保留的字面量
+static constexpr size_t LZ_MATCH_LIMIT = 12;   // 距末尾不足此长度时不再查找匹配
+static constexpr size_t LZ_MAX_OFFSET = 65535;
+static constexpr int LZ_HASH_LOG = 12;
+
+static inline uint32_t LzRead32(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t LzHash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_LOG);
+}
+
+// 写入长度字段的扩展字节
+static inline char* LzPutLength(char* op, size_t len) {
+    for (; len >= 255; len -= 255) {
+        *op++ = (char)255;
+    }
+    *op++ = (char)len;
+    return op;
+}
+
+static char* LzPutSequence(char* op, const char* literal, size_t literal_len, size_t offset, size_t match_len) {
+    char* token = op++;
+    uint8_t t = literal_len >= 15 ? 15 << 4 : literal_len << 4;
+    if (literal_len >= 15) {
+        op = LzPutLength(op, literal_len - 15);
+    }
+    memcpy(op, literal, literal_len);
+    op += literal_len;
+    if (match_len) {
+        *op++ = offset & 0xff;
+        *op++ = offset >> 8;
+        size_t ml = match_len - LZ_MIN_MATCH;
+        if (ml >= 15) {
+            t |= 15;
+            op = LzPutLength(op, ml - 15);
+        } else {
+            t |= ml;
+        }
+    }
+    *token = t;
+    return op;
+}
+
+size_t LzCompress(const char* src, size_t len, char* dst) {
+    // 位置从1开始记录, 0表示空槽
+    uint32_t table[1 << LZ_HASH_LOG] = {0};
+    const char* ip = src;
+    const char* anchor = src;
+    const char* end = src + len;
+    char* op = dst;
+
+    if (len >= LZ_MATCH_LIMIT) {
+        const char* limit = end - LZ_MATCH_LIMIT;
+        const char* match_end = end - LZ_LAST_LITERALS;
+        while (ip <= limit) {
+            uint32_t seq = LzRead32(ip);
+            uint32_t& slot = table[LzHash(seq)];
+            uint32_t prev = slot;
+            slot = ip - src + 1;
+            const char* ref = src + prev - 1;
+            if (!prev || ip - ref > (ptrdiff_t)LZ_MAX_OFFSET || LzRead32(ref) != seq) {
+                ++ip;
+                continue;
+            }
+            // 向前扩展匹配
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                --ip;
+                --ref;
+            }
+            const char* p = ip + LZ_MIN_MATCH;
+            const char* q = ref + LZ_MIN_MATCH;
+            while (p < match_end && *p == *q) {
+                ++p;
+                ++q;
+            }
+            op = LzPutSequence(op, anchor, ip - anchor, ip - ref, p - ip);
+            ip = p;
+            anchor = ip;
+            // 匹配内部的位置也登记一个, 提高后续命中率
+            if (ip <= limit) {
+                table[LzHash(LzRead32(ip - 2))] = ip - 2 - src + 1;
+            }
+        }
+    }
+    op = LzPutSequence(op, anchor, end - anchor, 0, 0);
+    return op - dst;
+}
+
+bool LzDecompress(const char* src, size_t len, char* dst, size_t raw_len) {
+    const uint8_t* ip = (const uint8_t*)src;
+    const uint8_t* iend = ip + len;
+    char* op = dst;
+    char* oend = dst + raw_len;
+
+    auto read_length = [&](size_t& v) {
+        uint8_t b;
+        do {
+            if (ip >= iend) {
+                return false;
+            }
+            b = *ip++;
+            v += b;
+        } while (b == 255);
+        return true;
+    };
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t literal_len = token >> 4;
+        if (literal_len == 15 && !read_length(literal_len)) {
+            return false;
+        }
+        if (literal_len > (size_t)(iend - ip) || literal_len > (size_t)(oend - op)) {
+            return false;
+        }
+        memcpy(op, ip, literal_len);
+        ip += literal_len;
+        op += literal_len;
+        if (ip == iend) {
+            // 最后一个序列只有字面量
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t match_len = token & 15;
+        if (match_len == 15 && !read_length(match_len)) {
+            return false;
+        }
+        match_len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(op - dst) || match_len > (size_t)(oend - op)) {
+            return false;
+        }
+        const char* ref = op - offset;
+        if (offset >= match_len) {
+            memcpy(op, ref, match_len);
+            op += match_len;
+        } else {
+            // 重叠的匹配逐字节复制, 得到重复的模式
+            for (size_t i = 0; i < match_len; ++i) {
+                *op++ = *ref++;
+            }
+        }
+    }
+    return op == oend;
+}
+
+static void LzPut32(char* p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+static uint32_t LzGet32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void LzAppendBlock(std::string& out, const char* data, size_t len) {
+    size_t header = out.size();
+    out.resize(header + 12 + LzCompressBound(len));
+    char* p = &out[header];
+    size_t comp_len = LzCompress(data, len, p + 12);
+    if (comp_len >= len) {
+        // 压缩无收益, 保存原始数据
+        comp_len = 0;
+        memcpy(p + 12, data, len);
+    }
+    LzPut32(p, LZ_BLOCK_MAGIC);
+    LzPut32(p + 4, len);
+    LzPut32(p + 8, comp_len);
+    out.resize(header + 12 + (comp_len ? comp_len : len));
+}
+
+bool LzCompressStream(FILE* in, FILE* out, size_t block_size) {
+    std::vector<char> buf(block_size);
+    std::string block;
+    size_t n;
+    while ((n = fread(buf.data(), 1, buf.size(), in)) > 0) {
+        block.clear();
+        LzAppendBlock(block, buf.data(), n);
+        if (fwrite(block.data(), 1, block.size(), out) != block.size()) {
+            return false;
+        }
+    }
+    return !ferror(in);
+}
+
+bool LzDecompressStream(FILE* in, FILE* out) {
+    unsigned char header[12];
+    std::vector<char> data;
+    std::vector<char> raw;
+    size_t n;
+    while ((n = fread(header, 1, sizeof(header), in)) == sizeof(header)) {
+        uint32_t raw_len = LzGet32(header + 4);
+        uint32_t comp_len = LzGet32(header + 8);
+        if (LzGet32(header) != LZ_BLOCK_MAGIC) {
+            return false;
+        }
+        size_t len = comp_len ? comp_len : raw_len;
+        data.resize(len);
+        if (fread(data.data(), 1, len, in) != len) {
+            return false;
+        }
+        const char* p = data.data();
+        if (comp_len) {
+            raw.resize(raw_len);
+            if (!LzDecompress(data.data(), len, raw.data(), raw_len)) {
+                return false;
+            }
+            p = raw.data();
+        }
+        if (fwrite(p, 1, raw_len, out) != raw_len) {
+            return false;
+        }
+    }
+    return n == 0 && !ferror(in);
+}
+
+}  // namespace sylar
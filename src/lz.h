@@ -0,0 +1,76 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Sylar-Server
+//
+// lz.h
+//
+// Identification: src/lz.h
+//
+// Copyright (c) 2022, pyc
+//
+// 无外部依赖的LZ77系快速压缩, 用于日志文件
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+namespace sylar {
+
+/**
+ * @brief 压缩len字节最多需要的输出空间
+ */
+inline size_t LzCompressBound(size_t len) {
+    return len + len / 255 + 16;
+}
+
+/**
+ * @brief 压缩一段数据
+ * @details 格式与LZ4块格式相同: 每个序列为
+ *          token(高4位字面量长度, 低4位匹配长度-4) [扩展字面量长度] 字面量 偏移(2, 小端) [扩展匹配长度],
+ *          长度字段为15时后续每个字节累加, 直到不为255. 最后一个序列只有字面量.
+ *          匹配窗口64KB, 用4字节哈希表查找, 不做惰性匹配
+ * @param[out] dst 至少LzCompressBound(len)字节
+ * @return 压缩后的长度
+ */
+size_t LzCompress(const char* src, size_t len, char* dst);
+
+/**
+ * @brief 解压LzCompress的输出
+ * @details 对输入做边界检查, 损坏的数据不会越界读写
+ * @param[in] raw_len 解压后的长度
+ * @return 输入合法且恰好解压出raw_len字节时返回true
+ */
+bool LzDecompress(const char* src, size_t len, char* dst, size_t raw_len);
+
+/**
+ * @brief 块流的块头魔数
+ * @details 块流由若干块直接拼接而成, 每块: magic(4) raw_len(4) comp_len(4) data,
+ *          整数为小端. comp_len为0表示data为未压缩的原始数据(压缩无收益时).
+ *          块之间互不依赖, 追加写入的文件和拼接的文件仍是合法的块流
+ */
+static constexpr uint32_t LZ_BLOCK_MAGIC = 0x425a4c53;  // "SLZB"
+
+/**
+ * @brief 将一段数据压缩为一个块追加到out
+ */
+void LzAppendBlock(std::string& out, const char* data, size_t len);
+
+/**
+ * @brief 将in的内容压缩为块流写入out
+ * @param[in] block_size 每块的原始大小
+ */
+bool LzCompressStream(FILE* in, FILE* out, size_t block_size = 256 * 1024);
+
+/**
+ * @brief 将块流解压写入out
+ * @return 读写失败或数据损坏时返回false
+ */
+bool LzDecompressStream(FILE* in, FILE* out);
+
+}  // namespace sylar
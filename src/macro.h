@@ -15,6 +15,7 @@
 #include <assert.h>
 #include <string.h>
 
+#include "log.h"
 #include "util.h"
 
 #define SYLAR_ASSERT(x)                                                                \
@@ -22,6 +23,7 @@
         SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ASSERTION: " #x                          \
                                           << "\nbacktrace:\n"                          \
                                           << sylar::BacktraceToString(100, 2, "    "); \
+        sylar::LogFlushAll();                                                          \
         assert(x);                                                                     \
     }
 
@@ -32,5 +34,6 @@
                                           << w                                         \
                                           << "\nbacktrace:\n"                          \
                                           << sylar::BacktraceToString(100, 2, "    "); \
+        sylar::LogFlushAll();                                                          \
         assert(x);                                                                     \
     }
@@ -0,0 +1,224 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Sylar-Server
+//
+// rcu.cpp
+//
+// Identification: src/rcu.cpp
+//
+// Copyright (c) 2022, pyc
+//
+//===----------------------------------------------------------------------===//
+
+#include "rcu.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+#include "thread.h"
+
+namespace sylar {
+
+/**
+ * @brief 每个线程的读者记录
+ * @details epoch为0表示不在读临界区. 记录只追加不释放, 线程退出后可被新线程复用
+ */
+struct RcuReader {
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<bool> in_use{false};
+    RcuReader* next = nullptr;
+};
+
+static std::atomic<uint64_t> s_rcu_epoch{1};
+static std::atomic<RcuReader*> s_rcu_readers{nullptr};
+static std::atomic<size_t> s_rcu_pending{0};  // 尚未回收的旧快照数
+
+static void RcuWakeReclaimer();
+
+static RcuReader* AcquireReader() {
+    for (RcuReader* r = s_rcu_readers.load(std::memory_order_acquire); r; r = r->next) {
+        bool expected = false;
+        if (!r->in_use.load(std::memory_order_relaxed) &&
+            r->in_use.compare_exchange_strong(expected, true)) {
+            return r;
+        }
+    }
+    RcuReader* r = new RcuReader;
+    r->in_use.store(true, std::memory_order_relaxed);
+    RcuReader* head = s_rcu_readers.load(std::memory_order_relaxed);
+    do {
+        r->next = head;
+    } while (!s_rcu_readers.compare_exchange_weak(head, r, std::memory_order_release, std::memory_order_relaxed));
+    return r;
+}
+
+/**
+ * @brief 线程局部的读者状态, 线程退出时归还记录
+ */
+struct RcuThreadState {
+    RcuReader* reader = nullptr;
+    uint32_t depth = 0;
+
+    ~RcuThreadState() {
+        if (reader) {
+            reader->epoch.store(0, std::memory_order_release);
+            reader->in_use.store(false, std::memory_order_release);
+            reader = nullptr;
+        }
+    }
+};
+
+static thread_local RcuThreadState t_rcu_state;
+
+RcuReadLock::RcuReadLock() {
+    RcuThreadState& state = t_rcu_state;
+    if (state.depth++) {
+        return;
+    }
+    if (!state.reader) {
+        state.reader = AcquireReader();
+    }
+    // 读到写者递增后的epoch时必然也能看到新快照(acquire);
+    // 先公布epoch再读取快照指针. 之后调用方的指针读取是acquire, 与epoch的写入之间
+    // 需要StoreLoad屏障, 否则写者扫描时可能看不到本读者而回收它即将读到的快照
+    state.reader->epoch.store(s_rcu_epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+RcuReadLock::~RcuReadLock() {
+    RcuThreadState& state = t_rcu_state;
+    if (--state.depth == 0) {
+        uint64_t epoch = state.reader->epoch.load(std::memory_order_relaxed);
+        state.reader->epoch.store(0, std::memory_order_release);
+        // 进入后有快照退休且尚未回收, 本读者可能正是阻止回收的那个, 唤醒回收线程.
+        // 每个读临界区最多唤醒一次, 没有待回收的快照时只多两次relaxed load
+        if (s_rcu_pending.load(std::memory_order_relaxed) &&
+            epoch < s_rcu_epoch.load(std::memory_order_relaxed)) {
+            RcuWakeReclaimer();
+        }
+    }
+}
+
+struct RcuRetired {
+    uint64_t epoch;
+    std::function<void()> cb;
+};
+
+struct RcuRetireList {
+    Mutex mutex;
+    Condition cond;         // 读者离开时唤醒回收线程
+    bool wakeup = false;    // 持有mutex访问
+    bool started = false;   // 回收线程已启动, 持有mutex访问
+    std::vector<RcuRetired> items;
+};
+
+// 读者离开时的唤醒可能与回收线程的扫描交错而丢失, 有待回收的快照时至少按此周期重试
+static const uint64_t RCU_RECLAIM_PERIOD_MS = 100;
+
+static RcuRetireList& GetRcuRetireList() {
+    // 不析构, 退出阶段析构的对象仍可能回收快照
+    static RcuRetireList* s_list = new RcuRetireList;
+    return *s_list;
+}
+
+// 读临界区内读者的最小epoch, 没有读者时返回UINT64_MAX
+static uint64_t MinReaderEpoch() {
+    uint64_t min = UINT64_MAX;
+    for (RcuReader* r = s_rcu_readers.load(std::memory_order_acquire); r; r = r->next) {
+        uint64_t e = r->epoch.load(std::memory_order_seq_cst);
+        if (e && e < min) {
+            min = e;
+        }
+    }
+    return min;
+}
+
+static void ReclaimLocked(RcuRetireList& list, std::vector<std::function<void()>>& ready) {
+    uint64_t min = MinReaderEpoch();
+    auto it = list.items.begin();
+    while (it != list.items.end()) {
+        if (it->epoch <= min) {
+            ready.emplace_back(std::move(it->cb));
+            it = list.items.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    s_rcu_pending.store(list.items.size(), std::memory_order_relaxed);
+}
+
+static void RcuWakeReclaimer() {
+    RcuRetireList& list = GetRcuRetireList();
+    Mutex::Lock lock(list.mutex);
+    list.wakeup = true;
+    list.cond.notify();
+}
+
+/**
+ * @brief 回收线程
+ * @details 写者退休快照时仍有读者的, 只在下一次RcuRetire时回收; 之后不再有写者时
+ *          (如最后一次配置修改), 由该线程在阻止回收的读者离开后回收,
+ *          被移除的Appender因此能及时关闭文件, 停止后台线程
+ */
+static void RcuReclaimThread() {
+    RcuRetireList& list = GetRcuRetireList();
+    while (true) {
+        {
+            Mutex::Lock lock(list.mutex);
+            while (list.items.empty()) {
+                list.wakeup = false;
+                list.cond.wait(list.mutex);
+            }
+            if (!list.wakeup) {
+                list.cond.waitFor(list.mutex, RCU_RECLAIM_PERIOD_MS);
+            }
+            list.wakeup = false;
+        }
+        RcuReclaim();
+    }
+}
+
+void RcuRetire(std::function<void()> cb) {
+    // 旧快照在此之前已被替换, 之后进入的读者只能看到新快照
+    uint64_t epoch = s_rcu_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    // 与RcuReadLock中的屏障配对: 扫描时要么看到读者的epoch, 要么读者读到新快照
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    std::vector<std::function<void()>> ready;
+    RcuRetireList& list = GetRcuRetireList();
+    bool start = false;
+    {
+        Mutex::Lock lock(list.mutex);
+        list.items.push_back(RcuRetired{epoch, std::move(cb)});
+        ReclaimLocked(list, ready);
+        if (!list.items.empty() && !list.started) {
+            list.started = start = true;
+        }
+        list.cond.notify();
+    }
+    if (start) {
+        // 不析构, 进程退出时该线程仍可能在运行
+        static Thread* s_thread = new Thread(&RcuReclaimThread, "rcu_reclaim");
+        (void)s_thread;
+    }
+    // 回调可能析构Appender等对象, 不在锁内执行
+    for (auto& i : ready) {
+        i();
+    }
+}
+
+void RcuReclaim() {
+    std::vector<std::function<void()>> ready;
+    RcuRetireList& list = GetRcuRetireList();
+    {
+        Mutex::Lock lock(list.mutex);
+        ReclaimLocked(list, ready);
+    }
+    for (auto& i : ready) {
+        i();
+    }
+}
+
+}  // namespace sylar
@@ -0,0 +1,55 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Sylar-Server
+//
+// rcu.h
+//
+// Identification: src/rcu.h
+//
+// Copyright (c) 2022, pyc
+//
+// 基于epoch的延迟回收, 用于读多写少的数据以不可变快照发布
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <functional>
+
+namespace sylar {
+
+/**
+ * @brief 读临界区
+ * @details 读者在临界区内用atomic load取得快照指针并使用, 期间快照不会被释放.
+ *          可嵌套, 只有最外层记录epoch. 不加锁, 进出各一次原子写;
+ *          离开时若有进入后退休的快照待回收, 唤醒回收线程
+ */
+class RcuReadLock {
+public:
+    RcuReadLock();
+    ~RcuReadLock();
+
+private:
+    RcuReadLock(const RcuReadLock&) = delete;
+    RcuReadLock& operator=(const RcuReadLock&) = delete;
+};
+
+/**
+ * @brief 推迟执行cb, 直到调用前进入读临界区的读者全部离开
+ * @details 写者替换快照指针后调用, cb中释放旧快照. 不等待读者:
+ *          每次调用时回收已满足条件的旧快照, 剩余的由后台回收线程在阻止回收的读者离开后回收
+ */
+void RcuRetire(std::function<void()> cb);
+
+template <class T>
+void RcuRetire(const T* ptr) {
+    RcuRetire([ptr]() { delete ptr; });
+}
+
+/**
+ * @brief 回收已满足条件的旧快照
+ * @details 回收线程会自动调用, 需要立即回收时(如测试)可直接调用
+ */
+void RcuReclaim();
+
+}  // namespace sylar
@@ -27,7 +27,7 @@ Scheduler::Scheduler(size_t threads, bool use_caller, const std::string& name)
     SYLAR_ASSERT(threads > 0);
 
     if (use_caller) {
-        sylar::Fiber::GetThis();
+        sylar::Fiber::GetThisRaw();
         threads--;
 
         // 确保之前没有创建协程调度器
@@ -145,7 +145,7 @@ void Scheduler::run() {
     setThis();
     if (sylar::GetThreadId() != m_root_thread_id) {
         // 将主协程置为当前线程上的协程
-        t_fiber = Fiber::GetThis().get();
+        t_fiber = Fiber::GetThisRaw();
     }
 
     Fiber::ptr idle_fiber = std::make_shared<Fiber>(std::bind(&Scheduler::idle, this));
@@ -191,15 +191,13 @@ void Scheduler::run() {
         // 如果ft为fiber类型并且状态不为TERM或EXCEPT, 则执行
         if (ft.fiber && (ft.fiber->getState() != Fiber::TERM && ft.fiber->getState() != Fiber::EXCEPT)) {
             
-            ft.fiber->swapIn();
+            Fiber::State state = ft.fiber->swapIn();
             --m_active_thread_count;
 
             // 切换回来后若状态为READY则继续加入消息队列
-            if (ft.fiber->getState() == Fiber::READY) {
+            // 其余情况swapIn已置为HOLD, 此时协程可能已被其他线程唤醒, 不能再读取或修改其状态
+            if (state == Fiber::READY) {
                 schedule(ft.fiber);
-                // 若状态为INIT, HOLD, EXEC置为HOLD
-            } else if (ft.fiber->getState() != Fiber::TERM && ft.fiber->getState() != Fiber::EXCEPT) {
-                ft.fiber->m_state = Fiber::HOLD;
             }
             // 结束后将ft重置
             ft.reset();
@@ -213,15 +211,14 @@ void Scheduler::run() {
             }
             ft.reset();
 
-            cb_fiber->swapIn();
+            Fiber::State state = cb_fiber->swapIn();
             --m_active_thread_count;
-            if (cb_fiber->getState() == Fiber::READY) {
+            if (state == Fiber::READY) {
                 schedule(cb_fiber);
                 cb_fiber.reset();
-            } else if (cb_fiber->getState() == Fiber::EXCEPT || cb_fiber->getState() == Fiber::TERM) {
+            } else if (state == Fiber::EXCEPT || state == Fiber::TERM) {
                 cb_fiber->reset(nullptr);
-            } else {  // if (cb_fiber->getState() != Fiber::TERM) {
-                cb_fiber->m_state = Fiber::HOLD;
+            } else {  // HOLD
                 cb_fiber.reset();
             }
         } else {
@@ -236,9 +233,6 @@ void Scheduler::run() {
             ++m_idle_thread_count;
             idle_fiber->swapIn();
             --m_idle_thread_count;
-            if (idle_fiber->getState() != Fiber::TERM && idle_fiber->getState() != Fiber::EXCEPT) {
-                idle_fiber->m_state = Fiber::HOLD;
-            }
         }
     }
 }
@@ -17,8 +17,13 @@
 #include "src/config.h"
 #include "src/fiber.h"
 #include "src/log.h"
+#include "src/log_binary.h"
+#include "src/log_pattern.h"
+#include "src/lz.h"
 #include "src/macro.h"
+#include "src/rcu.h"
 #include "src/scheduler.h"
 #include "src/singleton.h"
+#include "src/task.h"
 #include "src/thread.h"
 #include "src/util.h"
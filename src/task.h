@@ -0,0 +1,332 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Sylar-Server
+//
+// task.h
+//
+// Identification: src/task.h
+//
+// Copyright (c) 2022, pyc
+//
+// C++20无栈协程与Scheduler的桥接
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+
+#include "fiber.h"
+#include "macro.h"
+#include "scheduler.h"
+
+namespace sylar {
+
+template <class T = void>
+class Task;
+
+/**
+ * @brief Task协程帧的公共部分
+ * @details 完成时优先对称转移到等待者(continuation), 否则执行完成回调(on_done)
+ */
+class TaskPromiseBase {
+public:
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+
+        template <class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            TaskPromiseBase& promise = handle.promise();
+            if (promise.m_continuation) {
+                return promise.m_continuation;
+            }
+            if (promise.m_on_done) {
+                // 回调可能释放协程帧, 先移出到栈上
+                std::function<void()> on_done;
+                on_done.swap(promise.m_on_done);
+                on_done();
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { m_exception = std::current_exception(); }
+
+    /**
+     * @brief 协程帧分配, 统计当前存活的协程帧字节数
+     */
+    static void* operator new(size_t size) {
+        s_frame_bytes += size;
+        ++s_frame_count;
+        return ::operator new(size);
+    }
+
+    static void operator delete(void* ptr, size_t size) {
+        s_frame_bytes -= size;
+        --s_frame_count;
+        ::operator delete(ptr);
+    }
+
+    /**
+     * @brief 当前存活的协程帧总字节数
+     */
+    static uint64_t TotalFrameBytes() { return s_frame_bytes; }
+
+    /**
+     * @brief 当前存活的协程帧数
+     */
+    static uint64_t TotalFrames() { return s_frame_count; }
+
+protected:
+    void rethrow() {
+        if (m_exception) {
+            std::rethrow_exception(m_exception);
+        }
+    }
+
+public:
+    std::coroutine_handle<> m_continuation;  // 等待该Task的协程
+    std::function<void()> m_on_done;         // 无等待协程时的完成回调
+    std::exception_ptr m_exception;          // 协程体抛出的异常
+
+private:
+    static inline std::atomic<uint64_t> s_frame_bytes{0};
+    static inline std::atomic<uint64_t> s_frame_count{0};
+};
+
+template <class T>
+class TaskPromise : public TaskPromiseBase {
+public:
+    Task<T> get_return_object() noexcept;
+
+    template <class V>
+    void return_value(V&& value) { m_value.emplace(std::forward<V>(value)); }
+
+    T result() {
+        rethrow();
+        return std::move(*m_value);
+    }
+
+private:
+    std::optional<T> m_value;
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase {
+public:
+    Task<void> get_return_object() noexcept;
+
+    void return_void() noexcept {}
+
+    void result() { rethrow(); }
+};
+
+/**
+ * @brief 惰性启动的无栈协程任务
+ * @details 创建后不执行, 直到被co_await, start()或Spawn()调度.
+ *          协程体可以co_await另一个Task, SwitchTo()切换到调度器线程,
+ *          或RunInFiber()在协程(Fiber)中执行阻塞式的原语;
+ *          Fiber中可以通过Await()等待一个Task完成
+ */
+template <class T>
+class Task {
+public:
+    typedef TaskPromise<T> promise_type;
+    typedef std::coroutine_handle<promise_type> handle_type;
+
+    Task() = default;
+    explicit Task(handle_type handle) : m_handle(handle) {}
+
+    Task(Task&& oth) noexcept : m_handle(std::exchange(oth.m_handle, nullptr)) {}
+
+    Task& operator=(Task&& oth) noexcept {
+        if (this != &oth) {
+            destroy();
+            m_handle = std::exchange(oth.m_handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task() { destroy(); }
+
+    /**
+     * @brief 是否已执行完成
+     */
+    bool done() const { return !m_handle || m_handle.done(); }
+
+    /**
+     * @brief 在当前线程开始执行, 完成时调用on_done
+     * @details 调用者需保证Task在完成前存活
+     */
+    void start(std::function<void()> on_done = nullptr) {
+        SYLAR_ASSERT(m_handle && !m_handle.done());
+        m_handle.promise().m_on_done = std::move(on_done);
+        m_handle.resume();
+    }
+
+    /**
+     * @brief 获取结果, 协程体抛出的异常在此重新抛出
+     */
+    T result() { return m_handle.promise().result(); }
+
+    struct Awaiter {
+        handle_type handle;
+
+        bool await_ready() const noexcept { return !handle || handle.done(); }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            handle.promise().m_continuation = awaiting;
+            return handle;
+        }
+
+        T await_resume() { return handle.promise().result(); }
+    };
+
+    Awaiter operator co_await() const& noexcept { return Awaiter{m_handle}; }
+
+    /**
+     * @brief 释放协程帧的所有权
+     */
+    handle_type release() { return std::exchange(m_handle, nullptr); }
+
+private:
+    void destroy() {
+        if (m_handle) {
+            m_handle.destroy();
+            m_handle = nullptr;
+        }
+    }
+
+private:
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+private:
+    handle_type m_handle;
+};
+
+template <class T>
+inline Task<T> TaskPromise<T>::get_return_object() noexcept {
+    return Task<T>(Task<T>::handle_type::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+    return Task<void>(Task<void>::handle_type::from_promise(*this));
+}
+
+/**
+ * @brief co_await SwitchTo(sc) 将协程切换到调度器sc的工作线程上继续执行
+ */
+struct SwitchTo {
+    Scheduler* scheduler;
+
+    explicit SwitchTo(Scheduler* sc) : scheduler(sc) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        scheduler->schedule([handle]() { handle.resume(); });
+    }
+
+    void await_resume() const noexcept {}
+};
+
+/**
+ * @brief co_await RunInFiber(sc, func) 在调度器sc的协程中执行func
+ * @details func运行在Fiber上, 可以使用YieldToHold等基于协程的原语,
+ *          执行完成后Task在sc上恢复并得到func的返回值
+ */
+template <class Func>
+class RunInFiber {
+public:
+    typedef std::invoke_result_t<Func> result_type;
+
+    RunInFiber(Scheduler* sc, Func func) : m_scheduler(sc), m_func(std::move(func)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        m_scheduler->schedule([this, handle]() {
+            try {
+                if constexpr (std::is_void_v<result_type>) {
+                    m_func();
+                } else {
+                    m_value.emplace(m_func());
+                }
+            } catch (...) {
+                m_exception = std::current_exception();
+            }
+            // 不在当前Fiber上直接恢复, 让该Fiber尽快结束并被复用
+            m_scheduler->schedule([handle]() { handle.resume(); });
+        });
+    }
+
+    result_type await_resume() {
+        if (m_exception) {
+            std::rethrow_exception(m_exception);
+        }
+        if constexpr (!std::is_void_v<result_type>) {
+            return std::move(*m_value);
+        }
+    }
+
+private:
+    typedef std::conditional_t<std::is_void_v<result_type>, char, result_type> value_type;
+
+    Scheduler* m_scheduler;
+    Func m_func;
+    std::optional<value_type> m_value;
+    std::exception_ptr m_exception;
+};
+
+/**
+ * @brief 在调度器sc上启动Task, 不等待其完成
+ * @details Task的协程帧在完成后自动释放.
+ *          没有等待者取结果, 协程体抛出的异常在释放前输出到system日志, 同Fiber::MainFunc
+ */
+inline void Spawn(Scheduler* sc, Task<void> task) {
+    auto handle = task.release();
+    sc->schedule([handle]() {
+        handle.promise().m_on_done = [handle]() {
+            if (handle.promise().m_exception) {
+                try {
+                    std::rethrow_exception(handle.promise().m_exception);
+                } catch (const std::exception& e) {
+                    SYLAR_LOG_ERROR(SYLAR_LOG_NAME("system")) << "Task Except: " << e.what()
+                                                              << std::endl
+                                                              << sylar::BacktraceToString();
+                } catch (...) {
+                    SYLAR_LOG_ERROR(SYLAR_LOG_NAME("system")) << "Task Except";
+                }
+            }
+            handle.destroy();
+        };
+        handle.resume();
+    });
+}
+
+/**
+ * @brief 在当前Fiber中等待Task完成并返回结果
+ * @details Task在当前线程开始执行, 挂起期间当前Fiber让出(HOLD),
+ *          Task完成后当前Fiber被重新加入调度器
+ */
+template <class T>
+T Await(Task<T> task) {
+    Scheduler* sc = Scheduler::GetThis();
+    SYLAR_ASSERT2(sc, "Await must be called in a scheduler fiber");
+    Fiber::ptr fiber = Fiber::GetThis();
+    task.start([sc, fiber]() { sc->schedule(fiber); });
+    Fiber::YieldToHold();
+    return task.result();
+}
+
+}  // namespace sylar
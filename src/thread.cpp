@@ -12,12 +12,18 @@
 
 #include "thread.h"
 
+#include <errno.h>
+#include <time.h>
+
+#include <unordered_set>
+
 #include "log.h"
 
 namespace sylar {
 
 static thread_local Thread* t_thread = nullptr;
 static thread_local std::string t_thread_name = "UNKNOWN";
+static thread_local const char* t_thread_name_interned = "UNKNOWN";
 
 static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
@@ -32,8 +38,11 @@ Semaphore::~Semaphore() {
 }
 
 void Semaphore::wait() {
-    if (sem_wait(&m_semaphore)) {
-        throw std::logic_error("sem_wait error");
+    // 被信号中断时继续等待
+    while (sem_wait(&m_semaphore)) {
+        if (errno != EINTR) {
+            throw std::logic_error("sem_wait error");
+        }
     }
 }
 
@@ -43,6 +52,53 @@ void Semaphore::notify() {
     }
 }
 
+Condition::Condition() {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if (pthread_cond_init(&m_cond, &attr)) {
+        pthread_condattr_destroy(&attr);
+        throw std::logic_error("pthread_cond_init error");
+    }
+    pthread_condattr_destroy(&attr);
+}
+
+Condition::~Condition() {
+    pthread_cond_destroy(&m_cond);
+}
+
+void Condition::wait(Mutex& mutex) {
+    pthread_cond_wait(&m_cond, &mutex.m_mutex);
+}
+
+bool Condition::waitFor(Mutex& mutex, uint64_t timeout_ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (timeout_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ++ts.tv_sec;
+        ts.tv_nsec -= 1000000000;
+    }
+    return pthread_cond_timedwait(&m_cond, &mutex.m_mutex, &ts) != ETIMEDOUT;
+}
+
+void Condition::notify() {
+    pthread_cond_signal(&m_cond);
+}
+
+void Condition::notifyAll() {
+    pthread_cond_broadcast(&m_cond);
+}
+
+// 线程名驻留, 相同的名称共享同一份字符串, 返回的指针在进程生命周期内有效
+static const char* InternThreadName(const std::string& name) {
+    static Mutex s_mutex;
+    static std::unordered_set<std::string> s_names;
+    Mutex::Lock lock(s_mutex);
+    return s_names.insert(name).first->c_str();
+}
+
 Thread* Thread::GetThis() {
     return t_thread;
 }
@@ -51,6 +107,10 @@ const std::string& Thread::GetName() {
     return t_thread_name;
 }
 
+const char* Thread::GetInternedName() {
+    return t_thread_name_interned;
+}
+
 void Thread::SetName(const std::string& name) {
     if (name.empty()) {
         return;
@@ -59,6 +119,7 @@ void Thread::SetName(const std::string& name) {
         t_thread->m_name = name;
     }
     t_thread_name = name;
+    t_thread_name_interned = InternThreadName(name);
 }
 
 Thread::Thread(std::function<void()> cb, const std::string& name) : m_cb(cb), m_name(name) {
@@ -94,6 +155,7 @@ void* Thread::run(void* arg) {
     Thread* thread = (Thread*)arg;
     t_thread = thread;
     t_thread_name = thread->m_name;
+    t_thread_name_interned = InternThreadName(thread->m_name);
     thread->m_id = sylar::GetThreadId();
     pthread_setname_np(pthread_self(), thread->m_name.substr(0, 15).c_str());
 
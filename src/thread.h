@@ -156,10 +156,47 @@ public:
         pthread_mutex_unlock(&m_mutex);
     }
 
+    /**
+     * @brief 尝试加锁, 不等待
+     * @return 加锁成功返回true
+     */
+    bool tryLock() {
+        return pthread_mutex_trylock(&m_mutex) == 0;
+    }
+
 private:
+    friend class Condition;
     pthread_mutex_t m_mutex;
 };
 
+/**
+ * @brief 条件变量, 与Mutex配合使用
+ * @details 等待前持有mutex并检查条件, 返回时重新持有mutex; 可能虚假唤醒, 应在循环中等待
+ */
+class Condition {
+public:
+    Condition();
+    ~Condition();
+
+    void wait(Mutex& mutex);
+
+    /**
+     * @brief 最多等待timeout_ms毫秒(单调时钟)
+     * @return 超时返回false
+     */
+    bool waitFor(Mutex& mutex, uint64_t timeout_ms);
+
+    void notify();
+    void notifyAll();
+
+private:
+    Condition(const Condition&) = delete;
+    Condition& operator=(const Condition&) = delete;
+
+private:
+    pthread_cond_t m_cond;
+};
+
 /**
  * @brief 空锁, for debug
  *
@@ -277,6 +314,11 @@ public:
 
     static Thread* GetThis();
     static const std::string& GetName();
+
+    /**
+     * @brief 当前线程名称的驻留字符串, 在进程生命周期内有效, 日志事件直接引用而不拷贝
+     */
+    static const char* GetInternedName();
     static void SetName(const std::string& name);
 
 private:
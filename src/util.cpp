@@ -13,12 +13,21 @@
 #include "util.h"
 
 #include <execinfo.h>
+#include <time.h>
 #include <stdint.h>
+#include <sys/time.h>
 #include <syscall.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <sstream>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
 #include "fiber.h"
 #include "log.h"
 
@@ -66,4 +75,222 @@ std::string BacktraceToString(int size, int skip, const std::string& prefix) {
     return ss.str();
 }
 
+uint64_t GetCurrentMS() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000ul + tv.tv_usec / 1000;
+}
+
+uint64_t GetCurrentUS() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000ul + tv.tv_usec;
+}
+
+static uint64_t ClockNS(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+static const uint64_t CLOCK_FIRST_CALIBRATE_NS = 10 * 1000 * 1000;
+static const uint64_t CLOCK_CALIBRATE_NS = 1000 * 1000 * 1000;
+
+/**
+ * @brief TSC换算参数
+ * @details ns = base_ns + (tsc - base_tsc) * mult >> 32, 在tsc - base_tsc < limit时有效
+ */
+struct ClockParams {
+    uint64_t base_tsc = 0;
+    uint64_t base_ns = 0;
+    uint64_t mult = 0;           // 每个TSC周期的纳秒数, 32位定点小数
+    uint64_t limit = 0;          // 0表示无效
+    int64_t wall_offset_ns = 0;  // CLOCK_REALTIME与单调时间的差
+};
+
+// 每个线程缓存一份换算参数, 快路径只读TSC与线程局部变量
+static thread_local ClockParams t_clock_params;
+static thread_local uint64_t t_clock_last = 0;
+
+/**
+ * @brief 单调时钟的状态
+ * @details 换算参数以seqlock发布: 写者把seq改为奇数, 写入参数后改为偶数;
+ *          读者在seq为偶数且前后不变时使用读到的参数
+ */
+struct MonotonicClock {
+    bool tsc = false;        // 是否使用TSC
+    uint64_t start_tsc = 0;  // 首次使用时的TSC与单调时间, 作为校准的基线
+    uint64_t start_ns = 0;
+
+    std::atomic<uint32_t> seq{0};
+    std::atomic<uint64_t> base_tsc{0};
+    std::atomic<uint64_t> base_ns{0};
+    std::atomic<uint64_t> mult{0};
+    std::atomic<uint64_t> limit{0};
+    std::atomic<int64_t> wall_offset_ns{0};
+    std::atomic<bool> calibrating{false};
+
+    MonotonicClock() {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int eax, ebx, ecx, edx;
+        // CPUID.80000007H:EDX[8] 不变TSC, 频率恒定且在各核心间同步
+        tsc = __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8));
+        start_tsc = tsc ? __rdtsc() : 0;
+#endif
+        start_ns = ClockNS(CLOCK_MONOTONIC);
+        wall_offset_ns = (int64_t)(ClockNS(CLOCK_REALTIME) - start_ns);
+    }
+
+    ClockParams load() const {
+        ClockParams params;
+        uint32_t s;
+        do {
+            s = seq.load(std::memory_order_acquire);
+            params.base_tsc = base_tsc.load(std::memory_order_relaxed);
+            params.base_ns = base_ns.load(std::memory_order_relaxed);
+            params.mult = mult.load(std::memory_order_relaxed);
+            params.limit = limit.load(std::memory_order_relaxed);
+            params.wall_offset_ns = wall_offset_ns.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((s & 1) || s != seq.load(std::memory_order_relaxed));
+        return params;
+    }
+
+    // 用clock_gettime读取时间, 到期时重新计算换算参数
+    uint64_t calibrate() {
+        uint64_t ns = ClockNS(CLOCK_MONOTONIC);
+        if (!tsc) {
+            wall_offset_ns.store((int64_t)(ClockNS(CLOCK_REALTIME) - ns), std::memory_order_relaxed);
+            return ns;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        if (ns - start_ns < CLOCK_FIRST_CALIBRATE_NS || calibrating.exchange(true)) {
+            return ns;
+        }
+        uint64_t now_tsc = __rdtsc();
+        ns = ClockNS(CLOCK_MONOTONIC);
+        if (now_tsc <= start_tsc) {
+            calibrating = false;
+            return ns;
+        }
+        // 以启动以来的全部历史计算频率, 基线越长越准
+        uint64_t freq = (uint64_t)(((unsigned __int128)(ns - start_ns) << 32) / (now_tsc - start_tsc));
+        uint64_t base = ns;
+        ClockParams old = load();
+        if (old.limit) {
+            // 不早于按旧参数换算的时间, 保持单调; 超前的部分在下一个周期内放慢追回
+            uint64_t predicted = old.base_ns + (uint64_t)(((unsigned __int128)(now_tsc - old.base_tsc) * old.mult) >> 32);
+            base = std::max(ns, predicted);
+        }
+        // 启动初期基线短, 频率误差大, 校准周期随基线增长, 最长1秒
+        uint64_t period = std::min(ns - start_ns, CLOCK_CALIBRATE_NS);
+        uint64_t ahead = std::min(base - ns, period / 2);
+        uint64_t new_mult = freq - freq * ahead / period;
+        int64_t offset = (int64_t)(ClockNS(CLOCK_REALTIME) - ClockNS(CLOCK_MONOTONIC));
+
+        seq.fetch_add(1, std::memory_order_acq_rel);
+        base_tsc.store(now_tsc, std::memory_order_relaxed);
+        base_ns.store(base, std::memory_order_relaxed);
+        mult.store(new_mult, std::memory_order_relaxed);
+        limit.store((uint64_t)(((unsigned __int128)period << 32) / freq), std::memory_order_relaxed);
+        wall_offset_ns.store(offset, std::memory_order_relaxed);
+        seq.fetch_add(1, std::memory_order_release);
+        calibrating = false;
+        return base;
+#else
+        return ns;
+#endif
+    }
+
+    // 线程缓存的参数过期后, 取共享参数, 共享参数也过期时重新校准
+    uint64_t refresh(uint64_t now_tsc) {
+        ClockParams params = load();
+        if (!params.limit || now_tsc - params.base_tsc >= params.limit) {
+            uint64_t ns = calibrate();
+            params = load();
+            if (!params.limit || now_tsc - params.base_tsc >= params.limit) {
+                return ns;
+            }
+        }
+        t_clock_params = params;
+        return params.base_ns + (uint64_t)(((unsigned __int128)(now_tsc - params.base_tsc) * params.mult) >> 32);
+    }
+
+    uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        if (tsc) {
+            uint64_t now_tsc = __rdtsc();
+            const ClockParams& params = t_clock_params;
+            uint64_t ns;
+            // 参数在读TSC之后才更新时差值回绕, 同样走慢路径
+            if (now_tsc - params.base_tsc < params.limit) {
+                ns = params.base_ns + (uint64_t)(((unsigned __int128)(now_tsc - params.base_tsc) * params.mult) >> 32);
+            } else {
+                ns = refresh(now_tsc);
+            }
+            // 切换参数时不回退
+            if (ns < t_clock_last) {
+                return t_clock_last;
+            }
+            t_clock_last = ns;
+            return ns;
+        }
+#endif
+        return ClockNS(CLOCK_MONOTONIC);
+    }
+};
+
+static MonotonicClock& GetMonotonicClock() {
+    static MonotonicClock s_clock;
+    return s_clock;
+}
+
+// 加载时初始化, 作为GetElapsedMS的起点
+static MonotonicClock& s_monotonic_clock_init = GetMonotonicClock();
+
+uint64_t GetMonotonicNS() {
+    return GetMonotonicClock().now();
+}
+
+uint64_t GetMonotonicUS() {
+    return GetMonotonicNS() / 1000;
+}
+
+uint64_t GetMonotonicMS() {
+    return GetMonotonicNS() / 1000000;
+}
+
+uint64_t GetCoarseMonotonicMS() {
+    return ClockNS(CLOCK_MONOTONIC_COARSE) / 1000000;
+}
+
+uint64_t GetElapsedMS() {
+    return (GetMonotonicNS() - GetMonotonicClock().start_ns) / 1000000;
+}
+
+uint64_t MonotonicToWallUS(uint64_t ns) {
+    MonotonicClock& clock = GetMonotonicClock();
+    if (!clock.tsc) {
+        // 没有定期校准, 每次换算时更新差值
+        clock.calibrate();
+    }
+    return (ns + clock.wall_offset_ns.load(std::memory_order_relaxed)) / 1000;
+}
+
+uint64_t GetWallClockUS() {
+    MonotonicClock& clock = GetMonotonicClock();
+    if (!clock.tsc) {
+        return GetCurrentUS();
+    }
+    uint64_t ns = clock.now();
+    if (!t_clock_params.limit) {
+        return MonotonicToWallUS(ns);
+    }
+    return (ns + t_clock_params.wall_offset_ns) / 1000;
+}
+
+const char* GetClockSource() {
+    return GetMonotonicClock().tsc ? "tsc" : "clock_gettime";
+}
+
 }  // namespace sylar
@@ -28,4 +28,60 @@ void Backtrace(std::vector<std::string>& bt, int size = 64, int skip = 1);
 
 std::string BacktraceToString(int size = 64, int skip = 2, const std::string& prefix = "");
 
+/**
+ * @brief 当前时间的毫秒数
+ */
+uint64_t GetCurrentMS();
+
+/**
+ * @brief 当前时间的微秒数
+ */
+uint64_t GetCurrentUS();
+
+/**
+ * @brief 单调时钟的纳秒数
+ * @details CPU支持不变TSC(invariant TSC)时读取TSC并按与CLOCK_MONOTONIC校准的倍率换算,
+ *          否则调用clock_gettime(CLOCK_MONOTONIC). 校准在进程启动约10毫秒后开始,
+ *          之后以倍增的周期(最长1秒)用clock_gettime重新校准, 换算参数以seqlock发布, 读取不加锁.
+ *          同一线程内单调不减; 不同核心的TSC由硬件同步
+ */
+uint64_t GetMonotonicNS();
+
+/**
+ * @brief 单调时钟的微秒数, 见GetMonotonicNS
+ */
+uint64_t GetMonotonicUS();
+
+/**
+ * @brief 单调时钟的毫秒数, 见GetMonotonicNS
+ */
+uint64_t GetMonotonicMS();
+
+/**
+ * @brief 低精度单调时钟的毫秒数
+ * @details CLOCK_MONOTONIC_COARSE, 精度为内核时钟节拍(通常1~4毫秒), 适合超时与统计
+ */
+uint64_t GetCoarseMonotonicMS();
+
+/**
+ * @brief 进程启动(首次使用时钟)到现在的毫秒数
+ */
+uint64_t GetElapsedMS();
+
+/**
+ * @brief 把GetMonotonicNS的值换算为墙上时间的微秒数
+ * @details 单调时钟与CLOCK_REALTIME的差值在每次校准时更新, 系统时间被修改后最多1秒生效
+ */
+uint64_t MonotonicToWallUS(uint64_t ns);
+
+/**
+ * @brief 由单调时钟换算的墙上时间的微秒数, 与GetCurrentUS相同但开销更低
+ */
+uint64_t GetWallClockUS();
+
+/**
+ * @brief 单调时钟的实现: "tsc"或"clock_gettime"
+ */
+const char* GetClockSource();
+
 }  // namespace sylar
@@ -0,0 +1,246 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Sylar-Server
+//
+// bench_log.cpp
+//
+// Identification: tests/bench_log.cpp
+//
+// Copyright (c) 2022, pyc
+//
+// 日志吞吐与调用延迟基准
+// 用法: bench_log [-n 每个线程的日志数] [-t 最大线程数] [-a 输出目标,逗号分隔]
+//                 [-m sync|async|both] [-f json|csv] [-o 结果文件]
+// 对每种输出目标(null/file/stdout), 格式模板, 线程数(1到最大线程数, 按2倍递增, 含最大线程数)
+// 与同步/异步组合运行一次, 每行输出一条结果. 结果默认写入标准错误,
+// 测试stdout时可将标准输出重定向到/dev/null
+//
+//===----------------------------------------------------------------------===//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/log.h"
+#include "log_fixture.h"
+
+struct BenchPattern {
+    const char* name;
+    const char* pattern;
+};
+
+static const BenchPattern s_patterns[] = {
+    {"default", SYLAR_LOG_DEFAULT_PATTERN},
+    {"message", "%m%n"},
+    {"json", SYLAR_LOG_JSON_PATTERN},
+    // 未编译期展开, 走操作码程序
+    {"custom", "%d{%Y-%m-%d %H:%M:%S.%3f} %p %c %t %m%n"},
+};
+
+struct BenchResult {
+    std::string appender;
+    std::string pattern;
+    std::string mode;
+    int threads = 0;
+    uint64_t events = 0;
+    double seconds = 0;
+    uint64_t p50 = 0;  // 调用延迟, 纳秒
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+};
+
+static sylar::LogAppender::ptr CreateAppender(const std::string& name) {
+    if (name == "file") {
+        unlink("./bench_log.txt");
+        return std::make_shared<sylar::FileLogAppender>("./bench_log.txt");
+    }
+    if (name == "stdout") {
+        return std::make_shared<sylar::StdoutLogAppender>();
+    }
+    return std::make_shared<NullLogAppender>();
+}
+
+static BenchResult Run(const std::string& appender_name, const BenchPattern& pattern, bool async,
+                       int thread_num, int count) {
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("bench");
+    sylar::LogAppender::ptr appender = CreateAppender(appender_name);
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>(pattern.pattern));
+    logger->addAppender(appender);
+    sylar::AsyncLogMgr::GetInstance()->setEnabled(async);
+
+    // 每个线程记录每次调用的耗时, 结束后合并计算分位数
+    std::vector<std::vector<uint32_t>> latencies(thread_num);
+    std::atomic<int> ready{0};
+    std::atomic<bool> start{false};
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < thread_num; ++i) {
+        thrs.emplace_back(std::make_shared<sylar::Thread>([&, i]() {
+            std::vector<uint32_t>& lat = latencies[i];
+            lat.reserve(count);
+            ++ready;
+            while (!start) {
+                std::this_thread::yield();
+            }
+            for (int j = 0; j < count; ++j) {
+                auto begin = std::chrono::steady_clock::now();
+                SYLAR_LOG_INFO(logger) << "bench log line " << j << " value=" << 3.14;
+                auto end = std::chrono::steady_clock::now();
+                lat.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+            }
+        }, "bench_" + std::to_string(i)));
+    }
+    while (ready < thread_num) {
+        std::this_thread::yield();
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+    for (auto& i : thrs) {
+        i->join();
+    }
+    // 异步模式下吞吐按全部输出完成计算
+    sylar::AsyncLogMgr::GetInstance()->flush();
+    if (auto file = std::dynamic_pointer_cast<sylar::FileLogAppender>(appender)) {
+        file->flush();
+    }
+    auto end = std::chrono::steady_clock::now();
+    sylar::AsyncLogMgr::GetInstance()->setEnabled(false);
+
+    std::vector<uint32_t> all;
+    all.reserve((size_t)count * thread_num);
+    for (auto& i : latencies) {
+        all.insert(all.end(), i.begin(), i.end());
+    }
+    auto percentile = [&all](double p) -> uint64_t {
+        if (all.empty()) {
+            return 0;
+        }
+        size_t n = std::min(all.size() - 1, (size_t)(all.size() * p));
+        std::nth_element(all.begin(), all.begin() + n, all.end());
+        return all[n];
+    };
+
+    BenchResult result;
+    result.appender = appender_name;
+    result.pattern = pattern.name;
+    result.mode = async ? "async" : "sync";
+    result.threads = thread_num;
+    result.events = all.size();
+    result.seconds = std::chrono::duration<double>(end - begin).count();
+    result.p50 = percentile(0.5);
+    result.p99 = percentile(0.99);
+    result.p999 = percentile(0.999);
+    result.max = all.empty() ? 0 : *std::max_element(all.begin(), all.end());
+    return result;
+}
+
+static void Print(FILE* out, const BenchResult& r, bool csv) {
+    double rate = r.seconds > 0 ? r.events / r.seconds : 0;
+    if (csv) {
+        fprintf(out, "%s,%s,%s,%d,%lu,%.0f,%lu,%lu,%lu,%lu\n", r.appender.c_str(), r.pattern.c_str(),
+                r.mode.c_str(), r.threads, (unsigned long)r.events, rate, (unsigned long)r.p50,
+                (unsigned long)r.p99, (unsigned long)r.p999, (unsigned long)r.max);
+    } else {
+        fprintf(out,
+                "{\"appender\":\"%s\",\"pattern\":\"%s\",\"mode\":\"%s\",\"threads\":%d,\"events\":%lu,"
+                "\"events_per_sec\":%.0f,\"p50_ns\":%lu,\"p99_ns\":%lu,\"p999_ns\":%lu,\"max_ns\":%lu}\n",
+                r.appender.c_str(), r.pattern.c_str(), r.mode.c_str(), r.threads, (unsigned long)r.events, rate,
+                (unsigned long)r.p50, (unsigned long)r.p99, (unsigned long)r.p999, (unsigned long)r.max);
+    }
+    fflush(out);
+}
+
+static std::vector<std::string> Split(const std::string& str) {
+    std::vector<std::string> result;
+    size_t begin = 0;
+    while (begin <= str.size()) {
+        size_t end = str.find(',', begin);
+        if (end == std::string::npos) {
+            end = str.size();
+        }
+        if (end > begin) {
+            result.emplace_back(str.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int count = 100000;
+    int max_threads = std::max(4u, std::thread::hardware_concurrency());
+    std::string appenders = "null,file,stdout";
+    std::string mode = "both";
+    bool csv = false;
+    FILE* out = stderr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:a:m:f:o:")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atoi(optarg);
+                break;
+            case 't':
+                max_threads = atoi(optarg);
+                break;
+            case 'a':
+                appenders = optarg;
+                break;
+            case 'm':
+                mode = optarg;
+                break;
+            case 'f':
+                csv = std::string(optarg) == "csv";
+                break;
+            case 'o':
+                out = fopen(optarg, "w");
+                if (!out) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            default:
+                fprintf(stderr,
+                        "usage: %s [-n events_per_thread] [-t max_threads] [-a null,file,stdout] "
+                        "[-m sync|async|both] [-f json|csv] [-o file]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+
+    std::vector<bool> modes;
+    if (mode != "async") {
+        modes.push_back(false);
+    }
+    if (mode != "sync") {
+        modes.push_back(true);
+    }
+    if (csv) {
+        fprintf(out, "appender,pattern,mode,threads,events,events_per_sec,p50_ns,p99_ns,p999_ns,max_ns\n");
+    }
+    for (auto& appender : Split(appenders)) {
+        for (auto& pattern : s_patterns) {
+            for (bool async : modes) {
+                for (int threads = 1; threads <= max_threads; threads = std::min(threads * 2, max_threads)) {
+                    Print(out, Run(appender, pattern, async, threads, count), csv);
+                    if (threads == max_threads) {
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    unlink("./bench_log.txt");
+    if (out != stderr) {
+        fclose(out);
+    }
+    return 0;
+}
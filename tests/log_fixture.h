@@ -0,0 +1,76 @@
+#pragma once
+
+// 日志相关测试与基准共用的辅助函数和Appender
+
+#include <stdio.h>
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "src/sylar.h"
+
+inline std::string ReadFile(const std::string& path) {
+    std::ifstream ifs(path);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+}
+
+// 进程累计的写系统调用次数
+inline uint64_t write_syscalls() {
+    uint64_t count = 0;
+    FILE* fp = fopen("/proc/self/io", "r");
+    if (fp) {
+        char line[128];
+        while (fgets(line, sizeof(line), fp)) {
+            if (sscanf(line, "syscw: %lu", &count) == 1) {
+                break;
+            }
+        }
+        fclose(fp);
+    }
+    return count;
+}
+
+// 只格式化不输出, 用于测量日志调用本身的开销; format为false时连格式化也跳过
+class NullLogAppender : public sylar::LogAppender {
+public:
+    NullLogAppender(bool format = true) : m_format(format) {}
+
+    void log(sylar::LogLevel::Level level, sylar::LogEvent::ptr event) override {
+        if (m_format) {
+            sylar::LogBuffer buffer;
+            m_formatter->format(buffer, level, *event);
+            t_size += buffer.size();
+        }
+    }
+
+    std::string toYamlString() override { return ""; }
+
+    // 当前线程累计格式化的字节数, 按线程统计以免多线程基准互相干扰
+    static inline thread_local uint64_t t_size = 0;
+
+private:
+    bool m_format;
+};
+
+// 统计收到的日志条数与存活的实例数
+class CountLogAppender : public sylar::LogAppender {
+public:
+    CountLogAppender() { ++s_alive; }
+    ~CountLogAppender() { --s_alive; }
+
+    void log(sylar::LogLevel::Level level, sylar::LogEvent::ptr event) override {
+        ++count;
+        ++s_total;
+    }
+
+    std::string toYamlString() override { return ""; }
+
+    std::atomic<uint64_t> count{0};
+
+    static inline std::atomic<int> s_alive{0};       // 存活的实例数
+    static inline std::atomic<uint64_t> s_total{0};  // 所有实例收到的日志条数
+};
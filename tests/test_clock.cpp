@@ -0,0 +1,125 @@
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "src/sylar.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static uint64_t clock_ns(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+// 跨过几次重新校准检查单调性与相对CLOCK_MONOTONIC, gettimeofday的偏差
+void test_clock() {
+    uint64_t prev = sylar::GetMonotonicNS();
+    uint64_t begin = clock_ns(CLOCK_MONOTONIC);
+    uint64_t backward = 0;
+    int64_t max_drift = 0;
+    int64_t max_wall_drift = 0;
+    int64_t max_coarse_drift = 0;
+    while (clock_ns(CLOCK_MONOTONIC) - begin < 3000000000ul) {
+        for (int i = 0; i < 1000; ++i) {
+            uint64_t now = sylar::GetMonotonicNS();
+            backward += now < prev;
+            prev = now;
+        }
+        // 两次读取之间被调度出去的样本不计
+        uint64_t before = clock_ns(CLOCK_MONOTONIC);
+        int64_t drift = (int64_t)(sylar::GetMonotonicNS() - before);
+        int64_t wall_drift = (int64_t)(sylar::GetWallClockUS() - sylar::GetCurrentUS());
+        int64_t coarse_drift = (int64_t)(sylar::GetCoarseMonotonicMS() - sylar::GetMonotonicMS());
+        if (clock_ns(CLOCK_MONOTONIC) - before < 2000) {
+            max_drift = std::max(max_drift, std::abs(drift));
+            max_wall_drift = std::max(max_wall_drift, std::abs(wall_drift));
+            max_coarse_drift = std::max(max_coarse_drift, std::abs(coarse_drift));
+        }
+    }
+    SYLAR_LOG_INFO(g_logger) << "test_clock source=" << sylar::GetClockSource() << " backward=" << backward
+                             << " max_drift_ns=" << max_drift << " max_wall_drift_us=" << max_wall_drift
+                             << " max_coarse_drift_ms=" << max_coarse_drift;
+    SYLAR_ASSERT(backward == 0);
+    SYLAR_ASSERT(max_drift < 200 * 1000);
+    SYLAR_ASSERT(max_wall_drift < 1000);
+    // 低精度时钟落后不超过几个时钟节拍
+    SYLAR_ASSERT(max_coarse_drift <= 20);
+
+    uint64_t ns = sylar::GetMonotonicNS();
+    int64_t wall = (int64_t)(sylar::MonotonicToWallUS(ns) - sylar::GetCurrentUS());
+    SYLAR_ASSERT(std::abs(wall) < 1000);
+    SYLAR_ASSERT(sylar::GetMonotonicUS() >= ns / 1000);
+    SYLAR_ASSERT(sylar::GetMonotonicMS() >= ns / 1000000);
+    SYLAR_LOG_INFO(g_logger) << "test_clock ok";
+}
+
+// 多线程同时读取与重新校准, 每个线程内单调不减
+void test_clock_threads() {
+    const int thread_num = 4;
+    std::vector<uint64_t> backward(thread_num);
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < thread_num; ++i) {
+        thrs.emplace_back(std::make_shared<sylar::Thread>([&backward, i]() {
+            uint64_t begin = clock_ns(CLOCK_MONOTONIC);
+            uint64_t prev = sylar::GetMonotonicNS();
+            while (clock_ns(CLOCK_MONOTONIC) - begin < 1500000000ul) {
+                uint64_t now = sylar::GetMonotonicNS();
+                backward[i] += now < prev;
+                prev = now;
+            }
+        }, "clock_" + std::to_string(i)));
+    }
+    for (auto& thr : thrs) {
+        thr->join();
+    }
+    for (int i = 0; i < thread_num; ++i) {
+        SYLAR_ASSERT2(backward[i] == 0, "thread " + std::to_string(i) + " backward=" + std::to_string(backward[i]));
+    }
+    SYLAR_LOG_INFO(g_logger) << "test_clock_threads ok";
+}
+
+// 各时间源每次调用的开销
+void bench_clock() {
+    const int count = 10000000;
+    auto run = [&](const char* name, const std::function<uint64_t()>& cb) {
+        uint64_t sum = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i) {
+            sum += cb();
+        }
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "bench_clock " << name << " ns/call="
+                  << std::chrono::duration<double, std::nano>(end - begin).count() / count
+                  << " sum=" << (sum & 0xff) << std::endl;
+    };
+    std::cout << "bench_clock source=" << sylar::GetClockSource() << std::endl;
+    run("empty", []() { return (uint64_t)0; });
+    run("gettimeofday", []() { return sylar::GetCurrentUS(); });
+    run("time", []() { return (uint64_t)time(0); });
+    run("realtime", []() { return clock_ns(CLOCK_REALTIME); });
+    run("monotonic", []() { return clock_ns(CLOCK_MONOTONIC); });
+    run("monotonic_coarse", []() { return clock_ns(CLOCK_MONOTONIC_COARSE); });
+#if defined(__x86_64__) || defined(__i386__)
+    run("rdtsc", []() { return (uint64_t)__builtin_ia32_rdtsc(); });
+#endif
+    run("GetMonotonicNS", []() { return sylar::GetMonotonicNS(); });
+    run("GetWallClockUS", []() { return sylar::GetWallClockUS(); });
+    run("GetCoarseMonotonicMS", []() { return sylar::GetCoarseMonotonicMS(); });
+
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("clock");
+    logger->addAppender(std::make_shared<sylar::StdoutLogAppender>());
+    logger->setFormatter("bench_clock elapse=%r time=%d{%H:%M:%S.%6f} %m%n");
+    SYLAR_LOG_INFO(logger) << "now=" << sylar::GetCurrentUS();
+}
+
+int main(int argc, char** argv) {
+    test_clock();
+    test_clock_threads();
+    bench_clock();
+    return 0;
+}
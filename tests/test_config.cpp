@@ -1,9 +1,16 @@
+#include <unistd.h>
 #include <yaml-cpp/yaml.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <iostream>
+#include <sstream>
 
 #include "../src/config.h"
 #include "../src/log.h"
+#include "../src/macro.h"
 
 sylar::ConfigVar<int>::ptr g_int_value_config =
     sylar::Config::Lookup("system.port", (int)8080, "system port");
@@ -215,7 +222,240 @@ void test_log() {
     SYLAR_LOG_INFO(system_log) << "hello system";
 }
 
+// bool与字符串互转不经过boost::lexical_cast
+void test_bool() {
+    auto var = sylar::Config::Lookup("test.bool", false, "bool");
+    SYLAR_ASSERT(var->toString() == "false");
+    for (const char* str : {"true", "TRUE", "yes", "on", "1"}) {
+        var->fromString(str);
+        SYLAR_ASSERT2(var->getValue(), str);
+        SYLAR_ASSERT(var->toString() == "true");
+        var->fromString("false");
+        SYLAR_ASSERT(!var->getValue());
+    }
+    for (const char* str : {"false", "No", "off", "0"}) {
+        var->setValue(true);
+        var->fromString(str);
+        SYLAR_ASSERT2(!var->getValue(), str);
+    }
+    // 无法识别时保持原值
+    var->fromString("maybe");
+    SYLAR_ASSERT(!var->getValue());
+
+    YAML::Node root = YAML::Load("test:\n    bool: true\n");
+    sylar::Config::LoadFromYaml(root);
+    SYLAR_ASSERT(var->getValue());
+    auto set = sylar::Config::Lookup("test.bool_set", std::set<bool>{true}, "bool set");
+    SYLAR_ASSERT(set->toString() == "- true");
+    set->fromString("[false, on]");
+    SYLAR_ASSERT((set->getValue() == std::set<bool>{false, true}));
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "test_bool ok";
+}
+
+// 配置读取: 原读写锁加拷贝的方式与快照, 线程缓存对比; 读取期间另一线程不断修改,
+// 读者看到的始终是某一次修改后的完整值
+void bench_config_read() {
+    const int count = 1000000;
+    auto int_var = sylar::Config::Lookup("bench.config.int", 42, "bench");
+    auto vec_var = sylar::Config::Lookup("bench.config.vec", std::vector<int>(100, 1), "bench");
+    sylar::RWMutex mutex;
+    std::vector<int> locked_vec(100, 1);
+
+    auto run = [&](const char* name, int thread_num, const std::function<uint64_t()>& cb) {
+        std::atomic<bool> stop{false};
+        // 每毫秒修改一次
+        sylar::Thread writer([&]() {
+            for (int i = 0; !stop; ++i) {
+                vec_var->setValue(std::vector<int>(100, i % 2 + 1));
+                usleep(1000);
+            }
+        }, "config_writer");
+        std::vector<sylar::Thread::ptr> thrs;
+        std::atomic<uint64_t> sum{0};
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < thread_num; ++i) {
+            thrs.emplace_back(std::make_shared<sylar::Thread>([&]() {
+                uint64_t local = 0;
+                for (int j = 0; j < count; ++j) {
+                    local += cb();
+                }
+                sum += local;
+            }, "config_reader"));
+        }
+        for (auto& i : thrs) {
+            i->join();
+        }
+        auto end = std::chrono::steady_clock::now();
+        stop = true;
+        writer.join();
+        // 每次读到的值为1或2(int为42)
+        SYLAR_ASSERT(sum >= (uint64_t)count * thread_num && sum <= (uint64_t)count * thread_num * 42);
+        std::cout << "bench_config_read " << name << " threads=" << thread_num << " ns/read="
+                  << std::chrono::duration<double, std::nano>(end - begin).count() / count / thread_num
+                  << std::endl;
+    };
+    for (int thread_num : {1, 4}) {
+        run("int_getValue", thread_num, [&]() {
+            int v = int_var->getValue();
+            SYLAR_ASSERT(v == 42);
+            return (uint64_t)v;
+        });
+        run("vec_rwlock_copy", thread_num, [&]() {
+            sylar::RWMutex::ReadLock lock(mutex);
+            std::vector<int> v = locked_vec;
+            return (uint64_t)v[0];
+        });
+        run("vec_getValue", thread_num, [&]() {
+            std::vector<int> v = vec_var->getValue();
+            SYLAR_ASSERT(v.size() == 100 && v[0] == v[99]);
+            return (uint64_t)v[0];
+        });
+        run("vec_getSnapshot", thread_num, [&]() {
+            auto v = vec_var->getSnapshot();
+            SYLAR_ASSERT(v->size() == 100 && (*v)[0] == (*v)[99]);
+            return (uint64_t)(*v)[0];
+        });
+        run("vec_cache", thread_num, [&]() {
+            static thread_local sylar::ConfigVar<std::vector<int>>::Cache t_cache(vec_var);
+            const std::vector<int>& v = t_cache.get();
+            SYLAR_ASSERT(v.size() == 100 && v[0] == v[99]);
+            return (uint64_t)v[0];
+        });
+    }
+}
+
+// 多线程只读时各方式的开销: getSnapshot每次进出读临界区并修改共享的引用计数,
+// 随线程数增加而变慢; Cache只读版本号, 与单线程相当
+void bench_config_snapshot() {
+    const int count = 1000000;
+    auto vec_var = sylar::Config::Lookup("bench.config.snapshot", std::vector<int>(100, 7), "bench");
+    int max_threads = std::max(2, std::min<int>(8, sysconf(_SC_NPROCESSORS_ONLN)));
+
+    auto run = [&](const char* name, int thread_num, const std::function<uint64_t()>& cb) {
+        std::vector<sylar::Thread::ptr> thrs;
+        std::atomic<uint64_t> sum{0};
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < thread_num; ++i) {
+            thrs.emplace_back(std::make_shared<sylar::Thread>([&]() {
+                uint64_t local = 0;
+                for (int j = 0; j < count; ++j) {
+                    local += cb();
+                }
+                sum += local;
+            }, "config_snapshot"));
+        }
+        for (auto& i : thrs) {
+            i->join();
+        }
+        auto end = std::chrono::steady_clock::now();
+        SYLAR_ASSERT(sum == (uint64_t)count * thread_num * 7);
+        std::cout << "bench_config_snapshot " << name << " threads=" << thread_num << " ns/read="
+                  << std::chrono::duration<double, std::nano>(end - begin).count() / count
+                  << std::endl;
+    };
+    for (int thread_num = 1; thread_num <= max_threads; thread_num *= 2) {
+        run("getSnapshot", thread_num, [&]() { return (uint64_t)(*vec_var->getSnapshot())[0]; });
+        run("cache", thread_num, [&]() {
+            static thread_local sylar::ConfigVar<std::vector<int>>::Cache t_cache(vec_var);
+            return (uint64_t)t_cache.get()[0];
+        });
+    }
+}
+
+// 加载几千项的配置: 直接按YAML节点转换, 与原先逐个元素序列化后再解析的方式对比, 结果应一致
+void bench_config_load() {
+    const int key_count = 2000;
+    const int item_count = 5000;
+    auto map_var = sylar::Config::Lookup("bench.load.map", std::map<std::string, std::vector<int>>(), "bench");
+    auto list_var = sylar::Config::Lookup("bench.load.list", std::vector<std::string>(), "bench");
+    std::vector<sylar::ConfigVar<int>::ptr> int_vars;
+    std::stringstream yaml;
+    yaml << "bench:\n  load:\n    map:\n";
+    for (int i = 0; i < key_count; ++i) {
+        yaml << "      key_" << i << ": [" << i << ", 1, 2, 3, 4, 5, 6, 7]\n";
+    }
+    yaml << "    list:\n";
+    for (int i = 0; i < item_count; ++i) {
+        yaml << "      - item_" << i << "\n";
+    }
+    for (int i = 0; i < key_count; ++i) {
+        int_vars.push_back(sylar::Config::Lookup("bench.load.int_" + std::to_string(i), 0, "bench"));
+        yaml << "    int_" << i << ": " << i << "\n";
+    }
+    YAML::Node root = YAML::Load(yaml.str());
+    YAML::Node map_node = root["bench"]["load"]["map"];
+    YAML::Node list_node = root["bench"]["load"]["list"];
+
+    auto to_string = [](const YAML::Node& node) {
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    };
+    // 原先的转换: 整体序列化后解析, 每个元素再序列化, 解析一次
+    auto legacy_vector = [&](const std::string& str) {
+        YAML::Node node = YAML::Load(str);
+        std::vector<int> vec;
+        for (size_t i = 0; i < node.size(); ++i) {
+            vec.push_back(boost::lexical_cast<int>(to_string(node[i])));
+        }
+        return vec;
+    };
+    auto legacy_map = [&](const std::string& str) {
+        YAML::Node node = YAML::Load(str);
+        std::map<std::string, std::vector<int>> map;
+        for (auto iter = node.begin(); iter != node.end(); ++iter) {
+            map.emplace(iter->first.Scalar(), legacy_vector(to_string(iter->second)));
+        }
+        return map;
+    };
+    auto legacy_list = [&](const std::string& str) {
+        YAML::Node node = YAML::Load(str);
+        std::vector<std::string> vec;
+        for (size_t i = 0; i < node.size(); ++i) {
+            vec.push_back(to_string(node[i]));
+        }
+        return vec;
+    };
+
+    auto run = [&](const char* name, const std::function<void()>& cb) {
+        auto begin = std::chrono::steady_clock::now();
+        cb();
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "bench_config_load " << name << " ms="
+                  << std::chrono::duration<double, std::milli>(end - begin).count() << std::endl;
+    };
+    std::map<std::string, std::vector<int>> legacy_map_value;
+    std::vector<std::string> legacy_list_value;
+    run("legacy_map", [&]() { legacy_map_value = legacy_map(to_string(map_node)); });
+    run("legacy_list", [&]() { legacy_list_value = legacy_list(to_string(list_node)); });
+    SYLAR_ASSERT(legacy_map_value.size() == (size_t)key_count);
+    SYLAR_ASSERT(legacy_list_value.size() == (size_t)item_count);
+
+    run("string_map", [&]() { map_var->fromString(to_string(map_node)); });
+    SYLAR_ASSERT(map_var->getValue() == legacy_map_value);
+    map_var->setValue({});
+    run("node_map", [&]() { map_var->fromYaml(map_node); });
+    SYLAR_ASSERT(map_var->getValue() == legacy_map_value);
+    run("node_list", [&]() { list_var->fromYaml(list_node); });
+    SYLAR_ASSERT(list_var->getValue() == legacy_list_value);
+
+    map_var->setValue({});
+    list_var->setValue({});
+    run("load_from_yaml", [&]() { sylar::Config::LoadFromYaml(root); });
+    SYLAR_ASSERT(map_var->getValue() == legacy_map_value);
+    SYLAR_ASSERT(list_var->getValue() == legacy_list_value);
+    for (int i = 0; i < key_count; ++i) {
+        SYLAR_ASSERT(int_vars[i]->getValue() == i);
+    }
+    SYLAR_ASSERT((map_var->getValue().at("key_7") == std::vector<int>{7, 1, 2, 3, 4, 5, 6, 7}));
+    SYLAR_ASSERT(list_var->getValue().front() == "item_0");
+}
+
 int main(int argc, char** argv) {
+    test_bool();
+    bench_config_read();
+    bench_config_snapshot();
+    bench_config_load();
     // test_yaml();
     // test_config();
     // test_class();
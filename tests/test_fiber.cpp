@@ -1,3 +1,6 @@
+#include <signal.h>
+
+#include <chrono>
 #include <vector>
 
 #include "src/sylar.h"
@@ -26,9 +29,138 @@ void test_fiber() {
     SYLAR_LOG_INFO(g_logger) << "main end";
 }
 
+static const int s_yield_count = 1000000;
+
+void yield_loop() {
+    for (int i = 0; i < s_yield_count; ++i) {
+        sylar::Fiber::YieldToHold();
+    }
+}
+
+// 模拟旧的让出路径: 每次让出都通过GetThis()拿一份智能指针
+void yield_loop_with_ptr() {
+    for (int i = 0; i < s_yield_count; ++i) {
+        sylar::Fiber::ptr curr = sylar::Fiber::GetThis();
+        sylar::Fiber::YieldToHold();
+    }
+}
+
+void bench_yield(const std::string& name, std::function<void()> cb) {
+    sylar::Fiber::ptr fiber = std::make_shared<sylar::Fiber>(cb);
+    auto begin = std::chrono::steady_clock::now();
+    while (fiber->getState() != sylar::Fiber::TERM) {
+        fiber->swapIn();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+    SYLAR_LOG_INFO(g_logger) << "bench_yield " << name << ": " << s_yield_count << " yields, "
+                             << ns / s_yield_count << " ns/yield";
+}
+
+void test_yield() {
+    sylar::Fiber::GetThis();
+    bench_yield("raw", &yield_loop);
+    bench_yield("shared_ptr", &yield_loop_with_ptr);
+}
+
+struct TraceContext {
+    static int s_alive;
+
+    uint64_t trace_id = 0;
+
+    TraceContext() { ++s_alive; }
+    ~TraceContext() { --s_alive; }
+};
+int TraceContext::s_alive = 0;
+
+static sylar::FiberLocal<TraceContext> s_trace;
+
+void run_with_trace(uint64_t trace_id) {
+    SYLAR_ASSERT(!s_trace.has());
+    s_trace->trace_id = trace_id;
+    sylar::Fiber::YieldToHold();
+    SYLAR_ASSERT(s_trace->trace_id == trace_id);
+    SYLAR_LOG_INFO(g_logger) << "fiber local trace_id=" << s_trace->trace_id;
+}
+
+void test_fiber_local() {
+    sylar::Fiber::GetThis();
+    sylar::Fiber::ptr f1 = std::make_shared<sylar::Fiber>(std::bind(run_with_trace, 1));
+    sylar::Fiber::ptr f2 = std::make_shared<sylar::Fiber>(std::bind(run_with_trace, 2));
+    f1->swapIn();
+    f2->swapIn();
+    SYLAR_ASSERT(TraceContext::s_alive == 2);
+    f2->swapIn();
+    f1->swapIn();
+    // 协程结束时释放
+    SYLAR_ASSERT(TraceContext::s_alive == 0);
+
+    // reset后重新懒构造
+    f1->reset(std::bind(run_with_trace, 3));
+    f1->swapIn();
+    SYLAR_ASSERT(TraceContext::s_alive == 1);
+    f1->swapIn();
+    SYLAR_ASSERT(TraceContext::s_alive == 0);
+    SYLAR_LOG_INFO(g_logger) << "test_fiber_local ok";
+}
+
+void test_fiber_dump() {
+    sylar::Config::Lookup<bool>("fiber.registry")->setValue(true);
+    sylar::Fiber::DumpFibersOnSignal(SIGUSR2);
+
+    std::vector<sylar::Fiber::ptr> fibers;
+    for (int i = 0; i < 3; ++i) {
+        fibers.emplace_back(std::make_shared<sylar::Fiber>(run_in_fiber));
+        fibers.back()->swapIn();
+    }
+    fibers.emplace_back(std::make_shared<sylar::Fiber>([]() {}));
+
+    std::stringstream ss;
+    sylar::Fiber::DumpFibers(ss, true);
+    SYLAR_LOG_INFO(g_logger) << "DumpFibers:\n" << ss.str();
+
+    // 后台线程输出到system日志
+    raise(SIGUSR2);
+    sleep(1);
+
+    for (auto& fiber : fibers) {
+        while (fiber->getState() != sylar::Fiber::TERM) {
+            fiber->swapIn();
+        }
+    }
+    sylar::Config::Lookup<bool>("fiber.registry")->setValue(false);
+}
+
+void test_fiber_accounting() {
+    uint32_t busy_tag = sylar::Fiber::RegisterTag("busy");
+    sylar::Fiber::ptr fiber = std::make_shared<sylar::Fiber>([]() {
+        for (int i = 0; i < 10; ++i) {
+            volatile uint64_t sum = 0;
+            for (int j = 0; j < 1000000; ++j) {
+                sum = sum + j;
+            }
+            sylar::Fiber::YieldToHold();
+        }
+    });
+    fiber->setTag(busy_tag);
+    while (fiber->getState() != sylar::Fiber::TERM) {
+        fiber->swapIn();
+    }
+    SYLAR_LOG_INFO(g_logger) << "fiber cpu_time=" << fiber->getCpuTime() << "ns switches=" << fiber->getSwitches();
+    for (auto& stats : sylar::Fiber::GetTagStats()) {
+        SYLAR_LOG_INFO(g_logger) << "tag=" << stats.name << " cpu_time=" << stats.cpu_time
+                                 << "ns switches=" << stats.switches;
+    }
+}
+
 int main(int argc, char** argv) {
     sylar::Thread::SetName("main");
 
+    test_yield();
+    test_fiber_local();
+    test_fiber_dump();
+    test_fiber_accounting();
+
     int thread_num = 1;
 
     std::vector<sylar::Thread::ptr> thrs;
@@ -0,0 +1,94 @@
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "src/sylar.h"
+#include "tests/log_fixture.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 每条日志耗时1毫秒的输出目标, 记录最后输出的内容
+class SlowLogAppender : public sylar::LogAppender {
+public:
+    void log(sylar::LogLevel::Level level, sylar::LogEvent::ptr event) override {
+        usleep(1000);
+        ++count;
+        last = event->getContent();
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::atomic<uint64_t> count{0};
+    std::string last;
+};
+
+static double ThreadCpuMS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// 慢的Appender在独立队列上运行, 不拖慢同一日志器的其他Appender;
+// BLOCK策略下等待的调用方不占用CPU
+void test_async_appender() {
+    const int count = 1000;
+    for (auto policy : {sylar::AsyncLogAppender::BLOCK, sylar::AsyncLogAppender::DROP_OLDEST,
+                        sylar::AsyncLogAppender::DROP_NEWEST}) {
+        sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("async_appender");
+        auto slow = std::make_shared<SlowLogAppender>();
+        auto async = std::make_shared<sylar::AsyncLogAppender>(slow, 64, policy);
+        auto fast = std::make_shared<CountLogAppender>();
+        logger->addAppender(async);
+        logger->addAppender(fast);
+        double cpu = ThreadCpuMS();
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i) {
+            SYLAR_LOG_INFO(logger) << "async appender line " << i;
+        }
+        auto end = std::chrono::steady_clock::now();
+        async->flush();
+        cpu = ThreadCpuMS() - cpu;
+        double wall = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        SYLAR_LOG_INFO(g_logger) << "test_async_appender policy=" << sylar::AsyncLogAppender::PolicyToString(policy)
+                                 << " us/call=" << std::chrono::duration<double, std::micro>(end - begin).count() / count
+                                 << " cpu=" << cpu << "ms wall=" << wall << "ms fast=" << fast->count
+                                 << " slow=" << slow->count << " dropped=" << async->getDropped()
+                                 << " blocked=" << async->getBlocked();
+
+        SYLAR_ASSERT(fast->count == (uint64_t)count);
+        // DROP_NEWEST丢弃的事件没有入队, DROP_OLDEST丢弃的已入队
+        uint64_t dropped_queued = policy == sylar::AsyncLogAppender::DROP_OLDEST ? async->getDropped() : 0;
+        SYLAR_ASSERT(async->getPushed() == async->getWritten() + dropped_queued);
+        SYLAR_ASSERT(slow->count + async->getDropped() == (uint64_t)count);
+        if (policy == sylar::AsyncLogAppender::BLOCK) {
+            SYLAR_ASSERT(async->getDropped() == 0);
+            SYLAR_ASSERT(async->getBlocked() > 0);
+            SYLAR_ASSERT(slow->last == "async appender line " + std::to_string(count - 1));
+            // 约1秒都在等待慢的输出目标, 等待期间不应占满CPU
+            SYLAR_ASSERT2(cpu < wall / 2, "blocked producer is spinning");
+        } else {
+            SYLAR_ASSERT(async->getDropped() > 0);
+            SYLAR_ASSERT(async->getBlocked() == 0);
+        }
+        if (policy == sylar::AsyncLogAppender::DROP_OLDEST) {
+            SYLAR_ASSERT(slow->last == "async appender line " + std::to_string(count - 1));
+        }
+    }
+
+    std::string yaml = sylar::AsyncLogAppender(std::make_shared<sylar::StdoutLogAppender>(), 128,
+                                               sylar::AsyncLogAppender::DROP_NEWEST)
+                           .toYamlString();
+    YAML::Node node = YAML::Load(yaml);
+    SYLAR_ASSERT(node["type"].as<std::string>() == "StdoutLogAppender");
+    SYLAR_ASSERT(node["async"].as<bool>());
+    SYLAR_ASSERT(node["queue_size"].as<size_t>() == 128);
+    SYLAR_ASSERT(node["overflow"].as<std::string>() == "drop_newest");
+}
+
+int main(int argc, char** argv) {
+    test_async_appender();
+    return 0;
+}
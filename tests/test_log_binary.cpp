@@ -0,0 +1,164 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "src/sylar.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 解码出的日志按调用点的fmt渲染, 与文本日志混合写入
+void test_binary_decode() {
+    const std::string path = "./binary.bin";
+    unlink(path.c_str());
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("binary");
+    sylar::BinaryLogAppender::ptr appender = std::make_shared<sylar::BinaryLogAppender>(path);
+    logger->addAppender(appender);
+    std::string str = "world";
+    for (int i = 0; i < 3; ++i) {
+        SYLAR_LOG_BIN_INFO(logger, "hello %s i=%d u=%u x=%#x f=%.2f c=%c ll=%lld %%", str, i, 7u, 255, 3.14159, 'z', -1LL);
+    }
+    SYLAR_LOG_BIN_WARN(logger, "no args");
+    SYLAR_LOG_BIN_INFO(logger, "int %d %i %u %x %X %o %ld %lu %lx %#x %5u", -42, INT32_MIN, 42u, -1, 0xabcu, 8,
+                       INT64_MIN, UINT64_MAX, -1L, -2, -3);
+    SYLAR_LOG_INFO(logger) << "text line";
+    appender->flush();
+
+    sylar::LogBinReader reader(path);
+    SYLAR_ASSERT(reader.isOpen());
+    sylar::LogFormatter formatter("[%p] [%c] %m%n");
+    sylar::LogEvent event;
+    sylar::LogBuffer out;
+    int count = 0;
+    while (reader.next(event)) {
+        formatter.format(out, event.getLevel(), event);
+        ++count;
+    }
+    SYLAR_ASSERT(!reader.isError());
+    SYLAR_ASSERT(count == 6);
+    std::string expect;
+    for (int i = 0; i < 3; ++i) {
+        expect += "[INFO] [binary] hello world i=" + std::to_string(i) + " u=7 x=0xff f=3.14 c=z ll=-1 %\n";
+    }
+    expect += "[WARN] [binary] no args\n";
+    char ints[256];
+    snprintf(ints, sizeof(ints), "int %d %i %u %x %X %o %ld %lu %lx %#x %5u", -42, INT32_MIN, 42u, -1, 0xabcu, 8,
+             INT64_MIN, UINT64_MAX, -1L, -2, -3);
+    expect += "[INFO] [binary] " + std::string(ints) + "\n";
+    expect += "[INFO] [binary] text line\n";
+    SYLAR_ASSERT2(out.view() == expect, out.view());
+    SYLAR_LOG_INFO(g_logger) << "test_binary_decode ok";
+    unlink(path.c_str());
+}
+
+// 日志器地址被复用后名称变化, 之后新出现的字符串不能与仍在使用的id冲突
+void test_string_id_reuse() {
+    const std::string path = "./binary_reuse.bin";
+    unlink(path.c_str());
+    sylar::BinaryLogAppender::ptr appender = std::make_shared<sylar::BinaryLogAppender>(path);
+    auto log = [&](sylar::Logger* logger) {
+        sylar::LogEvent::ptr event = std::make_shared<sylar::LogEvent>(
+            __FILE__, __LINE__, 0, 0, "main", 0, sylar::GetCurrentUS(), logger, sylar::LogLevel::INFO);
+        event->getBuffer().append("x", 1);
+        appender->log(sylar::LogLevel::INFO, event);
+    };
+
+    alignas(sylar::Logger) char storage[sizeof(sylar::Logger)];
+    sylar::Logger* first = new (storage) sylar::Logger("first");
+    log(first);
+    sylar::Logger::ptr other = std::make_shared<sylar::Logger>("other");
+    log(other.get());
+    first->~Logger();
+    sylar::Logger* second = new (storage) sylar::Logger("second");
+    log(second);
+    sylar::Logger::ptr third = std::make_shared<sylar::Logger>("third");
+    log(third.get());
+    log(second);
+    second->~Logger();
+    appender->flush();
+
+    sylar::LogBinReader reader(path);
+    sylar::LogEvent event;
+    std::vector<std::string> names;
+    while (reader.next(event)) {
+        names.push_back(event.getLogger()->getName());
+    }
+    SYLAR_ASSERT(!reader.isError());
+    SYLAR_ASSERT((names == std::vector<std::string>{"first", "other", "second", "third", "second"}));
+    SYLAR_LOG_INFO(g_logger) << "test_string_id_reuse ok";
+    unlink(path.c_str());
+}
+
+// 同样的内容分别以printf格式化写文本文件与以二进制写文件, 比较每条日志的开销
+void bench_binary(int thread_num) {
+    const int count = 200000;
+    auto run = [&](const std::string& name, sylar::LogAppender::ptr appender, bool binary) {
+        sylar::Logger::ptr logger = std::make_shared<sylar::Logger>(name);
+        logger->addAppender(appender);
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<sylar::Thread::ptr> thrs;
+        for (int i = 0; i < thread_num; ++i) {
+            thrs.emplace_back(std::make_shared<sylar::Thread>([logger, count, binary]() {
+                for (int j = 0; j < count; ++j) {
+                    if (binary) {
+                        SYLAR_LOG_BIN_INFO(logger, "request %s id=%d cost=%.3fms", "GET /index", j, j * 0.5);
+                    } else {
+                        SYLAR_LOG_FMT_INFO(logger, "request %s id=%d cost=%.3fms", "GET /index", j, j * 0.5);
+                    }
+                }
+            }, name + "_" + std::to_string(i)));
+        }
+        for (auto& thr : thrs) {
+            thr->join();
+        }
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "bench_binary " << name << " threads=" << thread_num << " logs/sec="
+                  << (uint64_t)(count * thread_num / std::chrono::duration<double>(end - begin).count()) << std::endl;
+    };
+    unlink("./bench_text.txt");
+    unlink("./bench_binary.bin");
+    run("text", std::make_shared<sylar::FileLogAppender>("./bench_text.txt"), false);
+    run("binary", std::make_shared<sylar::BinaryLogAppender>("./bench_binary.bin"), true);
+}
+
+// 不经过Logger, 只比较生成一行日志的开销: printf格式化并按默认模板渲染 vs 写入二进制参数
+void bench_binary_encode() {
+    const int count = 1000000;
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("encode");
+    sylar::LogFormatter formatter(SYLAR_LOG_DEFAULT_PATTERN);
+    sylar::LogBuffer out;
+    auto run = [&](const char* name, const std::function<void(sylar::LogEvent&, int)>& cb) {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i) {
+            sylar::LogEvent event(__FILE__, __LINE__, 0, 0, "main", 0, sylar::GetCurrentUS(),
+                                  logger.get(), sylar::LogLevel::INFO);
+            cb(event, i);
+        }
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "bench_binary_encode " << name << " ns/line="
+                  << std::chrono::duration<double, std::nano>(end - begin).count() / count << std::endl;
+    };
+    run("text", [&](sylar::LogEvent& event, int i) {
+        event.format("request %s id=%d cost=%.3fms", "GET /index", i, i * 0.5);
+        out.clear();
+        formatter.format(out, sylar::LogLevel::INFO, event);
+    });
+    run("binary", [&](sylar::LogEvent& event, int i) {
+        static sylar::LogBinSite s_site{__FILE__, __LINE__, "request %s id=%d cost=%.3fms"};
+        event.encode(&s_site, "GET /index", i, i * 0.5);
+    });
+}
+
+int main(int argc, char** argv) {
+    test_binary_decode();
+    test_string_id_reuse();
+    bench_binary_encode();
+    for (int thread_num : {1, 4}) {
+        bench_binary(thread_num);
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "src/sylar.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 调用点缓存: 级别变化后重新判断
+void test_call_site() {
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("call_site");
+    int evaluated = 0;
+    auto run = [&]() {
+        for (int i = 0; i < 10; ++i) {
+            SYLAR_LOG_DEBUG(logger) << ++evaluated;
+        }
+    };
+    logger->setLevel(sylar::LogLevel::INFO);
+    run();
+    SYLAR_ASSERT(evaluated == 0);
+    logger->setLevel(sylar::LogLevel::DEBUG);
+    run();
+    SYLAR_ASSERT(evaluated == (SYLAR_LOG_MIN_LEVEL <= sylar::LogLevel::DEBUG ? 10 : 0));
+    SYLAR_LOG_INFO(g_logger) << "test_call_site ok";
+}
+
+// 同一调用点的级别在运行时才确定: 先被关闭的级别不能影响之后开启的级别
+void test_runtime_level() {
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("runtime_level");
+    logger->setLevel(sylar::LogLevel::INFO);
+    int evaluated = 0;
+    auto log = [&](sylar::LogLevel::Level level) { SYLAR_LOG_LEVEL(logger, level) << ++evaluated; };
+    log(sylar::LogLevel::DEBUG);
+    SYLAR_ASSERT(evaluated == 0);
+    log(sylar::LogLevel::ERROR);
+    SYLAR_ASSERT(evaluated == 1);
+    log(sylar::LogLevel::DEBUG);
+    SYLAR_ASSERT(evaluated == 1);
+    log(sylar::LogLevel::INFO);
+    SYLAR_ASSERT(evaluated == 2);
+    SYLAR_LOG_INFO(g_logger) << "test_runtime_level ok";
+}
+
+// 同一调用点交替使用级别不同的日志器
+void test_multi_logger() {
+    sylar::Logger::ptr debug = std::make_shared<sylar::Logger>("debug");
+    sylar::Logger::ptr error = std::make_shared<sylar::Logger>("error");
+    debug->setLevel(sylar::LogLevel::DEBUG);
+    error->setLevel(sylar::LogLevel::ERROR);
+    int evaluated = 0;
+    auto log = [&](sylar::Logger::ptr logger) { SYLAR_LOG_WARN(logger) << ++evaluated; };
+    for (int i = 0; i < 10; ++i) {
+        log(debug);
+        log(error);
+    }
+    SYLAR_ASSERT(evaluated == 10);
+    SYLAR_LOG_INFO(g_logger) << "test_multi_logger ok";
+}
+
+// 关闭的调用点与直接比较级别的开销, 以及两个日志器交替使用同一调用点的开销
+void bench_call_site() {
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("bench_call_site");
+    sylar::Logger::ptr other = std::make_shared<sylar::Logger>("bench_call_site_other");
+    logger->setLevel(sylar::LogLevel::INFO);
+    other->setLevel(sylar::LogLevel::INFO);
+    const int count = 10000000;
+    int evaluated = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        if (logger->getLevel() <= sylar::LogLevel::DEBUG) {
+            ++evaluated;
+        }
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        SYLAR_LOG_DEBUG(logger) << ++evaluated;
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::vector<sylar::Logger::ptr> loggers{logger, other};
+    for (int i = 0; i < count; ++i) {
+        SYLAR_LOG_DEBUG(loggers[i & 1]) << ++evaluated;
+    }
+    auto alternate = std::chrono::steady_clock::now();
+    SYLAR_ASSERT(evaluated == 0);
+    std::cout << "bench_call_site disabled ns/call getLevel="
+              << std::chrono::duration<double, std::nano>(mid - begin).count() / count
+              << " cached=" << std::chrono::duration<double, std::nano>(end - mid).count() / count
+              << " alternate=" << std::chrono::duration<double, std::nano>(alternate - end).count() / count
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_call_site();
+    test_runtime_level();
+    test_multi_logger();
+    bench_call_site();
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "src/sylar.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 解压path(可以是多个块流拼接的文件), 返回内容的行数, 解压失败返回-1
+static int CountLzLines(const std::string& path) {
+    FILE* in = fopen(path.c_str(), "rb");
+    FILE* out = tmpfile();
+    bool ok = in && sylar::LzDecompressStream(in, out);
+    int lines = 0;
+    rewind(out);
+    for (int c; (c = fgetc(out)) != EOF;) {
+        lines += c == '\n';
+    }
+    if (in) {
+        fclose(in);
+    }
+    fclose(out);
+    return ok ? lines : -1;
+}
+
+static int CountLines(const std::string& path) {
+    std::ifstream ifs(path);
+    std::string line;
+    int lines = 0;
+    while (std::getline(ifs, line)) {
+        ++lines;
+    }
+    return lines;
+}
+
+// 编解码往返, 截断的数据解压失败, 以及编解码速度
+void test_lz() {
+    std::string text;
+    for (int i = 0; i < 20000; ++i) {
+        text += "2022-06-01 12:00:00\t1234\tmain\t0\t[INFO]\t[root]\t<tests/test.cpp:100>\trequest id=" +
+                std::to_string(i) + " cost=" + std::to_string(i % 97) + "ms\n";
+    }
+    std::vector<char> comp(sylar::LzCompressBound(text.size()));
+    std::string raw(text.size(), '\0');
+    const int rounds = 20;
+    auto begin = std::chrono::steady_clock::now();
+    size_t comp_len = 0;
+    for (int i = 0; i < rounds; ++i) {
+        comp_len = sylar::LzCompress(text.data(), text.size(), comp.data());
+    }
+    auto mid = std::chrono::steady_clock::now();
+    bool ok = true;
+    for (int i = 0; i < rounds; ++i) {
+        ok = ok && sylar::LzDecompress(comp.data(), comp_len, &raw[0], raw.size());
+    }
+    auto end = std::chrono::steady_clock::now();
+    SYLAR_ASSERT(ok && raw == text);
+    SYLAR_ASSERT(comp_len < text.size());
+    SYLAR_ASSERT(!sylar::LzDecompress(comp.data(), comp_len / 2, &raw[0], raw.size()));
+    double mb = text.size() * rounds / 1024.0 / 1024.0;
+    std::cout << "bench_lz ratio=" << (double)text.size() / comp_len
+              << " compress MB/s=" << mb / std::chrono::duration<double>(mid - begin).count()
+              << " decompress MB/s=" << mb / std::chrono::duration<double>(end - mid).count() << std::endl;
+}
+
+// 切分出的文件由后台线程压缩为.lz; 整个文件为块流时写日志的线程只移交缓冲区
+void test_compress() {
+    system("rm -f ./compress_rotate.txt* ./compress_stream.lz ./compress_all.lz");
+    const int count = 5000;
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("compress");
+    sylar::FileLogAppender::ptr rotate = std::make_shared<sylar::FileLogAppender>("./compress_rotate.txt");
+    rotate->setBufferSize(1024);
+    rotate->setRotateSize(64 * 1024);
+    rotate->setCompress(sylar::FileLogAppender::COMPRESS_ROTATE);
+    logger->addAppender(rotate);
+    sylar::FileLogAppender::ptr stream = std::make_shared<sylar::FileLogAppender>("./compress_stream.lz");
+    stream->setCompress(sylar::FileLogAppender::COMPRESS_STREAM);
+    logger->addAppender(stream);
+    for (int i = 0; i < count; ++i) {
+        SYLAR_LOG_INFO(logger) << "compress line " << i;
+    }
+    rotate->flush();
+    stream->flush();
+    sylar::LogCompressor::GetInstance()->flush();
+
+    // 块流可以直接拼接, 切分出的各个.lz文件拼接后一起解压, 加上当前的文本文件为全部日志
+    system("cat ./compress_rotate.txt.*.lz > ./compress_all.lz");
+    int rotated = CountLzLines("./compress_all.lz");
+    SYLAR_ASSERT(rotated > 0);
+    SYLAR_ASSERT(rotated + CountLines("./compress_rotate.txt") == count);
+    SYLAR_ASSERT(CountLzLines("./compress_stream.lz") == count);
+    SYLAR_LOG_INFO(g_logger) << "test_compress ok rotated=" << rotated;
+    system("rm -f ./compress_rotate.txt* ./compress_stream.lz ./compress_all.lz");
+}
+
+int main(int argc, char** argv) {
+    test_lz();
+    test_compress();
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include "src/sylar.h"
+#include "tests/log_fixture.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static size_t CountOf(const std::string& str, const std::string& sub) {
+    size_t count = 0;
+    for (size_t pos = str.find(sub); pos != std::string::npos; pos = str.find(sub, pos + sub.size())) {
+        ++count;
+    }
+    return count;
+}
+
+// 在子进程中执行cb, 返回子进程的退出状态; 超时未退出视为卡死
+static int RunChild(const std::function<void()>& cb, int timeout_ms = 10000) {
+    // 子进程退出时不重复输出父进程缓冲中的内容
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        cb();
+        _exit(0);
+    }
+    int status = 0;
+    for (int i = 0; i < timeout_ms / 10; ++i) {
+        if (waitpid(pid, &status, WNOHANG) == pid) {
+            return status;
+        }
+        usleep(10 * 1000);
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    SYLAR_ASSERT2(false, "child process hung");
+    return status;
+}
+
+// 缓冲的文件日志在SIGSEGV时由信号处理函数写出, 并附带调用栈
+void test_crash_flush() {
+    const std::string path = "./crash_flush.txt";
+    unlink(path.c_str());
+    const int count = 100;
+    int status = RunChild([&]() {
+        sylar::InstallLogCrashHandler();
+        sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("crash");
+        sylar::FileLogAppender::ptr appender = std::make_shared<sylar::FileLogAppender>(path);
+        appender->setFlushInterval(UINT64_MAX);
+        logger->addAppender(appender);
+        for (int i = 0; i < count; ++i) {
+            SYLAR_LOG_INFO(logger) << "crash flush line " << i;
+        }
+        *(volatile int*)nullptr = 0;
+    });
+    SYLAR_ASSERT(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+    std::string content = ReadFile(path);
+    SYLAR_ASSERT(CountOf(content, "crash flush line ") == (size_t)count);
+    SYLAR_ASSERT(content.find("*** FATAL: signal 11 (SIGSEGV)") != std::string::npos);
+    SYLAR_ASSERT(content.find("backtrace:") != std::string::npos);
+    SYLAR_LOG_INFO(g_logger) << "test_crash_flush ok";
+    unlink(path.c_str());
+}
+
+// 输出过程中(持有Appender的锁)断言失败
+class AssertFileLogAppender : public sylar::FileLogAppender {
+public:
+    using FileLogAppender::FileLogAppender;
+
+protected:
+    void encode(sylar::LogBuffer& out, sylar::LogLevel::Level level, const sylar::LogEvent& event) override {
+        SYLAR_ASSERT(event.getContentView() != "boom");
+        FileLogAppender::encode(out, level, event);
+    }
+};
+
+// 输出时断言失败的Appender, 用于在后台输出线程上触发断言
+class AssertLogAppender : public sylar::LogAppender {
+public:
+    void log(sylar::LogLevel::Level level, sylar::LogEvent::ptr event) override {
+        SYLAR_ASSERT(event->getContentView() != "boom");
+    }
+    std::string toYamlString() override { return ""; }
+};
+
+// 断言失败时LogFlushAll尽力输出后abort, 不能卡死: 持有FileLogAppender的锁,
+// 在AsyncLogAppender的后台线程上, 在异步日志的后台线程上
+void test_assert_flush() {
+    const std::string path = "./assert_flush.txt";
+    unlink(path.c_str());
+    int status = RunChild([&]() {
+        sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("assert_file");
+        logger->addAppender(std::make_shared<AssertFileLogAppender>(path));
+        SYLAR_LOG_INFO(logger) << "before";
+        SYLAR_LOG_INFO(logger) << "boom";
+    });
+    SYLAR_ASSERT(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+    SYLAR_ASSERT(ReadFile(path).find("before") != std::string::npos);
+
+    status = RunChild([]() {
+        sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("assert_async_appender");
+        logger->addAppender(std::make_shared<sylar::AsyncLogAppender>(std::make_shared<AssertLogAppender>()));
+        SYLAR_LOG_INFO(logger) << "boom";
+        sleep(5);
+    });
+    SYLAR_ASSERT(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+    status = RunChild([]() {
+        sylar::Config::Lookup<bool>("log.async.enable")->setValue(true);
+        sylar::Logger::ptr logger = SYLAR_LOG_NAME("assert_async");
+        logger->addAppender(std::make_shared<AssertLogAppender>());
+        SYLAR_LOG_INFO(logger) << "boom";
+        sleep(5);
+    });
+    SYLAR_ASSERT(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+    SYLAR_LOG_INFO(g_logger) << "test_assert_flush ok";
+    unlink(path.c_str());
+}
+
+static bool CrashHandlerInstalled() {
+    struct sigaction sa;
+    sigaction(SIGSEGV, nullptr, &sa);
+    return sa.sa_handler != SIG_DFL;
+}
+
+// 默认不安装信号处理函数, 通过配置log.crash_handler开启与关闭
+void test_crash_handler_config() {
+    int status = RunChild([]() {
+        SYLAR_ASSERT(!CrashHandlerInstalled());
+        auto var = sylar::Config::Lookup<bool>("log.crash_handler");
+        SYLAR_ASSERT(var && !var->getValue());
+        var->setValue(true);
+        SYLAR_ASSERT(CrashHandlerInstalled());
+        var->setValue(false);
+        SYLAR_ASSERT(!CrashHandlerInstalled());
+    });
+    SYLAR_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    SYLAR_LOG_INFO(g_logger) << "test_crash_handler_config ok";
+}
+
+int main(int argc, char** argv) {
+    test_crash_handler_config();
+    test_crash_flush();
+    test_assert_flush();
+    return 0;
+}
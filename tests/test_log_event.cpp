@@ -0,0 +1,95 @@
+#include <stdlib.h>
+
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "src/sylar.h"
+#include "tests/log_fixture.h"
+
+// 统计当前线程的堆分配次数
+static thread_local uint64_t t_allocs = 0;
+
+void* operator new(size_t size) {
+    ++t_allocs;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 内容不超过内置缓冲区时, 构造事件, 写入内容与格式化都不产生堆分配
+void test_no_alloc() {
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("no_alloc");
+    auto appender = std::make_shared<NullLogAppender>(true);
+    logger->addAppender(appender);
+    auto log = [&](int i) {
+        SYLAR_LOG_INFO(logger) << "no alloc line " << i << " value=" << 3.14;
+        SYLAR_LOG_FMT_INFO(logger, "no alloc fmt %d %s", i, "str");
+    };
+    // 首次调用登记调用点, 初始化线程局部的缓存
+    log(0);
+    uint64_t allocs = t_allocs;
+    for (int i = 0; i < 1000; ++i) {
+        log(i);
+    }
+    allocs = t_allocs - allocs;
+    SYLAR_ASSERT2(allocs == 0, std::to_string(allocs) + " allocations");
+    SYLAR_ASSERT(NullLogAppender::t_size > 0);
+
+    // 超出内置缓冲区时转存到堆上, 内容完整
+    std::string big(sylar::LogBuffer::INLINE_SIZE * 2, 'x');
+    sylar::LogEventWrap wrap(__FILE__, __LINE__, 0, 0, "main", 0, 0, logger.get(), sylar::LogLevel::INFO);
+    wrap.getSS() << "head " << big << " tail";
+    SYLAR_ASSERT(wrap.getEvent()->getBuffer().isSpilled());
+    SYLAR_ASSERT(wrap.getEvent()->getContent() == "head " + big + " tail");
+    SYLAR_LOG_INFO(g_logger) << "test_no_alloc ok";
+}
+
+void bench_log(const std::string& name, bool format, int thread_num) {
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>(name);
+    logger->addAppender(std::make_shared<NullLogAppender>(format));
+
+    const int count = 200000;
+    std::vector<sylar::Thread::ptr> thrs;
+    std::vector<double> rates(thread_num);
+    for (int i = 0; i < thread_num; ++i) {
+        thrs.emplace_back(std::make_shared<sylar::Thread>([logger, count, &rates, i]() {
+            auto begin = std::chrono::steady_clock::now();
+            for (int j = 0; j < count; ++j) {
+                SYLAR_LOG_INFO(logger) << "bench log line " << j << " value=" << 3.14;
+            }
+            auto end = std::chrono::steady_clock::now();
+            rates[i] = count / std::chrono::duration<double>(end - begin).count();
+        }, name + "_" + std::to_string(i)));
+    }
+    double total = 0;
+    for (int i = 0; i < thread_num; ++i) {
+        thrs[i]->join();
+        total += rates[i];
+    }
+    std::cout << "bench_log " << name << " threads=" << thread_num
+              << " logs/sec/thread=" << (uint64_t)(total / thread_num) << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_no_alloc();
+    for (int thread_num : {1, 4}) {
+        bench_log("null", false, thread_num);
+        bench_log("format", true, thread_num);
+    }
+    return 0;
+}
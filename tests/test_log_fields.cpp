@@ -0,0 +1,120 @@
+#include <math.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "src/sylar.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 按格式器输出到内存的输出目标
+class StringLogAppender : public sylar::LogAppender {
+public:
+    void log(sylar::LogLevel::Level level, sylar::LogEvent::ptr event) override {
+        MutexType::Lock lock(m_mutex);
+        sylar::LogBuffer buffer;
+        m_formatter->format(buffer, level, *event);
+        lines.emplace_back(buffer.view());
+    }
+
+    std::string toYamlString() override { return ""; }
+
+    std::vector<std::string> lines;
+};
+
+// JSON输出从message开始的部分, 前面的时间与线程信息随运行变化
+static std::string JsonTail(const std::string& json) {
+    size_t pos = json.find("\"message\":");
+    return pos == std::string::npos ? json : json.substr(pos);
+}
+
+// 结构化字段: 文本与JSON输出, 二进制往返
+void test_fields() {
+    const std::string path = "./fields.bin";
+    unlink(path.c_str());
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("fields");
+    auto text = std::make_shared<StringLogAppender>();
+    text->setFormatter(std::make_shared<sylar::LogFormatter>("[%p] %m%n"));
+    logger->addAppender(text);
+    auto json = std::make_shared<StringLogAppender>();
+    json->setFormatter(std::make_shared<sylar::LogFormatter>(SYLAR_LOG_JSON_PATTERN));
+    logger->addAppender(json);
+    sylar::BinaryLogAppender::ptr binary = std::make_shared<sylar::BinaryLogAppender>(path);
+    logger->addAppender(binary);
+
+    std::string user = "p\"y\\c\n\x01";
+    SYLAR_LOG_INFO(logger) << "login" << sylar::LogField("user", user) << sylar::LogField("uid", 42)
+                           << sylar::LogField("ok", true) << sylar::LogField("cost", 1.5)
+                           << sylar::LogField("nan", NAN);
+    SYLAR_LOG_BIN_WARN(logger, "retry %d", 3);
+    binary->flush();
+
+    // 文本原样输出, JSON转义控制字符, 非有限浮点数输出null
+    SYLAR_ASSERT(text->lines.size() == 2 && json->lines.size() == 2);
+    SYLAR_ASSERT2(text->lines[0] == "[INFO] login user=p\"y\\c\n\x01 uid=42 ok=true cost=1.5 nan=nan\n",
+                  text->lines[0]);
+    SYLAR_ASSERT(text->lines[1] == "[WARN] retry 3\n");
+    SYLAR_ASSERT(json->lines[0].compare(0, 9, "{\"time\":\"") == 0);
+    SYLAR_ASSERT2(JsonTail(json->lines[0]) == "\"message\":\"login\",\"user\":\"p\\\"y\\\\c\\n\\u0001\","
+                  "\"uid\":42,\"ok\":true,\"cost\":1.5,\"nan\":null}\n", json->lines[0]);
+    SYLAR_ASSERT(JsonTail(json->lines[1]) == "\"message\":\"retry 3\"}\n");
+
+    // 不是日志流时按文本输出
+    std::ostringstream oss;
+    oss << "not a log stream:" << sylar::LogField("k", "v");
+    SYLAR_ASSERT(oss.str() == "not a log stream: k=v");
+
+    // 二进制文件解码后与直接输出一致
+    sylar::LogBinReader reader(path);
+    SYLAR_ASSERT(reader.isOpen());
+    sylar::LogFormatter formatter(SYLAR_LOG_JSON_PATTERN);
+    sylar::LogEvent event;
+    std::vector<std::string> decoded;
+    while (reader.next(event)) {
+        sylar::LogBuffer out;
+        formatter.format(out, event.getLevel(), event);
+        decoded.emplace_back(out.view());
+    }
+    SYLAR_ASSERT(!reader.isError());
+    SYLAR_ASSERT2(decoded.size() == 2, std::to_string(decoded.size()));
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        SYLAR_ASSERT2(JsonTail(decoded[i]) == JsonTail(json->lines[i]), decoded[i]);
+    }
+    SYLAR_LOG_INFO(g_logger) << "test_fields ok";
+    unlink(path.c_str());
+}
+
+// JSON与文本格式化的开销
+void bench_fields() {
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("fields");
+    const int count = 1000000;
+    sylar::LogEvent bench(__FILE__, __LINE__, 0, 0, "main", 0, sylar::GetCurrentUS(), logger.get(),
+                          sylar::LogLevel::INFO);
+    bench.getBuffer().append("request done", 12);
+    bench.addField("method", "GET").addField("path", "/index").addField("status", 200).addField("cost", 0.25);
+    sylar::LogBuffer out;
+    auto run = [&](const char* pattern) {
+        sylar::LogFormatter formatter(pattern);
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i) {
+            out.clear();
+            formatter.format(out, sylar::LogLevel::INFO, bench);
+        }
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "bench_fields ns/line="
+                  << std::chrono::duration<double, std::nano>(end - begin).count() / count
+                  << " sample=" << out.view();
+    };
+    run(SYLAR_LOG_DEFAULT_PATTERN);
+    run(SYLAR_LOG_JSON_PATTERN);
+}
+
+int main(int argc, char** argv) {
+    test_fields();
+    bench_fields();
+    return 0;
+}
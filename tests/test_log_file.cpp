@@ -0,0 +1,154 @@
+#include <glob.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "src/sylar.h"
+#include "tests/log_fixture.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::vector<std::string> GlobFiles(const std::string& pattern) {
+    std::vector<std::string> files;
+    glob_t g;
+    if (glob(pattern.c_str(), 0, nullptr, &g) == 0) {
+        for (size_t i = 0; i < g.gl_pathc; ++i) {
+            files.push_back(g.gl_pathv[i]);
+        }
+    }
+    globfree(&g);
+    return files;
+}
+
+// 名为name的线程数
+static size_t CountThreads(const std::string& name) {
+    size_t count = 0;
+    for (auto& comm : GlobFiles("/proc/self/task/*/comm")) {
+        std::string str = ReadFile(comm);
+        if (str == name + "\n") {
+            ++count;
+        }
+    }
+    return count;
+}
+
+// 按大小切分: 每个文件不超过阈值, 所有行恰好出现一次, 缓冲写入的系统调用远少于行数
+void test_file_rotate() {
+    for (auto& i : GlobFiles("./rotate.txt*")) {
+        unlink(i.c_str());
+    }
+    const int count = 1000;
+    const uint64_t rotate_size = 16 * 1024;
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("rotate");
+    sylar::FileLogAppender::ptr appender = std::make_shared<sylar::FileLogAppender>("./rotate.txt");
+    appender->setBufferSize(1024);
+    appender->setRotateSize(rotate_size);
+    logger->addAppender(appender);
+
+    uint64_t syscw = write_syscalls();
+    for (int i = 0; i < count; ++i) {
+        SYLAR_LOG_INFO(logger) << "rotate line " << i;
+    }
+    appender->flush();
+    syscw = write_syscalls() - syscw;
+
+    std::vector<std::string> files = GlobFiles("./rotate.txt*");
+    std::vector<int> seen(count, 0);
+    uint64_t total = 0;
+    for (auto& file : files) {
+        struct stat st;
+        SYLAR_ASSERT(stat(file.c_str(), &st) == 0);
+        SYLAR_ASSERT2((uint64_t)st.st_size <= rotate_size, file + " size=" + std::to_string(st.st_size));
+        total += st.st_size;
+        std::ifstream ifs(file);
+        std::string line;
+        while (std::getline(ifs, line)) {
+            size_t pos = line.find("rotate line ");
+            SYLAR_ASSERT2(pos != std::string::npos, file + ": " + line);
+            int n = atoi(line.c_str() + pos + 12);
+            SYLAR_ASSERT(n >= 0 && n < count);
+            ++seen[n];
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        SYLAR_ASSERT2(seen[i] == 1, "line " + std::to_string(i) + " seen " + std::to_string(seen[i]));
+    }
+    // 只在下一行放不下时切分, 除最后一个文件外都接近写满
+    SYLAR_ASSERT(files.size() >= (total + rotate_size - 1) / rotate_size);
+    SYLAR_ASSERT(files.size() <= total / (rotate_size - 256) + 1);
+    SYLAR_ASSERT2(syscw < count / 4, "write_syscalls=" + std::to_string(syscw));
+    SYLAR_LOG_INFO(g_logger) << "test_file_rotate files=" << files.size() << " bytes=" << total
+                             << " write_syscalls=" << syscw;
+    for (auto& i : files) {
+        unlink(i.c_str());
+    }
+}
+
+// 安静的日志器: 缓冲的最后一行没有后续写入触发, 也应在刷新间隔后落盘
+void test_quiet_flush() {
+    const std::string path = "./quiet_flush.txt";
+    unlink(path.c_str());
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("quiet");
+    auto appender = std::make_shared<sylar::FileLogAppender>(path);
+    appender->setFlushInterval(200);
+    logger->addAppender(appender);
+
+    // 第一行立即写入, 第二行留在缓冲区
+    SYLAR_LOG_INFO(logger) << "quiet first";
+    SYLAR_LOG_INFO(logger) << "quiet last";
+    SYLAR_ASSERT(ReadFile(path).find("quiet first") != std::string::npos);
+    SYLAR_ASSERT(ReadFile(path).find("quiet last") == std::string::npos);
+
+    bool found = false;
+    for (int i = 0; i < 200 && !found; ++i) {
+        usleep(10 * 1000);
+        found = ReadFile(path).find("quiet last") != std::string::npos;
+    }
+    SYLAR_ASSERT2(found, "buffered line was not flushed without a further write");
+    SYLAR_LOG_INFO(g_logger) << "test_quiet_flush ok";
+    unlink(path.c_str());
+}
+
+// 最后一个FileLogAppender析构时后台刷新线程及时结束, 再创建时重新启动
+void test_flusher_exit() {
+    const std::string path = "./flusher_exit.txt";
+    unlink(path.c_str());
+    auto appender = std::make_shared<sylar::FileLogAppender>(path);
+    appender->setFlushInterval(100);
+    SYLAR_ASSERT(CountThreads("log_flush") == 1);
+    appender.reset();
+
+    // 析构时通知, 不必等到检查周期(500毫秒)结束
+    size_t threads = 1;
+    for (int i = 0; i < 10 && threads; ++i) {
+        usleep(10 * 1000);
+        threads = CountThreads("log_flush");
+    }
+    SYLAR_ASSERT2(threads == 0, "log_flush thread still running without appenders");
+
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("flusher");
+    appender = std::make_shared<sylar::FileLogAppender>(path);
+    appender->setFlushInterval(100);
+    logger->addAppender(appender);
+    SYLAR_ASSERT(CountThreads("log_flush") == 1);
+    SYLAR_LOG_INFO(logger) << "flusher first";
+    SYLAR_LOG_INFO(logger) << "flusher last";
+    bool found = false;
+    for (int i = 0; i < 200 && !found; ++i) {
+        usleep(10 * 1000);
+        found = ReadFile(path).find("flusher last") != std::string::npos;
+    }
+    SYLAR_ASSERT2(found, "restarted flusher did not flush");
+    SYLAR_LOG_INFO(g_logger) << "test_flusher_exit ok";
+    unlink(path.c_str());
+}
+
+int main(int argc, char** argv) {
+    test_file_rotate();
+    test_quiet_flush();
+    test_flusher_exit();
+    return 0;
+}
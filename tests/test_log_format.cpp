@@ -0,0 +1,114 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include "src/sylar.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 保存最后一条日志内容的输出目标
+class LastLogAppender : public sylar::LogAppender {
+public:
+    void log(sylar::LogLevel::Level level, sylar::LogEvent::ptr event) override {
+        last = event->getContent();
+    }
+
+    std::string toYamlString() override { return ""; }
+
+    std::string last;
+};
+
+template <class... Args>
+static std::string Print(sylar::LogEvent& event, sylar::LogFormatStringT<Args...> fmt, const Args&... args) {
+    event.getBuffer().clear();
+    event.print(fmt, args...);
+    return event.getContent();
+}
+
+static std::string Printf(const char* fmt, ...) {
+    char buf[256];
+    va_list al;
+    va_start(al, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, al);
+    va_end(al);
+    return buf;
+}
+
+// {}格式的输出
+void test_format() {
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("format");
+    sylar::LogEvent event(__FILE__, __LINE__, 0, 0, "main", 0, 0, logger.get(), sylar::LogLevel::INFO);
+    std::string name = "sylar";
+    const char* null_str = nullptr;
+    std::string out = Print(event, "str={} {} {} char={} bool={} int={} {:x} {:X} {:o} {:b} u64={} min={} "
+                            "double={} {:.3f} {:e} {:.2g} ptr={} {{}}",
+                            name, "literal", null_str, 'c', true, -42, 255, 255, 8, 5, UINT64_MAX, INT64_MIN,
+                            0.1, 3.14159, 12345.678, 0.000123, (void*)0x1234);
+    SYLAR_ASSERT2(out == "str=sylar literal (null) char=c bool=true int=-42 ff FF 10 101 "
+                  "u64=18446744073709551615 min=-9223372036854775808 "
+                  "double=0.1 3.142 1.2345678e+04 0.00012 ptr=0x1234 {}", out);
+    SYLAR_ASSERT(Print(event, "no args") == "no args");
+    SYLAR_ASSERT(Print(event, "{{{}}}", 1) == "{1}");
+    SYLAR_ASSERT(Print(event, "{}{}", false, std::string_view("sv")) == "falsesv");
+
+    // 整数与指定精度的浮点数与printf一致
+    for (int64_t v : {(int64_t)0, (int64_t)1, (int64_t)-1, (int64_t)INT32_MAX, (int64_t)INT32_MIN,
+                      (int64_t)1234567890123LL, INT64_MAX}) {
+        SYLAR_ASSERT(Print(event, "{} {:x} {:o}", v, (uint64_t)v, (uint64_t)v)
+                     == Printf("%ld %lx %lo", (long)v, (unsigned long)v, (unsigned long)v));
+    }
+    SYLAR_ASSERT(Print(event, "{:x} {:X} {:o} {:b} {:X}", -255, -255, -255, -3, UINT64_MAX)
+                 == "-ff -FF -377 -11 FFFFFFFFFFFFFFFF");
+    SYLAR_ASSERT(Print(event, "{:x} {}", INT64_MIN, INT64_MIN) == "-8000000000000000 -9223372036854775808");
+    for (double v : {0.0, -0.0, 0.5, 1.005, -2.675, 123456.789, 1e-7, 9.9999, 1e15}) {
+        SYLAR_ASSERT2(Print(event, "{:.3f} {:.0f} {:.2e}", v, v, v) == Printf("%.3f %.0f %.2e", v, v, v),
+                      Print(event, "{:.3f} {:.0f} {:.2e}", v, v, v));
+    }
+
+    // 宏只在级别满足时求值并输出
+    auto appender = std::make_shared<LastLogAppender>();
+    logger->addAppender(appender);
+    SYLAR_LOG_FORMAT_INFO(logger, "no args");
+    SYLAR_ASSERT(appender->last == "no args");
+    SYLAR_LOG_FORMAT_INFO(logger, "name={} cost={:.3f}ms", name, 1.5);
+    SYLAR_ASSERT(appender->last == "name=sylar cost=1.500ms");
+    logger->setLevel(sylar::LogLevel::ERROR);
+    int evaluated = 0;
+    SYLAR_LOG_FORMAT_INFO(logger, "skipped {}", ++evaluated);
+    SYLAR_ASSERT(evaluated == 0 && appender->last == "name=sylar cost=1.500ms");
+    SYLAR_LOG_INFO(g_logger) << "test_format ok";
+}
+
+// 每行开销, 与printf格式对比
+void bench_format() {
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("format");
+    sylar::LogEvent event(__FILE__, __LINE__, 0, 0, "main", 0, 0, logger.get(), sylar::LogLevel::INFO);
+    const int count = 1000000;
+    auto run = [&](const char* name, const std::function<void(sylar::LogEvent&, int)>& cb) {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i) {
+            event.getBuffer().clear();
+            cb(event, i);
+        }
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "bench_format " << name << " ns/line="
+                  << std::chrono::duration<double, std::nano>(end - begin).count() / count
+                  << " sample=" << event.getContentView() << std::endl;
+    };
+    run("printf", [](sylar::LogEvent& event, int i) {
+        event.format("request %s id=%d size=%lu cost=%.3fms", "GET /index", i, (unsigned long)i * 1024, i * 0.5);
+    });
+    run("braces", [](sylar::LogEvent& event, int i) {
+        event.print("request {} id={} size={} cost={:.3f}ms", "GET /index", i, (unsigned long)i * 1024, i * 0.5);
+    });
+}
+
+int main(int argc, char** argv) {
+    test_format();
+    bench_format();
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "src/sylar.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 按名称与按预先计算的哈希查找返回同一个日志器, 先用哪种方式创建都一样
+void test_logger_lookup() {
+    for (int i = 0; i < 100; ++i) {
+        std::string name = "lookup_" + std::to_string(i);
+        sylar::Logger::ptr logger = SYLAR_LOG_NAME(name);
+        SYLAR_ASSERT(logger && logger->getName() == name);
+        SYLAR_ASSERT(SYLAR_LOG_NAME(name) == logger);
+        SYLAR_ASSERT(sylar::LoggerMgr::GetInstance()->getLogger(sylar::LogNameHash(name), name) == logger);
+    }
+    sylar::Logger::ptr hashed = SYLAR_LOG_NAME_HASHED("lookup_hashed_first");
+    SYLAR_ASSERT(hashed && hashed->getName() == "lookup_hashed_first");
+    SYLAR_ASSERT(SYLAR_LOG_NAME("lookup_hashed_first") == hashed);
+    SYLAR_ASSERT(SYLAR_LOG_NAME_HASHED("lookup_42") == SYLAR_LOG_NAME("lookup_42"));
+    SYLAR_ASSERT(SYLAR_LOG_NAME_HASHED("root") == SYLAR_LOG_ROOT());
+    SYLAR_ASSERT(SYLAR_LOG_NAME("root") == SYLAR_LOG_ROOT());
+    SYLAR_LOG_INFO(g_logger) << "test_logger_lookup ok";
+}
+
+// 多线程同时创建与查找, 每个名字只创建一个日志器
+void test_concurrent_lookup() {
+    const int thread_num = 8;
+    const int name_num = 1000;
+    std::vector<std::vector<sylar::Logger*>> found(thread_num, std::vector<sylar::Logger*>(name_num));
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < thread_num; ++i) {
+        thrs.emplace_back(std::make_shared<sylar::Thread>([&found, i, name_num]() {
+            for (int j = 0; j < name_num; ++j) {
+                // 一半线程正序一半倒序, 让创建与查找交错
+                int n = i % 2 ? j : name_num - 1 - j;
+                std::string name = "concurrent_" + std::to_string(n);
+                sylar::Logger::ptr logger = j % 2 ? SYLAR_LOG_NAME(name)
+                    : sylar::LoggerMgr::GetInstance()->getLogger(sylar::LogNameHash(name), name);
+                SYLAR_ASSERT(logger->getName() == name);
+                found[i][n] = logger.get();
+            }
+        }, "lookup_" + std::to_string(i)));
+    }
+    for (auto& thr : thrs) {
+        thr->join();
+    }
+    for (int j = 0; j < name_num; ++j) {
+        for (int i = 1; i < thread_num; ++i) {
+            SYLAR_ASSERT(found[i][j] == found[0][j]);
+        }
+    }
+    SYLAR_LOG_INFO(g_logger) << "test_concurrent_lookup ok";
+}
+
+// 按名称查找日志器的开销
+void bench_logger_lookup() {
+    const int count = 1000000;
+    auto run = [&](const char* name, const std::function<sylar::Logger::ptr()>& cb) {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i) {
+            cb();
+        }
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "bench_logger_lookup " << name << " ns/lookup="
+                  << std::chrono::duration<double, std::nano>(end - begin).count() / count
+                  << " logger=" << cb()->getName() << std::endl;
+    };
+    run("name", []() { return SYLAR_LOG_NAME("lookup_42"); });
+    run("hashed", []() { return SYLAR_LOG_NAME_HASHED("lookup_42"); });
+}
+
+int main(int argc, char** argv) {
+    test_logger_lookup();
+    test_concurrent_lookup();
+    bench_logger_lookup();
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "src/sylar.h"
+#include "tests/log_fixture.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 多线程不经过Logger直接写入, 频繁切换映射, 每行恰好出现一次且没有零字节
+void test_mmap_concurrent() {
+    const std::string path = "./mmap_concurrent.txt";
+    unlink(path.c_str());
+    const int thread_num = 4;
+    const int count = 100000;
+    {
+        sylar::MmapLogAppender::ptr appender = std::make_shared<sylar::MmapLogAppender>(path, 4096);
+        std::vector<sylar::Thread::ptr> thrs;
+        for (int i = 0; i < thread_num; ++i) {
+            thrs.emplace_back(std::make_shared<sylar::Thread>([appender, count, i]() {
+                for (int j = 0; j < count; ++j) {
+                    std::string line = "thread " + std::to_string(i) + " line " + std::to_string(j) + "\n";
+                    appender->write(line.data(), line.size());
+                }
+            }, "mmap_" + std::to_string(i)));
+        }
+        for (auto& thr : thrs) {
+            thr->join();
+        }
+        SYLAR_ASSERT(appender->getDropped() == 0);
+    }
+
+    std::string content = ReadFile(path);
+    SYLAR_ASSERT(content.find('\0') == std::string::npos);
+    std::set<std::string> lines;
+    std::istringstream iss(content);
+    std::string line;
+    while (std::getline(iss, line)) {
+        SYLAR_ASSERT2(lines.insert(line).second, line);
+    }
+    SYLAR_ASSERT(lines.size() == (size_t)thread_num * count);
+    SYLAR_LOG_INFO(g_logger) << "test_mmap_concurrent ok";
+    unlink(path.c_str());
+}
+
+// 子进程写入后直接abort, 已写入的日志应全部保留, 重新打开后接着写
+void test_mmap_crash() {
+    const std::string path = "./mmap_crash.txt";
+    unlink(path.c_str());
+    const int count = 10000;
+    pid_t pid = fork();
+    if (pid == 0) {
+        sylar::MmapLogAppender::ptr appender = std::make_shared<sylar::MmapLogAppender>(path, 64 * 1024);
+        for (int i = 0; i < count; ++i) {
+            std::string line = "crash line " + std::to_string(i) + "\n";
+            appender->write(line.data(), line.size());
+        }
+        abort();
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    SYLAR_ASSERT(WIFSIGNALED(status));
+    {
+        sylar::MmapLogAppender::ptr appender = std::make_shared<sylar::MmapLogAppender>(path, 64 * 1024);
+        appender->write("restart\n", 8);
+    }
+
+    std::string content = ReadFile(path);
+    SYLAR_ASSERT(content.find('\0') == std::string::npos);
+    std::istringstream iss(content);
+    std::string line;
+    int i = 0;
+    for (; i < count; ++i) {
+        SYLAR_ASSERT(std::getline(iss, line));
+        SYLAR_ASSERT2(line == "crash line " + std::to_string(i), line);
+    }
+    SYLAR_ASSERT(std::getline(iss, line) && line == "restart");
+    SYLAR_ASSERT(!std::getline(iss, line));
+    SYLAR_LOG_INFO(g_logger) << "test_mmap_crash ok";
+    unlink(path.c_str());
+}
+
+// 文件与mmap两种Appender的吞吐, 释放Appender后每行都已写入
+void bench_appender(const std::string& name, const std::string& path, int thread_num,
+                    std::function<sylar::LogAppender::ptr()> create) {
+    const int count = 200000;
+    unlink(path.c_str());
+    uint64_t syscw = 0;
+    {
+        sylar::Logger::ptr logger = std::make_shared<sylar::Logger>(name);
+        logger->setFormatter("%t %m%n");
+        logger->addAppender(create());
+
+        syscw = write_syscalls();
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<sylar::Thread::ptr> thrs;
+        for (int i = 0; i < thread_num; ++i) {
+            thrs.emplace_back(std::make_shared<sylar::Thread>([logger, count]() {
+                for (int j = 0; j < count; ++j) {
+                    SYLAR_LOG_INFO(logger) << "bench file line " << j;
+                }
+            }, name + "_" + std::to_string(i)));
+        }
+        for (auto& thr : thrs) {
+            thr->join();
+        }
+        auto end = std::chrono::steady_clock::now();
+        syscw = write_syscalls() - syscw;
+        std::cout << "bench_appender " << name << " threads=" << thread_num << " logs/sec="
+                  << (uint64_t)(count * thread_num / std::chrono::duration<double>(end - begin).count())
+                  << " write_syscalls=" << syscw << std::endl;
+    }
+
+    std::string content = ReadFile(path);
+    SYLAR_ASSERT(content.find('\0') == std::string::npos);
+    std::set<std::string> lines;
+    std::istringstream iss(content);
+    std::string line;
+    while (std::getline(iss, line)) {
+        SYLAR_ASSERT2(lines.insert(line).second, line);
+    }
+    SYLAR_ASSERT2(lines.size() == (size_t)thread_num * count, name + " lines=" + std::to_string(lines.size()));
+    unlink(path.c_str());
+}
+
+int main(int argc, char** argv) {
+    test_mmap_concurrent();
+    test_mmap_crash();
+    for (int thread_num : {1, 4}) {
+        bench_appender("file", "./bench_file.txt", thread_num, []() {
+            return std::make_shared<sylar::FileLogAppender>("./bench_file.txt");
+        });
+        bench_appender("mmap", "./bench_mmap.txt", thread_num, []() {
+            return std::make_shared<sylar::MmapLogAppender>("./bench_mmap.txt", 1024 * 1024);
+        });
+    }
+    return 0;
+}
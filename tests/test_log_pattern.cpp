@@ -0,0 +1,100 @@
+#include <string.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "src/sylar.h"
+#include "tests/log_fixture.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::string Format(const sylar::LogFormatter& fmt, sylar::LogLevel::Level level,
+                          const sylar::LogEvent& event) {
+    sylar::LogBuffer buffer;
+    fmt.format(buffer, level, event);
+    return std::string(buffer.view());
+}
+
+// 编译期展开的模板与操作码程序输出一致:
+// 模板末尾追加"%%"即不再命中展开, 输出只多一个'%'
+void test_compiled_pattern() {
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("pattern");
+    const char* patterns[] = {
+        SYLAR_LOG_DEFAULT_PATTERN,
+        "%d{%Y-%m-%d %H:%M:%S}%T%m%n",
+        "%m%n",
+        SYLAR_LOG_JSON_PATTERN,
+    };
+    const char* contents[] = {"", "hello", "quote\" backslash\\ tab\t newline\n", "中文内容"};
+    uint64_t times[] = {0, 1700000000123456ULL, 1999999999999999ULL};
+    for (const char* pattern : patterns) {
+        sylar::LogFormatter compiled(pattern);
+        sylar::LogFormatter program(std::string(pattern) + "%%");
+        SYLAR_ASSERT2(compiled.isCompiled(), pattern);
+        SYLAR_ASSERT2(!program.isCompiled(), pattern);
+        SYLAR_ASSERT(!compiled.isError() && !program.isError());
+        for (const char* content : contents) {
+            for (uint64_t time : times) {
+                for (auto level : {sylar::LogLevel::DEBUG, sylar::LogLevel::ERROR}) {
+                    sylar::LogEvent event(__FILE__, __LINE__, 123, 4567, "pattern_thread", 89, time,
+                                          logger.get(), level);
+                    event.getBuffer().append(content, strlen(content));
+                    event.addField("id", 42).addField("name", "v\"1");
+                    std::string expect = Format(compiled, level, event) + "%";
+                    std::string actual = Format(program, level, event);
+                    SYLAR_ASSERT2(expect == actual, "pattern=" + std::string(pattern)
+                                  + "\ncompiled=" + expect + "\nprogram=" + actual);
+                }
+            }
+        }
+    }
+    SYLAR_LOG_INFO(g_logger) << "test_compiled_pattern ok";
+}
+
+void test_pattern_error() {
+    SYLAR_ASSERT(sylar::LogFormatter("%d%T%p%T%m%n").isCompiled() == false);
+    SYLAR_ASSERT(!sylar::LogFormatter("%d%T%p%T%m%n").isError());
+    SYLAR_ASSERT(sylar::LogFormatter("%d{%Y").isError());
+    SYLAR_LOG_INFO(g_logger) << "test_pattern_error ok";
+}
+
+void bench_log(const std::string& name, int thread_num, const std::string& pattern) {
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>(name);
+    sylar::LogAppender::ptr appender = std::make_shared<NullLogAppender>();
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>(pattern));
+    logger->addAppender(appender);
+
+    const int count = 200000;
+    std::vector<sylar::Thread::ptr> thrs;
+    std::vector<double> rates(thread_num);
+    for (int i = 0; i < thread_num; ++i) {
+        thrs.emplace_back(std::make_shared<sylar::Thread>([logger, count, &rates, i]() {
+            auto begin = std::chrono::steady_clock::now();
+            for (int j = 0; j < count; ++j) {
+                SYLAR_LOG_INFO(logger) << "bench log line " << j << " value=" << 3.14;
+            }
+            auto end = std::chrono::steady_clock::now();
+            rates[i] = count / std::chrono::duration<double>(end - begin).count();
+        }, name + "_" + std::to_string(i)));
+    }
+    double total = 0;
+    for (int i = 0; i < thread_num; ++i) {
+        thrs[i]->join();
+        total += rates[i];
+    }
+    std::cout << "bench_log " << name << " threads=" << thread_num
+              << " logs/sec/thread=" << (uint64_t)(total / thread_num) << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_compiled_pattern();
+    test_pattern_error();
+    for (int thread_num : {1, 4}) {
+        bench_log("compiled", thread_num, SYLAR_LOG_DEFAULT_PATTERN);
+        // 与默认模板等价但未编译期展开, 走操作码程序
+        bench_log("program", thread_num, std::string(SYLAR_LOG_DEFAULT_PATTERN) + "%%");
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "src/sylar.h"
+#include "tests/log_fixture.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 记录输出内容的输出目标, 区分普通日志与被抑制条数的摘要, count只计普通日志
+class SummaryLogAppender : public CountLogAppender {
+public:
+    void log(sylar::LogLevel::Level level, sylar::LogEvent::ptr event) override {
+        MutexType::Lock lock(m_mutex);
+        std::string content = event->getContent();
+        if (content.compare(0, 11, "suppressed ") == 0) {
+            suppressed += atoll(content.c_str() + 11);
+            ++summaries;
+        } else {
+            ++count;
+        }
+        last = content;
+    }
+
+    void reset() {
+        MutexType::Lock lock(m_mutex);
+        count = summaries = suppressed = 0;
+        last.clear();
+    }
+
+    uint64_t summaries = 0;   // 摘要条数
+    uint64_t suppressed = 0;  // 摘要报告的被抑制条数之和
+    std::string last;
+};
+
+// 同一个调用点
+static void flood(sylar::Logger::ptr logger, int i) {
+    SYLAR_LOG_ERROR(logger) << "flood " << i;
+}
+
+static double run(sylar::Logger::ptr logger, int thread_num, int count) {
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < thread_num; ++i) {
+        thrs.emplace_back(std::make_shared<sylar::Thread>([logger, count]() {
+            for (int j = 0; j < count; ++j) {
+                flood(logger, j);
+            }
+        }, "flood_" + std::to_string(i)));
+    }
+    for (auto& thr : thrs) {
+        thr->join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+// 按logs配置对调用点限流与采样, 放行时先输出被抑制条数的摘要
+void test_rate_limit() {
+    YAML::Node root = YAML::Load(R"(
+logs:
+    - name: limited
+      level: debug
+      rate_limit: 100
+      burst: 10
+      appenders:
+          - type: StdoutLogAppender
+    - name: sampled
+      level: debug
+      sample: 0.1
+      appenders:
+          - type: StdoutLogAppender
+)");
+    sylar::Config::LoadFromYaml(root);
+
+    sylar::Logger::ptr limited = SYLAR_LOG_NAME("limited");
+    SYLAR_ASSERT(limited->getRateLimit() == 100 && limited->getBurst() == 10);
+    auto appender = std::make_shared<SummaryLogAppender>();
+    limited->clearAppenders();
+    limited->addAppender(appender);
+
+    // 突发放行burst条, 之后按速率放行
+    const int thread_num = 4;
+    const int count = 100000;
+    double seconds = run(limited, thread_num, count);
+    uint64_t passed = appender->count;
+    std::cout << "test_rate_limit limited passed=" << passed << "/" << thread_num * count
+              << " seconds=" << seconds << " ns/call=" << seconds * 1e9 / thread_num / count << std::endl;
+    SYLAR_ASSERT2(passed >= 10 && passed <= 10 + 100 * seconds + 1, "passed=" + std::to_string(passed));
+    // 摘要每秒最多一条, 首次抑制前没有可报告的
+    SYLAR_ASSERT(appender->summaries <= seconds + 1);
+
+    // 令牌恢复后放行, 先输出摘要, 被抑制的条数都有报告
+    usleep(1000 * 1000);
+    run(limited, 1, 1);
+    SYLAR_ASSERT(appender->count == passed + 1);
+    SYLAR_ASSERT(appender->last == "flood 0");
+    SYLAR_ASSERT2(appender->suppressed == thread_num * count - passed,
+                  "suppressed=" + std::to_string(appender->suppressed));
+
+    // 采样放行约10%
+    sylar::Logger::ptr sampled = SYLAR_LOG_NAME("sampled");
+    SYLAR_ASSERT(sampled->getSample() == 0.1);
+    sampled->clearAppenders();
+    sampled->addAppender(appender);
+    appender->reset();
+    seconds = run(sampled, 1, count);
+    std::cout << "test_rate_limit sampled passed=" << appender->count << "/" << count
+              << " seconds=" << seconds << " ns/call=" << seconds * 1e9 / count << std::endl;
+    SYLAR_ASSERT2(appender->count > count / 10 * 0.9 && appender->count < count / 10 * 1.1,
+                  "passed=" + std::to_string(appender->count));
+    SYLAR_ASSERT(appender->suppressed <= count - appender->count);
+
+    // 关闭后全部放行
+    limited->setRateLimit(0);
+    appender->reset();
+    run(limited, 1, 1000);
+    SYLAR_ASSERT(appender->count == 1000);
+    SYLAR_LOG_INFO(g_logger) << "test_rate_limit ok";
+}
+
+int main(int argc, char** argv) {
+    test_rate_limit();
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <string.h>
+#include <time.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include "src/sylar.h"
+#include "src/log_pattern.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 不经缓存的参照实现: 亚秒占位符替换为数字后整体交给strftime
+static std::string StrftimeUs(uint64_t us, const std::string& fmt) {
+    std::string out;
+    for (size_t i = 0; i < fmt.size(); ++i) {
+        if (fmt[i] != '%' || i + 1 == fmt.size()) {
+            out += fmt[i];
+            continue;
+        }
+        int digits = 0;
+        if (fmt[i + 1] == 'f') {
+            digits = 6;
+            i += 1;
+        } else if ((fmt[i + 1] == '3' || fmt[i + 1] == '6') && i + 2 < fmt.size() && fmt[i + 2] == 'f') {
+            digits = fmt[i + 1] - '0';
+            i += 2;
+        } else {
+            out += fmt[i];
+            out += fmt[++i];
+            continue;
+        }
+        char buf[16];
+        if (digits == 3) {
+            snprintf(buf, sizeof(buf), "%03u", (unsigned)(us % 1000000 / 1000));
+        } else {
+            snprintf(buf, sizeof(buf), "%06u", (unsigned)(us % 1000000));
+        }
+        out += buf;
+    }
+    struct tm tm;
+    time_t t = us / 1000000;
+    localtime_r(&t, &tm);
+    char buf[256];
+    return std::string(buf, strftime(buf, sizeof(buf), out.c_str(), &tm));
+}
+
+// 缓存的渲染结果与strftime一致: 同一秒内, 跨秒, 时间回退, 多个格式轮换淘汰缓存
+void test_time_cache() {
+    const char* fmts[] = {
+        "%Y-%m-%d %H:%M:%S",
+        "%Y-%m-%d %H:%M:%S.%3f",
+        "%H:%M:%S.%6f",
+        "%H:%M:%S.%f %%f %j",
+        "[%a %b %d] %3f|%6f",
+        "%s",
+    };
+    uint64_t base = sylar::GetCurrentUS();
+    int64_t steps[] = {0, 1, 999, 1000, 999999, 1000000, -1, -1000000, 86400000000LL, -86400000000LL * 200};
+    uint64_t us = base;
+    sylar::LogBuffer buffer;
+    for (int round = 0; round < 1000; ++round) {
+        us += steps[round % (sizeof(steps) / sizeof(steps[0]))] + round * 7;
+        for (size_t i = 0; i < sizeof(fmts) / sizeof(fmts[0]); ++i) {
+            // 格式数多于缓存槽位, 轮换使用以触发淘汰
+            const char* fmt = fmts[(i + round / 3) % (sizeof(fmts) / sizeof(fmts[0]))];
+            buffer.clear();
+            sylar::LogAppendTime(buffer, us, fmt, strlen(fmt));
+            std::string expect = StrftimeUs(us, fmt);
+            SYLAR_ASSERT2(buffer.view() == expect, std::string("fmt=") + fmt + " us=" + std::to_string(us)
+                          + " cached=" + std::string(buffer.view()) + " strftime=" + expect);
+        }
+    }
+
+    // 过长的格式不缓存, 仍按strftime输出
+    std::string longfmt(sylar::LogBuffer::INLINE_SIZE / 2, 'x');
+    longfmt += "%Y";
+    buffer.clear();
+    sylar::LogAppendTime(buffer, base, longfmt.c_str(), longfmt.size());
+    SYLAR_ASSERT(buffer.view() == StrftimeUs(base, longfmt));
+    SYLAR_LOG_INFO(g_logger) << "test_time_cache ok";
+}
+
+// 模拟每秒100万条日志(相邻事件相差1微秒), 比较逐条strftime与缓存渲染
+void bench_time() {
+    const int count = 1000000;
+    uint64_t base = sylar::GetCurrentUS();
+    sylar::LogBuffer buffer;
+
+    auto run = [&](const char* name, const std::function<void(uint64_t)>& cb) {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i) {
+            buffer.clear();
+            cb(base + i);
+        }
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "bench_time " << name << " events/sec="
+                  << (uint64_t)(count / std::chrono::duration<double>(end - begin).count())
+                  << " sample=" << buffer.view() << std::endl;
+    };
+    run("strftime", [&](uint64_t us) {
+        struct tm tm;
+        time_t t = us / 1000000;
+        localtime_r(&t, &tm);
+        char buf[64];
+        buffer.append(buf, strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm));
+    });
+    const char* fmt = "%Y-%m-%d %H:%M:%S";
+    run("cached", [&](uint64_t us) { sylar::LogAppendTime(buffer, us, fmt, strlen(fmt)); });
+    const char* fmt_ms = "%Y-%m-%d %H:%M:%S.%3f";
+    run("cached_ms", [&](uint64_t us) { sylar::LogAppendTime(buffer, us, fmt_ms, strlen(fmt_ms)); });
+    const char* fmt_us = "%Y-%m-%d %H:%M:%S.%6f";
+    run("cached_us", [&](uint64_t us) { sylar::LogAppendTime(buffer, us, fmt_us, strlen(fmt_us)); });
+}
+
+int main(int argc, char** argv) {
+    test_time_cache();
+    bench_time();
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <unistd.h>
+
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+#include "src/sylar.h"
+#include "tests/log_fixture.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+struct Snapshot {
+    static const uint64_t MAGIC = 0x5a5a5a5a5a5a5a5aULL;
+    uint64_t magic = MAGIC;
+    uint64_t value = 0;
+};
+
+static std::atomic<Snapshot*> s_snapshot{new Snapshot};
+
+// 读者在临界区内反复读取快照, 写者不断替换并回收旧快照; 回收时先清除magic,
+// 读者读到已回收的快照即失败
+void test_rcu_reclaim() {
+    const int writes = 200000;
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> reads{0};
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < 2; ++i) {
+        thrs.emplace_back(std::make_shared<sylar::Thread>([&stop, &reads]() {
+            uint64_t last = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                sylar::RcuReadLock lock;
+                Snapshot* snapshot = s_snapshot.load(std::memory_order_acquire);
+                SYLAR_ASSERT(snapshot->magic == Snapshot::MAGIC);
+                SYLAR_ASSERT(snapshot->value >= last);
+                last = snapshot->value;
+                reads.fetch_add(1, std::memory_order_relaxed);
+            }
+        }, "rcu_reader_" + std::to_string(i)));
+    }
+    for (int i = 1; i <= writes; ++i) {
+        Snapshot* snapshot = new Snapshot;
+        snapshot->value = i;
+        Snapshot* old = s_snapshot.exchange(snapshot, std::memory_order_acq_rel);
+        sylar::RcuRetire([old]() {
+            old->magic = 0;
+            delete old;
+        });
+    }
+    stop = true;
+    for (auto& thr : thrs) {
+        thr->join();
+    }
+    sylar::RcuReclaim();
+    SYLAR_LOG_INFO(g_logger) << "test_rcu_reclaim ok writes=" << writes << " reads=" << reads;
+}
+
+// 日志线程无锁遍历Appender快照, 同时另一个线程反复替换Appender; 旧快照延迟回收
+void test_logger_update() {
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("update");
+    logger->addAppender(std::make_shared<CountLogAppender>());
+    std::atomic<bool> stop{false};
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < 2; ++i) {
+        thrs.emplace_back(std::make_shared<sylar::Thread>([logger, &stop]() {
+            while (!stop) {
+                SYLAR_LOG_INFO(logger) << "update";
+            }
+        }, "update_" + std::to_string(i)));
+    }
+    for (int i = 0; i < 10000; ++i) {
+        logger->clearAppenders();
+        logger->addAppender(std::make_shared<CountLogAppender>());
+        if (i % 100 == 0) {
+            logger->setFormatter("%m%n");
+        }
+    }
+    stop = true;
+    for (auto& thr : thrs) {
+        thr->join();
+    }
+    sylar::RcuReclaim();
+    // 没有读者后旧快照全部回收, 只剩当前的一个Appender
+    SYLAR_ASSERT(CountLogAppender::s_total > 0);
+    SYLAR_ASSERT(CountLogAppender::s_alive == 1);
+    SYLAR_LOG_INFO(g_logger) << "test_logger_update ok events=" << CountLogAppender::s_total;
+}
+
+// 另一个线程持续写日志时移除Appender, 之后不再有任何修改, 旧Appender也应被析构
+void test_remove_appender() {
+    sylar::Logger::ptr logger = std::make_shared<sylar::Logger>("remove");
+    std::atomic<bool> stop{false};
+    sylar::Thread::ptr thr = std::make_shared<sylar::Thread>([logger, &stop]() {
+        while (!stop) {
+            SYLAR_LOG_INFO(logger) << "remove";
+        }
+    }, "remove");
+    for (int i = 0; i < 100; ++i) {
+        int alive = CountLogAppender::s_alive;
+        auto appender = std::make_shared<CountLogAppender>();
+        logger->addAppender(appender);
+        usleep(1000);
+        logger->delAppender(appender);
+        appender.reset();
+        bool destroyed = false;
+        for (int j = 0; j < 200 && !destroyed; ++j) {
+            destroyed = CountLogAppender::s_alive == alive;
+            if (!destroyed) {
+                usleep(10 * 1000);
+            }
+        }
+        SYLAR_ASSERT2(destroyed, "removed appender still alive after 2s, round " + std::to_string(i));
+    }
+    stop = true;
+    thr->join();
+    SYLAR_LOG_INFO(g_logger) << "test_remove_appender ok";
+}
+
+int main(int argc, char** argv) {
+    test_rcu_reclaim();
+    test_logger_update();
+    test_remove_appender();
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include <stdio.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include "src/sylar.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+sylar::Task<int> add(int a, int b) {
+    co_return a + b;
+}
+
+sylar::Task<int> compute(sylar::Scheduler* sc) {
+    co_await sylar::SwitchTo(sc);
+    int sum = co_await add(1, 2);
+    // 在Fiber中执行, 可以让出
+    int fiber_value = co_await sylar::RunInFiber(sc, []() {
+        sylar::Fiber::YieldToReady();
+        return 40;
+    });
+    SYLAR_LOG_INFO(g_logger) << "compute sum=" << sum << " fiber_value=" << fiber_value;
+    co_return sum + fiber_value;
+}
+
+sylar::Task<void> spawned(sylar::Scheduler* sc, int id) {
+    int value = co_await compute(sc);
+    SYLAR_LOG_INFO(g_logger) << "spawned id=" << id << " value=" << value;
+}
+
+void test_task() {
+    sylar::Scheduler sc(2, false, "task");
+    sc.start();
+    sc.schedule([&sc]() {
+        // Fiber等待Task
+        int value = sylar::Await(compute(&sc));
+        SYLAR_LOG_INFO(g_logger) << "fiber await value=" << value;
+        SYLAR_ASSERT(value == 43);
+    });
+    sylar::Spawn(&sc, spawned(&sc, 1));
+    sylar::Spawn(&sc, spawned(&sc, 2));
+    sc.stop();
+    SYLAR_ASSERT(sylar::TaskPromiseBase::TotalFrames() == 0);
+}
+
+// 收集system日志中的异常输出
+class ExceptLogAppender : public sylar::LogAppender {
+public:
+    void log(sylar::LogLevel::Level level, sylar::LogEvent::ptr event) override {
+        if (level == sylar::LogLevel::ERROR) {
+            MutexType::Lock lock(m_mutex);
+            contents.push_back(event->getContent());
+        }
+    }
+
+    std::string toYamlString() override { return ""; }
+
+    std::vector<std::string> contents;
+};
+
+sylar::Task<void> throwing(sylar::Scheduler* sc) {
+    co_await compute(sc);
+    throw std::runtime_error("task failed");
+}
+
+sylar::Task<void> throwing_other() {
+    throw 42;
+    co_return;
+}
+
+void test_spawn_except() {
+    auto appender = std::make_shared<ExceptLogAppender>();
+    auto system_logger = SYLAR_LOG_NAME("system");
+    system_logger->addAppender(appender);
+    {
+        sylar::Scheduler sc(2, false, "task");
+        sc.start();
+        sylar::Spawn(&sc, throwing(&sc));
+        sylar::Spawn(&sc, throwing_other());
+        sc.stop();
+    }
+    system_logger->delAppender(appender);
+    SYLAR_ASSERT(sylar::TaskPromiseBase::TotalFrames() == 0);
+    SYLAR_ASSERT2(appender->contents.size() == 2, std::to_string(appender->contents.size()));
+    size_t with_what = 0;
+    size_t unknown = 0;
+    for (auto& content : appender->contents) {
+        if (content.rfind("Task Except: task failed\n", 0) == 0) {
+            ++with_what;
+        } else if (content == "Task Except") {
+            ++unknown;
+        }
+    }
+    SYLAR_ASSERT(with_what == 1 && unknown == 1);
+    SYLAR_LOG_INFO(g_logger) << "test_spawn_except ok";
+}
+
+// 挂起点: 保存句柄, 由外部统一恢复
+struct Park {
+    std::vector<std::coroutine_handle<>>* handles;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) { handles->push_back(handle); }
+    void await_resume() const noexcept {}
+};
+
+sylar::Task<void> parked(std::vector<std::coroutine_handle<>>* handles) {
+    co_await Park{handles};
+}
+
+static size_t rss_bytes() {
+    long pages = 0;
+    long rss = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp) {
+        if (fscanf(fp, "%ld %ld", &pages, &rss) != 2) {
+            rss = 0;
+        }
+        fclose(fp);
+    }
+    return rss * sysconf(_SC_PAGESIZE);
+}
+
+void bench_memory() {
+    const size_t count = 10000;
+    const size_t stacksize = 128 * 1024;
+
+    std::vector<std::coroutine_handle<>> handles;
+    std::vector<sylar::Task<void>> tasks;
+    tasks.reserve(count);
+    handles.reserve(count);
+    size_t rss_begin = rss_bytes();
+    for (size_t i = 0; i < count; ++i) {
+        tasks.emplace_back(parked(&handles));
+        tasks.back().start();
+    }
+    size_t rss_task = rss_bytes() - rss_begin;
+    SYLAR_LOG_INFO(g_logger) << "task: " << count << " suspended, frame="
+                             << sylar::TaskPromiseBase::TotalFrameBytes() / count << " bytes/task"
+                             << " rss=" << rss_task / count << " bytes/task";
+    for (auto& handle : handles) {
+        handle.resume();
+    }
+    tasks.clear();
+
+    sylar::Fiber::GetThis();
+    std::vector<sylar::Fiber::ptr> fibers;
+    fibers.reserve(count);
+    rss_begin = rss_bytes();
+    for (size_t i = 0; i < count; ++i) {
+        fibers.emplace_back(std::make_shared<sylar::Fiber>([]() { sylar::Fiber::YieldToHold(); }, stacksize));
+        fibers.back()->swapIn();
+    }
+    size_t rss_fiber = rss_bytes() - rss_begin;
+    SYLAR_LOG_INFO(g_logger) << "fiber: " << count << " suspended, reserved="
+                             << sizeof(sylar::Fiber) + stacksize << " bytes/fiber"
+                             << " rss=" << rss_fiber / count << " bytes/fiber";
+    for (auto& fiber : fibers) {
+        fiber->swapIn();
+    }
+}
+
+int main(int argc, char** argv) {
+    test_task();
+    test_spawn_except();
+    bench_memory();
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <iostream>
 
 #include "src/sylar.h"
@@ -72,8 +73,47 @@ void test_mutex() {
     SYLAR_LOG_INFO(g_logger) << "count=" << count;
 }
 
+void test_async_log() {
+    sylar::Config::Lookup<bool>("log.async.enable")->setValue(true);
+    sylar::Logger::ptr logger = SYLAR_LOG_NAME("async");
+    logger->addAppender(std::make_shared<sylar::FileLogAppender>("async_log.txt"));
+
+    const int thread_num = 4;
+    const int count = 100000;
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < thread_num; ++i) {
+        thrs.emplace_back(std::make_shared<sylar::Thread>([logger, count]() {
+            for (int j = 0; j < count; ++j) {
+                SYLAR_LOG_INFO(logger) << "async log " << j;
+            }
+        }, "async_" + std::to_string(i)));
+    }
+    for (auto& thr : thrs) {
+        thr->join();
+    }
+    auto pushed = std::chrono::steady_clock::now();
+    sylar::AsyncLogMgr::GetInstance()->flush();
+    auto flushed = std::chrono::steady_clock::now();
+
+    sylar::AsyncLogManager* async = sylar::AsyncLogMgr::GetInstance();
+    SYLAR_LOG_INFO(g_logger) << "async log threads=" << thread_num << " count=" << count
+                             << " push=" << std::chrono::duration<double, std::milli>(pushed - begin).count() << "ms"
+                             << " flush=" << std::chrono::duration<double, std::milli>(flushed - begin).count() << "ms"
+                             << " pushed=" << async->getPushed()
+                             << " written=" << async->getWritten()
+                             << " dropped=" << async->getDropped()
+                             << " blocked=" << async->getBlocked();
+    // 默认BLOCK策略不丢弃, flush返回时已全部输出
+    SYLAR_ASSERT(async->getDropped() == 0);
+    SYLAR_ASSERT(async->getWritten() == async->getPushed());
+    SYLAR_ASSERT(async->getPushed() >= (uint64_t)thread_num * count);
+    sylar::Config::Lookup<bool>("log.async.enable")->setValue(false);
+}
+
 int main(int argc, char** argv) {
     test_thread();
+    test_async_log();
     // test_mutex();
 
     return 0;
@@ -0,0 +1,50 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Sylar-Server
+//
+// log_decode.cpp
+//
+// Identification: tools/log_decode.cpp
+//
+// Copyright (c) 2022, pyc
+//
+// 把BinaryLogAppender写出的二进制日志还原为文本
+// 用法: log_decode <file> [pattern]
+//
+//===----------------------------------------------------------------------===//
+
+#include <stdio.h>
+
+#include "src/sylar.h"
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file> [pattern]\n", argv[0]);
+        return 1;
+    }
+
+    sylar::LogFormatter formatter(argc > 2 ? argv[2] : SYLAR_LOG_DEFAULT_PATTERN);
+    if (formatter.isError()) {
+        fprintf(stderr, "invalid pattern: %s\n", formatter.getPattern().c_str());
+        return 1;
+    }
+
+    sylar::LogBinReader reader(argv[1]);
+    if (!reader.isOpen()) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    sylar::LogEvent event;
+    sylar::LogBuffer line;
+    while (reader.next(event)) {
+        line.clear();
+        formatter.format(line, event.getLevel(), event);
+        fwrite(line.data(), 1, line.size(), stdout);
+    }
+    if (reader.isError()) {
+        fprintf(stderr, "%s: corrupted record\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Sylar-Server
+//
+// lz_cat.cpp
+//
+// Identification: tools/lz_cat.cpp
+//
+// Copyright (c) 2022, pyc
+//
+// 把压缩的日志文件(切分后的.lz文件或COMPRESS_STREAM写出的块流)解压到标准输出
+// 用法: lz_cat <file>...
+//
+//===----------------------------------------------------------------------===//
+
+#include <stdio.h>
+
+#include "src/sylar.h"
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file>...\n", argv[0]);
+        return 1;
+    }
+
+    int ret = 0;
+    for (int i = 1; i < argc; ++i) {
+        FILE* in = fopen(argv[i], "rb");
+        if (!in) {
+            perror(argv[i]);
+            ret = 1;
+            continue;
+        }
+        if (!sylar::LzDecompressStream(in, stdout)) {
+            fprintf(stderr, "%s: corrupted data\n", argv[i]);
+            ret = 1;
+        }
+        fclose(in);
+    }
+    return ret;
+}